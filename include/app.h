@@ -2,15 +2,162 @@
 #define TSL_APP_H
 
 #include <common.h>
+#include <memory.h>
+#include <core/headless.h>
+#include <core/log.h>
+#include <core/thread_pool.h>
 #include <core/window.h>
+#include <graphics/capture.h>
+#include <graphics/penrose.h>
+#include <graphics/png.h>
+#include <graphics/render_stats.h>
+#include <graphics/tile_renderer.h>
+#include <graphics/tiling.h>
+#include <graphics/wallpaper.h>
+
+enum VsyncMode
+{
+    // Whatever swap interval the driver starts with.
+    VSYNC_DEFAULT,
+    VSYNC_OFF,
+    VSYNC_ON
+};
+
+struct AppConfig
+{
+    // Runs the instanced and per-tile draw paths against each other
+    // instead of the interactive loop.
+    bool compare_draw;
+    unsigned int compare_frames;
+
+    // Renders one frame offscreen at width x height, exports it to
+    // output_path and exits without opening a window. The export is drawn
+    // and encoded strip_height rows at a time; 0 picks a height that keeps
+    // a strip around 256 MiB.
+    bool headless;
+    unsigned int width;
+    unsigned int height;
+    unsigned int strip_height;
+    const char *output_path;
+    struct PngOptions png;
+
+    // Captures every frame of the interactive view as
+    // <sequence_prefix>_<frame>.png when set.
+    const char *sequence_prefix;
+
+    // The CPU backend always runs headless. thread_count of 0 uses one
+    // worker thread per hardware thread.
+    enum RenderBackend backend;
+    int thread_count;
+
+    // Draws a tiling of about this many tiles instead of the demo tiling.
+    unsigned int tile_count;
+
+    // Tiles the plane with the fundamental domain of this group instead of
+    // the demo tile, covering the view or, with tile_count, a square of
+    // about that many tiles.
+    const struct WallpaperGroup *wallpaper_group;
+
+    // Draws a Penrose tiling with this many levels of substitution instead
+    // of the demo tiling when non-zero. The arrow keys pan the view and +/-
+    // zoom it, and only the part of the hierarchy in view is generated.
+    unsigned int penrose_depth;
+
+    // GL backend only. Places the demo or wallpaper tiles in the vertex
+    // shader from the instance index instead of uploading them.
+    bool procedural;
+
+    // With render_on_demand the interactive view waits for events and only
+    // draws when something changes what it shows, instead of drawing
+    // continuously. max_fps caps how often it draws, 0 for no cap.
+    bool render_on_demand;
+    unsigned int max_fps;
+    enum VsyncMode vsync;
+
+    // How the GL backend stores tile vertices; see PackedMeshes.
+    struct VertexFormat vertex_format;
+
+    // Directory of the program binary cache, or NULL to always compile
+    // shaders from source; see set_shader_cache_directory.
+    const char *shader_cache_path;
+
+    // Messages below log_level are dropped. With log_binary_path set,
+    // messages are written there in binary form; see log_decode.
+    enum LogLevel log_level;
+    const char *log_binary_path;
+
+    // Records a Chrome trace of the run to profile_path. Only available in
+    // builds with TSL_PROFILE.
+    const char *profile_path;
+
+    // Appends per-frame render statistics to stats_path every
+    // stats_interval frames of the interactive view; see
+    // open_render_stats_dump.
+    const char *stats_path;
+    unsigned int stats_interval;
+};
 
 struct Application
 {
     bool running;
+    double start_time;
+    struct AppConfig config;
     struct Window window;
+    struct HeadlessContext headless;
+
+    struct ThreadPool thread_pool;
+
+    // Scratch memory for the current frame, reset at the top of every
+    // iteration of the main loop and before every export strip.
+    struct Arena frame_arena;
+
+    // GL backend only. F12 queues a screenshot for the next frame.
+    struct FrameCapture capture;
+    bool screenshot_requested;
+    unsigned int screenshot_count;
+    unsigned int frame_index;
+
+    // Set when the last frame drawn no longer matches the view; see
+    // AppConfig.render_on_demand.
+    bool redraw_requested;
+    double last_frame_time;
+
+    // World point at the centre of the view and its magnification. Only
+    // the Penrose view moves.
+    float view_center[2];
+    float view_zoom;
+
+    // The camera last given to the renderer, for the pixel rectangle
+    // x, y, width, height of the image in view_rect. Moving the camera or
+    // resizing the window sets view_dirty to have it recomputed.
+    float view[16];
+    float projection[16];
+    int view_rect[4];
+    bool view_dirty;
+
+    // The tiling drawn: demo_columns x demo_rows of the demo tile, the
+    // wallpaper tiles over wallpaper_region, or the Penrose hierarchy.
+    // tile_count is the demo or wallpaper tiling's size before culling.
+    unsigned int demo_columns;
+    unsigned int demo_rows;
+    struct Tiling wallpaper;
+    float wallpaper_region[4];
+    struct PenroseTiling penrose;
+    size_t tile_count;
+
+    // The part of the plane last drawn and how many tiles it left out. Tiles
+    // are only selected again, into the renderer's instance stream, when a
+    // frame or export strip shows another region.
+    float visible_region[4];
+    bool has_visible_region;
+    uint64_t tiles_culled;
+
+    // Counters and frame times of the interactive view.
+    struct RenderStats render_stats;
 };
 
 struct Application* get_app_instance();
+bool parse_app_config(struct AppConfig *config, int argc, char **argv);
 bool init_app(struct Application *app);
 void destroy_app(struct Application *app);
 int run_app(struct Application *app);
@@ -0,0 +1,32 @@
+#ifndef TSL_CORE_HEADLESS_H
+#define TSL_CORE_HEADLESS_H
+
+#include <common.h>
+
+struct GLFWwindow;
+
+enum HeadlessBackend
+{
+    HEADLESS_BACKEND_NONE,
+    HEADLESS_BACKEND_EGL,
+    HEADLESS_BACKEND_GLFW_OSMESA,
+    HEADLESS_BACKEND_GLFW_HIDDEN
+};
+
+// A GL 3.3 core context that is not tied to a display. Rendering has to go
+// into a framebuffer object since there may be no default framebuffer.
+struct HeadlessContext
+{
+    enum HeadlessBackend backend;
+    void *egl_display;
+    void *egl_context;
+    struct GLFWwindow *window;
+};
+
+// Tries a surfaceless EGL context first, then GLFW's OSMesa context on its
+// null platform, and finally a hidden GLFW window. Loads GL through glad.
+bool init_headless_context(struct HeadlessContext *context);
+void destroy_headless_context(struct HeadlessContext *context);
+const char* get_headless_backend_name(enum HeadlessBackend backend);
+
+#endif
\ No newline at end of file
@@ -1,14 +1,112 @@
 #ifndef TSL_CORE_LOG_H
 #define TSL_CORE_LOG_H
 
+#include <common.h>
+
 #include <stdio.h>
 
+// Levels as plain numbers so the preprocessor can compare them, in order of
+// severity.
+#define TSL_LOG_LEVEL_TRACE 0
+#define TSL_LOG_LEVEL_INFO  1
+#define TSL_LOG_LEVEL_WARN  2
+#define TSL_LOG_LEVEL_ERROR 3
+#define TSL_LOG_LEVEL_FATAL 4
+
+// Calls below this level are compiled out along with their arguments, e.g.
+// -DTSL_LOG_MIN_LEVEL=TSL_LOG_LEVEL_WARN drops every LOG_TRACE and LOG_INFO.
+#ifndef TSL_LOG_MIN_LEVEL
+    #define TSL_LOG_MIN_LEVEL TSL_LOG_LEVEL_TRACE
+#endif
+
+#if defined(__GNUC__)
+    #define CORE_LOG_PRINTF(format_index) __attribute__((format(printf, format_index, format_index + 1)))
+#else
+    #define CORE_LOG_PRINTF(format_index)
+#endif
+
+enum LogLevel
+{
+    LOG_LEVEL_TRACE = TSL_LOG_LEVEL_TRACE,
+    LOG_LEVEL_INFO  = TSL_LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN  = TSL_LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR = TSL_LOG_LEVEL_ERROR,
+    LOG_LEVEL_FATAL = TSL_LOG_LEVEL_FATAL
+};
+
+// One LOG_* call in the source. Binary logs refer to messages by the id of
+// their site and store its format and location only once.
+struct LogSite
+{
+    const char *format;
+    const char *file;
+    int line;
+    enum LogLevel level;
+
+    // Set by the binary sink; id is valid while generation matches the
+    // binary log currently open.
+    uint32_t id;
+    uint32_t generation;
+};
+
+// Messages below this level are dropped at run time. Read without
+// synchronisation on every call, so set it before starting other threads.
+extern enum LogLevel core_log_level;
+
+#define CORE_LOG_FORMAT(format, ...) format
+
+#define CORE_LOG(stream, log_level, ...)                                                   \
+    do                                                                                     \
+    {                                                                                      \
+        static struct LogSite core_log_site = {                                            \
+            CORE_LOG_FORMAT(__VA_ARGS__, ""), __FILE__, __LINE__, log_level, 0, 0          \
+        };                                                                                 \
+        if (log_level >= core_log_level)                                                   \
+            core_log(stream, &core_log_site, __VA_ARGS__);                                 \
+    } while (0)
+
+// Compiled-out calls still type-check their arguments, and keep variables
+// that are only logged from being reported as unused.
+#define CORE_LOG_DISABLED(...)                                                             \
+    do                                                                                     \
+    {                                                                                      \
+        if (0)                                                                             \
+            core_log(stdout, NULL, __VA_ARGS__);                                           \
+    } while (0)
+
+#if TSL_LOG_MIN_LEVEL <= TSL_LOG_LEVEL_TRACE
+    #define LOG_TRACE(...) CORE_LOG(stdout, LOG_LEVEL_TRACE, __VA_ARGS__)
+#else
+    #define LOG_TRACE(...) CORE_LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if TSL_LOG_MIN_LEVEL <= TSL_LOG_LEVEL_INFO
+    #define LOG_INFO(...)  CORE_LOG(stdout, LOG_LEVEL_INFO,  __VA_ARGS__)
+#else
+    #define LOG_INFO(...)  CORE_LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if TSL_LOG_MIN_LEVEL <= TSL_LOG_LEVEL_WARN
+    #define LOG_WARN(...)  CORE_LOG(stdout, LOG_LEVEL_WARN,  __VA_ARGS__)
+#else
+    #define LOG_WARN(...)  CORE_LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if TSL_LOG_MIN_LEVEL <= TSL_LOG_LEVEL_ERROR
+    #define LOG_ERROR(...) CORE_LOG(stderr, LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+    #define LOG_ERROR(...) CORE_LOG_DISABLED(__VA_ARGS__)
+#endif
+
+// Never compiled out.
+#define LOG_FATAL(...) CORE_LOG(stderr, LOG_LEVEL_FATAL, __VA_ARGS__)
+
 #ifdef TSL_DEBUG
-    #define DEBUG_INFO(...)  core_log(stdout, LOG_LEVEL_INFO,  __VA_ARGS__)
-    #define DEBUG_TRACE(...) core_log(stdout, LOG_LEVEL_TRACE, __VA_ARGS__)
-    #define DEBUG_WARN(...)  core_log(stdout, LOG_LEVEL_WARN,  __VA_ARGS__)
-    #define DEBUG_ERROR(...) core_log(stderr, LOG_LEVEL_ERROR, __VA_ARGS__)
-    #define DEBUG_FATAL(...) core_log(stderr, LOG_LEVEL_FATAL, __VA_ARGS__)
+    #define DEBUG_INFO(...)  LOG_INFO(__VA_ARGS__)
+    #define DEBUG_TRACE(...) LOG_TRACE(__VA_ARGS__)
+    #define DEBUG_WARN(...)  LOG_WARN(__VA_ARGS__)
+    #define DEBUG_ERROR(...) LOG_ERROR(__VA_ARGS__)
+    #define DEBUG_FATAL(...) LOG_FATAL(__VA_ARGS__)
 #else
     #define DEBUG_INFO(...)
     #define DEBUG_TRACE(...)
@@ -17,21 +115,30 @@
     #define DEBUG_FATAL(...)
 #endif
 
-#define LOG_INFO(...)  core_log(stdout, LOG_LEVEL_INFO,  __VA_ARGS__)
-#define LOG_TRACE(...) core_log(stdout, LOG_LEVEL_TRACE, __VA_ARGS__)
-#define LOG_WARN(...)  core_log(stdout, LOG_LEVEL_WARN,  __VA_ARGS__)
-#define LOG_ERROR(...) core_log(stderr, LOG_LEVEL_ERROR, __VA_ARGS__)
-#define LOG_FATAL(...) core_log(stderr, LOG_LEVEL_FATAL, __VA_ARGS__)
+// Messages are queued with their arguments and written by a background
+// thread, so the caller never formats text or touches stdio. The format
+// must be a string literal or otherwise outlive the program. LOG_FATAL and
+// exit flush the queue.
+void core_log(FILE *stream, struct LogSite *site, const char *format, ...) CORE_LOG_PRINTF(3);
 
-enum LogLevel
-{
-    LOG_LEVEL_INFO,
-    LOG_LEVEL_TRACE,
-    LOG_LEVEL_WARN,
-    LOG_LEVEL_ERROR,
-    LOG_LEVEL_FATAL
-};
+// Blocks until every message logged so far has been written.
+void flush_log();
+
+// Writes messages on the calling thread instead, as before the queue
+// existed. Flushes first when switching to synchronous.
+void set_log_async(bool async);
+
+void set_log_level(enum LogLevel level);
+
+// Returns the level named name (trace, info, warn, error or fatal), or false
+// if there is none.
+bool parse_log_level(const char *name, enum LogLevel *level);
 
-void core_log(FILE *stream, enum LogLevel level, const char *format, ...);
+// Sends messages to a binary log at path as site ids and packed arguments,
+// without formatting them; decode it with log_decode. Warnings and errors
+// are still written as text as well. Returns false if the file can't be
+// created.
+bool open_binary_log(const char *path);
+void close_binary_log();
 
 #endif
\ No newline at end of file
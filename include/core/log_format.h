@@ -0,0 +1,46 @@
+#ifndef TSL_CORE_LOG_FORMAT_H
+#define TSL_CORE_LOG_FORMAT_H
+
+#include <common.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+
+// Deferred printf formatting: the arguments of a message are packed into a
+// buffer when it is logged and formatted later, possibly by another thread
+// or another program. Integers are stored as 64-bit, floating point as
+// double (long double for %L), pointers as they are, and strings are copied
+// with their terminator; '*' widths and precisions are stored as int.
+// Conversions other than d i u o x X c f F e E g G a A p s and %%, such as
+// %n or wide characters, can't be packed.
+
+// Packs the arguments format consumes. Fails if format has a conversion
+// that can't be packed or the arguments need more than capacity bytes.
+bool pack_log_arguments(const char *format, va_list *args, uint8_t *data, size_t capacity, size_t *size);
+
+// Writes format with arguments packed by pack_log_arguments. Fails, after
+// writing what it could, if data runs out before the format does.
+bool write_log_arguments(FILE *stream, const char *format, const uint8_t *data, size_t size);
+
+// Binary log files: a header, then records that each start with a
+// LogBinaryRecordType byte. All values are in the byte order of the writer,
+// which the header's byte order mark tells apart.
+//
+//   header     magic[8] "TSLLOG1\0", u32 byte order mark 0x01020304
+//   site       u32 id, u8 level, u32 line, u16 length + file,
+//              u16 length + format; precedes the site's first message
+//   message    u32 site, u64 time in ns since the epoch, u16 length +
+//              packed arguments
+//   text       u32 site, u64 time, u32 length + the formatted message, for
+//              messages whose arguments didn't fit a packed message
+#define LOG_BINARY_MAGIC "TSLLOG1"
+#define LOG_BINARY_BYTE_ORDER 0x01020304u
+
+enum LogBinaryRecordType
+{
+    LOG_BINARY_SITE = 1,
+    LOG_BINARY_MESSAGE = 2,
+    LOG_BINARY_TEXT = 3
+};
+
+#endif
\ No newline at end of file
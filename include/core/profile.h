@@ -0,0 +1,64 @@
+#ifndef TSL_CORE_PROFILE_H
+#define TSL_CORE_PROFILE_H
+
+#include <common.h>
+
+// Frame profiler, built only with -DTSL_PROFILE (the TSL_PROFILE CMake
+// option). Without it every macro below expands to nothing and none of its
+// arguments are evaluated.
+//
+// CPU scopes are opened and closed in pairs on the same thread and may nest.
+// GPU scopes time the GL commands between them with GL_TIME_ELAPSED queries,
+// which GL does not allow to nest, so a GPU scope opened inside another is
+// skipped. They must be used on the thread owning the GL context, and their
+// results are read back by PROFILE_FRAME a few frames later, once the GPU
+// has finished with them, so timing never stalls the pipeline.
+//
+// Scope names must be string literals or otherwise outlive the profiler.
+#ifdef TSL_PROFILE
+    #define PROFILE_BEGIN(name)     begin_profile_scope(name)
+    #define PROFILE_END()           end_profile_scope()
+    #define PROFILE_GPU_BEGIN(name) begin_gpu_profile_scope(name)
+    #define PROFILE_GPU_END()       end_gpu_profile_scope()
+    #define PROFILE_FRAME()         collect_gpu_profile()
+    #define PROFILE_THREAD(...)     set_profile_thread_name(__VA_ARGS__)
+#else
+    #define PROFILE_BEGIN(name)
+    #define PROFILE_END()
+    #define PROFILE_GPU_BEGIN(name)
+    #define PROFILE_GPU_END()
+    #define PROFILE_FRAME()
+    #define PROFILE_THREAD(...)
+#endif
+
+// GPU scopes read back per frame, and frames whose results may be waited
+// for before new GPU scopes are skipped instead.
+#define PROFILE_GPU_SCOPES 32
+#define PROFILE_GPU_LATENCY 4
+
+#ifdef TSL_PROFILE
+
+// Starts recording scopes from every thread. Nothing is written until
+// stop_profiler, which saves them to path as Chrome trace_event JSON that
+// chrome://tracing and Perfetto load. Fails if path can't be created.
+bool start_profiler(const char *path);
+
+// Must be called while no other thread is inside a scope, and on the GL
+// thread with its context current if GPU scopes were used.
+bool stop_profiler();
+
+void begin_profile_scope(const char *name);
+void end_profile_scope();
+
+void begin_gpu_profile_scope(const char *name);
+void end_gpu_profile_scope();
+
+// Call once per frame, after the frame's last GPU scope.
+void collect_gpu_profile();
+
+// Names the calling thread in the trace, e.g. "worker 3".
+void set_profile_thread_name(const char *format, ...);
+
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef TSL_CORE_THREAD_POOL_H
+#define TSL_CORE_THREAD_POOL_H
+
+#include <common.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+// worker is in [0, worker_count) and can index per-worker scratch data.
+typedef void (*ThreadTaskFunction)(void *data, size_t task, int worker);
+
+// Chase-Lev deque of task indices. The owning worker pushes and pops at the
+// bottom; other workers steal from the top.
+struct WorkDeque
+{
+    _Atomic int64_t top;
+    _Atomic int64_t bottom;
+    _Atomic size_t *tasks;
+    int64_t capacity;
+
+    // Keeps neighbouring deques off each other's cache lines.
+    char padding[64];
+};
+
+struct ThreadPool
+{
+    // Includes the thread calling run_thread_pool, which works too.
+    int worker_count;
+    pthread_t *threads;
+    struct WorkDeque *deques;
+
+    // Entries in threads and deques, more than worker_count when some
+    // workers failed to start.
+    int capacity;
+
+    // Held for the whole of run_thread_pool, so callers on different
+    // threads take turns.
+    pthread_mutex_t run_mutex;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t start_condition;
+    pthread_cond_t done_condition;
+    uint64_t generation;
+    int active_workers;
+    bool shutting_down;
+
+    ThreadTaskFunction function;
+    void *data;
+    size_t task_count;
+    _Atomic size_t remaining_tasks;
+};
+
+// worker_count <= 0 uses one worker per hardware thread.
+bool init_thread_pool(struct ThreadPool *pool, int worker_count);
+void destroy_thread_pool(struct ThreadPool *pool);
+
+// Runs function for every task in [0, task_count) and returns once all of
+// them have finished. Each worker starts on a contiguous share of the tasks
+// and steals from the others when it runs out, so uneven tasks balance out.
+// A NULL pool runs every task on the calling thread as worker 0. Tasks must
+// not call run_thread_pool on the same pool.
+void run_thread_pool(struct ThreadPool *pool, size_t task_count, ThreadTaskFunction function, void *data);
+
+int get_hardware_thread_count();
+
+#endif
\ No newline at end of file
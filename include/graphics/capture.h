@@ -0,0 +1,78 @@
+#ifndef TSL_GRAPHICS_CAPTURE_H
+#define TSL_GRAPHICS_CAPTURE_H
+
+#include <common.h>
+#include <core/thread_pool.h>
+#include <graphics/png.h>
+
+#include <pthread.h>
+
+// Reads in flight on the GPU; a fourth capture waits for the oldest.
+#define CAPTURE_RING_SIZE 3
+
+// Frames read back but not yet written; a full queue blocks the caller.
+#define CAPTURE_QUEUE_SIZE 4
+
+#define CAPTURE_PATH_SIZE 256
+
+struct CaptureSlot
+{
+    unsigned int pbo;
+    size_t capacity;
+
+    // GLsync of the read into pbo, NULL when the slot is free.
+    void *fence;
+    int width;
+    int height;
+    char path[CAPTURE_PATH_SIZE];
+};
+
+struct CaptureJob
+{
+    uint8_t *pixels;
+    int width;
+    int height;
+    char path[CAPTURE_PATH_SIZE];
+};
+
+// Asynchronous screenshots. Reads go into pixel buffer objects guarded by
+// fences, so requesting a capture does not wait for the GPU; finished reads
+// are copied out and written by a background thread while rendering goes on.
+struct FrameCapture
+{
+    struct CaptureSlot slots[CAPTURE_RING_SIZE];
+    int oldest;
+    int pending;
+
+    struct PngOptions png;
+    struct ThreadPool *pool;
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t job_condition;
+    pthread_cond_t space_condition;
+    struct CaptureJob jobs[CAPTURE_QUEUE_SIZE];
+    int first_job;
+    int job_count;
+    bool encoding;
+    bool stopping;
+};
+
+// Needs a current GL context. pool, if given, is used to encode and must
+// outlive the capture.
+bool init_frame_capture(struct FrameCapture *capture, const struct PngOptions *png, struct ThreadPool *pool);
+
+// Writes out everything still pending before returning.
+void destroy_frame_capture(struct FrameCapture *capture);
+
+// Starts reading the bound read framebuffer into a PNG at path.
+void request_capture(struct FrameCapture *capture, int width, int height, const char *path);
+
+// Hands every finished read to the encoder thread without blocking on the
+// GPU. Call once per frame.
+void poll_frame_capture(struct FrameCapture *capture);
+
+// Waits until every requested capture has been written.
+void flush_frame_capture(struct FrameCapture *capture);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef TSL_GRAPHICS_FRAMEBUFFER_H
+#define TSL_GRAPHICS_FRAMEBUFFER_H
+
+#include <common.h>
+
+// Offscreen RGBA8 render target, used when there is no window to draw into.
+struct Framebuffer
+{
+    unsigned int fbo;
+    unsigned int color_buffer;
+    int width;
+    int height;
+};
+
+bool create_framebuffer(struct Framebuffer *framebuffer, int width, int height);
+void destroy_framebuffer(struct Framebuffer *framebuffer);
+
+// Binds the framebuffer for both drawing and reading and sets the viewport.
+void bind_framebuffer(const struct Framebuffer *framebuffer);
+void unbind_framebuffer();
+
+#endif
\ No newline at end of file
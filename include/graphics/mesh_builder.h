@@ -0,0 +1,90 @@
+#ifndef TSL_GRAPHICS_MESH_BUILDER_H
+#define TSL_GRAPHICS_MESH_BUILDER_H
+
+#include <common.h>
+#include <graphics/tile.h>
+
+#define MESH_PALETTE_MAX_COLORS 16
+
+enum VertexPositionFormat
+{
+    VERTEX_POSITION_FLOAT,
+    VERTEX_POSITION_SNORM16,
+    VERTEX_POSITION_HALF
+};
+
+enum VertexColorFormat
+{
+    VERTEX_COLOR_UNORM8,
+    VERTEX_COLOR_PALETTE
+};
+
+// Zero-initialised, positions are floats and colours unorm8. Only float
+// positions draw exactly what the CPU backend draws; the 16 bit formats
+// round them.
+struct VertexFormat
+{
+    enum VertexPositionFormat position;
+    enum VertexColorFormat color;
+};
+
+// Tile meshes packed for the GPU. A vertex is its x and y, since z is
+// always 0, as two floats or two 16 bit components, followed by an unorm8
+// RGBA colour or a 16 bit palette index: 6 to 12 bytes, against 24 bytes in
+// the TileMesh layout.
+//
+// Identical vertices are stored once across all the meshes, so variants that
+// only differ in colour share everything else, and meshes whose indices come
+// out the same share one index range. Indices are 16 bit whenever the
+// vertex count allows, and each mesh's triangles are reordered for the
+// vertex cache; see optimize_vertex_cache.
+struct PackedMeshes
+{
+    struct VertexFormat format;
+
+    // The colour follows the position, position_size bytes into a vertex.
+    size_t position_size;
+    size_t vertex_size;
+    size_t vertex_count;
+    size_t vertex_capacity;
+    uint8_t *vertices;
+
+    // index_size is 2 or 4 bytes.
+    size_t index_size;
+    size_t index_count;
+    size_t index_capacity;
+    uint8_t *indices;
+
+    // A stored position p decodes as p * position_scale + position_offset.
+    // snorm16 positions are spread over the bounds of all the meshes and
+    // read as plain integers, floats and half floats are stored as they
+    // are.
+    float position_scale[2];
+    float position_offset[2];
+
+    // Only used by VERTEX_COLOR_PALETTE; the colours are RGBA.
+    int palette_size;
+    float palette[MESH_PALETTE_MAX_COLORS][4];
+
+    int mesh_count;
+    size_t first_index[TILE_MESH_MAX_COUNT];
+    size_t mesh_index_count[TILE_MESH_MAX_COUNT];
+
+    // Vertex cache miss ratio over all the meshes before and after their
+    // triangles were reordered, and the mean overdraw of a single tile.
+    double acmr_before;
+    double acmr_after;
+    double overdraw;
+};
+
+// Meshes with more colours than the palette holds are packed with unorm8
+// colours instead. Returns false when out of memory.
+bool pack_tile_meshes(
+    struct PackedMeshes *packed,
+    const struct TileMesh *meshes,
+    int mesh_count,
+    const struct VertexFormat *format
+);
+void destroy_packed_meshes(struct PackedMeshes *packed);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef TSL_GRAPHICS_MESH_OPTIMIZER_H
+#define TSL_GRAPHICS_MESH_OPTIMIZER_H
+
+#include <common.h>
+#include <graphics/tile.h>
+
+// Entries of the post-transform vertex cache that indices are ordered for
+// and measured against. A FIFO this small is a conservative model of
+// current GPUs.
+#define VERTEX_CACHE_SIZE 16
+
+// Samples per side get_mesh_overdraw is measured with.
+#define MESH_OVERDRAW_RESOLUTION 256
+
+// Reorders the triangles of a triangle list for the post-transform vertex
+// cache with Tipsify (Sander, Nehab and Barczak, 2007): it fans out around
+// the most recently used vertex that will still be cached and only jumps
+// elsewhere at dead ends. Each triangle keeps its winding. Indices must be
+// below vertex_count. Returns false, leaving indices as they were, when out
+// of memory.
+bool optimize_vertex_cache(uint32_t *indices, size_t index_count, size_t vertex_count, int cache_size);
+
+// Average cache miss ratio: vertices transformed per triangle through a
+// FIFO cache of cache_size entries, from 0.5 for a large regular grid to 3
+// when no vertex is reused.
+double get_vertex_cache_miss_ratio(const uint32_t *indices, size_t index_count, int cache_size);
+
+// Fragments shaded per pixel covered when mesh is drawn on its own, sampled
+// on a resolution x resolution grid over its bounds. 1 means no pixel is
+// drawn twice.
+double get_mesh_overdraw(const struct TileMesh *mesh, int resolution);
+
+#endif
\ No newline at end of file
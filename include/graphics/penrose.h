@@ -0,0 +1,82 @@
+#ifndef TSL_GRAPHICS_PENROSE_H
+#define TSL_GRAPHICS_PENROSE_H
+
+#include <common.h>
+#include <memory.h>
+#include <graphics/tile.h>
+
+// Penrose rhombus (P3) tiling built by substituting Robinson triangles, the
+// halves of the thin and thick rhombi. Mesh 0 draws thin halves and mesh 1
+// thick ones.
+#define PENROSE_MESH_COUNT 2
+#define PENROSE_MAX_DEPTH  30
+
+// Two triangles sharing the diagonal BC make up one rhombus; AB and AC are
+// its edges.
+struct PenroseTriangle
+{
+    double vertices[3][2];
+    bool thick;
+
+    // Created the first time the triangle is subdivided and kept while it
+    // stays near the view.
+    int child_count;
+    struct PenroseTriangle *children[3];
+};
+
+// Work done by one update.
+struct PenroseStats
+{
+    size_t visited;
+    size_t created;
+    size_t freed;
+    size_t live;
+    size_t tiles;
+
+    // Tiles at the level drawn that lie outside the view, counted without
+    // subdividing the branches that hold them.
+    uint64_t culled;
+};
+
+// A sun of ten triangles subdivided depth times down to rhombi of edge
+// tile_size. Only the branches that reach the view are ever subdivided.
+struct PenroseTiling
+{
+    int depth;
+    double edge_lengths[PENROSE_MAX_DEPTH + 1];
+
+    // Halves a thin (0) or thick (1) triangle splits into after n levels.
+    uint64_t descendant_counts[2][PENROSE_MAX_DEPTH + 1];
+    struct PenroseTriangle roots[10];
+    struct BlockPool pool;
+
+    // Triangles smaller than this on screen are not subdivided further, so
+    // zooming out draws coarser levels instead of subpixel tiles.
+    float min_tile_pixels;
+
+    float vertex_data[PENROSE_MESH_COUNT][9 * 6];
+    struct TileMesh meshes[PENROSE_MESH_COUNT];
+
+    // The last update's tiles, grouped by mesh for set_tile_instances.
+    struct TileInstance *instances;
+    size_t instance_capacity;
+    size_t counts[PENROSE_MESH_COUNT];
+};
+
+bool init_penrose_tiling(struct PenroseTiling *tiling, int depth, float tile_size);
+void destroy_penrose_tiling(struct PenroseTiling *tiling);
+
+// Collects the tiles covering region (x0, y0, x1, y1) seen at
+// pixels_per_unit. Triangles are subdivided on first use; branches that
+// have moved well away from the view give their children back to the pool.
+// The thick halves are gathered in scratch, which is rewound to where it
+// was before returning. stats may be NULL.
+void update_penrose_tiling(
+    struct PenroseTiling *tiling,
+    const float *region,
+    float pixels_per_unit,
+    struct Arena *scratch,
+    struct PenroseStats *stats
+);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,94 @@
+#ifndef TSL_GRAPHICS_PNG_H
+#define TSL_GRAPHICS_PNG_H
+
+#include <common.h>
+#include <memory.h>
+#include <core/thread_pool.h>
+
+#include <stdio.h>
+
+enum PngFilter
+{
+    PNG_FILTER_NONE,
+    PNG_FILTER_SUB,
+    PNG_FILTER_UP,
+    PNG_FILTER_AVERAGE,
+    PNG_FILTER_PAETH,
+
+    // Picks the filter with the smallest sum of absolute differences for
+    // every row, like libpng's default heuristic.
+    PNG_FILTER_ADAPTIVE
+};
+
+struct PngOptions
+{
+    // 0 stores the data uncompressed, 1 is fastest, 9 compresses best.
+    int level;
+    enum PngFilter filter;
+};
+
+#define PNG_DEFAULT_LEVEL 6
+
+void get_default_png_options(struct PngOptions *options);
+
+// Returns the filter named name, or false if there is none.
+bool parse_png_filter(const char *name, enum PngFilter *filter);
+
+// Streams an image to disk a batch of rows at a time; only the current
+// batch and a 32 KiB deflate window are held in memory.
+struct PngWriter
+{
+    FILE *file;
+    int width;
+    int height;
+    int rows_written;
+    bool failed;
+
+    struct PngOptions options;
+    struct ThreadPool *pool;
+    size_t row_size;
+
+    uint8_t *previous_row;
+    uint8_t *window;
+    size_t window_size;
+    uint32_t adler;
+
+    // Per-batch buffers. Strips are usually the same size, so after the
+    // first batch the memory is reused instead of being mapped again.
+    struct Arena scratch;
+};
+
+bool open_png_writer(
+    struct PngWriter *writer,
+    const char *path,
+    int width,
+    int height,
+    const struct PngOptions *options,
+    struct ThreadPool *pool
+);
+
+// Appends the next row_count rows below those already written. Within the
+// batch, rows are stored bottom to top when bottom_up is set.
+bool write_png_rows(struct PngWriter *writer, const uint8_t *pixels, int row_count, bool bottom_up);
+
+// Fails if fewer rows than the image height were written.
+bool close_png_writer(struct PngWriter *writer);
+
+// Writes RGBA8 pixels as a PNG. Rows are stored bottom to top when
+// bottom_up is set, as glReadPixels returns them.
+//
+// The image is split into bands of rows that are filtered and deflated on
+// pool (which may be NULL). Each band uses the end of the previous one as
+// its dictionary and ends on a byte boundary, so the bands join into a
+// single zlib stream that compresses about as well as a serial encoder.
+bool write_png(
+    const char *path,
+    const uint8_t *pixels,
+    int width,
+    int height,
+    bool bottom_up,
+    const struct PngOptions *options,
+    struct ThreadPool *pool
+);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,121 @@
+#ifndef TSL_GRAPHICS_RASTER_H
+#define TSL_GRAPHICS_RASTER_H
+
+#include <common.h>
+#include <core/thread_pool.h>
+#include <graphics/tile.h>
+
+// Screen tiles triangles are binned into, and the pixel blocks edge
+// functions are evaluated over inside a tile.
+#define RASTER_TILE_SIZE  64
+#define RASTER_BLOCK_SIZE 8
+
+// Vertex positions are snapped to 1/256 of a pixel, like llvmpipe.
+#define RASTER_SUBPIXEL_BITS 8
+
+// RGBA8 pixels with row 0 at the bottom, the same layout glReadPixels
+// produces, so both backends share the export path.
+struct RasterTarget
+{
+    uint8_t *pixels;
+    int width;
+    int height;
+};
+
+// A triangle after vertex processing and setup. Edge functions are in
+// fixed point with the fill rule bias folded into c.
+struct RasterTriangle
+{
+    int min_x;
+    int min_y;
+    int max_x;
+    int max_y;
+
+    int64_t step_x[3];
+    int64_t step_y[3];
+    int64_t c[3];
+
+    // Set when the values inside a partially covered block fit in 32 bits,
+    // which allows the SIMD path.
+    bool small;
+
+    // Set when all three vertices share a color, which is the common case
+    // for tiles; otherwise colors are interpolated per pixel.
+    bool flat;
+    uint32_t color;
+    float colors[3][3];
+    double inverse_area;
+};
+
+struct RasterBin
+{
+    uint32_t *triangles;
+    size_t count;
+    size_t capacity;
+};
+
+struct RasterSubmission
+{
+    float view_projection[16];
+    const struct TileMesh *mesh;
+    const struct TileInstance *instances;
+    size_t instance_count;
+};
+
+// Output of one binning task: the triangles it set up from a contiguous
+// range of instances, and for every screen tile the ones touching it.
+// Tiles draw the chunks' lists in chunk order, which keeps submission order.
+struct RasterChunk
+{
+    struct RasterTriangle *triangles;
+    size_t triangle_count;
+    size_t triangle_capacity;
+
+    struct RasterBin *bins;
+};
+
+struct Rasterizer
+{
+    struct RasterTarget *target;
+    struct ThreadPool *pool;
+    int tiles_x;
+    int tiles_y;
+    int bin_count;
+
+    struct RasterSubmission *submissions;
+    size_t submission_count;
+    size_t submission_capacity;
+    size_t instance_count;
+
+    // One chunk per pool worker, so binning is split evenly across threads.
+    struct RasterChunk *chunks;
+    int chunk_count;
+};
+
+bool create_raster_target(struct RasterTarget *target, int width, int height);
+void destroy_raster_target(struct RasterTarget *target);
+void clear_raster_target(struct RasterTarget *target, const float *color);
+
+// pool may be NULL, in which case everything runs on the calling thread.
+void init_rasterizer(struct Rasterizer *rasterizer, struct ThreadPool *pool);
+void destroy_rasterizer(struct Rasterizer *rasterizer);
+
+// Starts a new frame: subsequent submissions are drawn into target.
+void begin_raster_frame(struct Rasterizer *rasterizer, struct RasterTarget *target);
+
+// Queues every instance of mesh for transformation by view_projection
+// (column-major). Mesh and instances must stay alive until end_raster_frame.
+// Triangles are drawn in submission order.
+void submit_raster_instances(
+    struct Rasterizer *rasterizer,
+    const float *view_projection,
+    const struct TileMesh *mesh,
+    const struct TileInstance *instances,
+    size_t instance_count
+);
+
+// Sets up and bins all queued triangles in parallel, then rasterizes the
+// screen tiles in parallel. Logs the time spent in each stage.
+void end_raster_frame(struct Rasterizer *rasterizer);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,106 @@
+#ifndef TSL_GRAPHICS_RENDER_STATS_H
+#define TSL_GRAPHICS_RENDER_STATS_H
+
+#include <common.h>
+
+#include <stdio.h>
+
+// Work submitted to GL, counted where the calls are made.
+struct RenderCounters
+{
+    uint64_t draw_calls;
+    uint64_t triangles;
+
+    // Only uploads that reach the driver; repeats the shader cache drops
+    // are not counted.
+    uint64_t uniform_uploads;
+    uint64_t buffer_bytes;
+
+    // Program and vertex array binds.
+    uint64_t state_changes;
+
+    // Tiles left out of the frame's instances for lying outside the view.
+    uint64_t tiles_culled;
+};
+
+// Counters of the frame in progress. Only touched on the GL thread.
+extern struct RenderCounters render_counters;
+
+struct FrameStats
+{
+    uint64_t frame;
+    struct RenderCounters counters;
+
+    // Seconds. The GPU time is measured with timestamp queries and arrives
+    // a few frames late; it stays negative until then, and for frames that
+    // could not be timed.
+    double cpu_time;
+    double gpu_time;
+};
+
+struct FrameTimePercentiles
+{
+    int sample_count;
+    double p50;
+    double p95;
+    double p99;
+};
+
+// Frames kept for the percentiles, and frames of timestamp queries in
+// flight before new frames go untimed instead of waiting.
+#define RENDER_STATS_HISTORY 512
+#define RENDER_STATS_GPU_LATENCY 4
+
+enum RenderStatsFormat
+{
+    RENDER_STATS_CSV,
+
+    // One JSON object per line.
+    RENDER_STATS_JSON
+};
+
+struct RenderStats
+{
+    struct FrameStats history[RENDER_STATS_HISTORY];
+    uint64_t frame_count;
+    double frame_start;
+
+    bool gpu_timing;
+    unsigned int queries[RENDER_STATS_GPU_LATENCY][2];
+    uint64_t query_frames[RENDER_STATS_GPU_LATENCY];
+    int first_query;
+    int pending_queries;
+    bool frame_timed;
+
+    FILE *dump;
+    enum RenderStatsFormat dump_format;
+    unsigned int dump_interval;
+    unsigned int dump_frames;
+    struct RenderCounters dump_counters;
+};
+
+// gpu_timing needs a current GL context, and every other call must then be
+// made on its thread.
+void init_render_stats(struct RenderStats *stats, bool gpu_timing);
+void destroy_render_stats(struct RenderStats *stats);
+
+// Bracket one iteration of the frame loop. Ending a frame moves
+// render_counters into its FrameStats and resets them.
+void begin_render_stats_frame(struct RenderStats *stats);
+void end_render_stats_frame(struct RenderStats *stats);
+
+// Returns NULL for frames that have not ended or have left the history.
+const struct FrameStats* get_frame_stats(const struct RenderStats *stats, uint64_t frame);
+const struct FrameStats* get_latest_frame_stats(const struct RenderStats *stats);
+
+// Over the frames in the history, skipping those without a GPU time.
+void get_frame_time_percentiles(const struct RenderStats *stats, bool gpu, struct FrameTimePercentiles *percentiles);
+
+// Appends a row to path every interval frames with the mean counters per
+// frame since the previous row and the current percentiles. Paths ending in
+// .json get JSON, anything else CSV.
+bool open_render_stats_dump(struct RenderStats *stats, const char *path, unsigned int interval);
+
+void log_render_stats(const struct RenderStats *stats);
+
+#endif
\ No newline at end of file
@@ -1,6 +1,101 @@
 #ifndef TSL_GRAPHICS_SHADER_H
 #define TSL_GRAPHICS_SHADER_H
 
-unsigned int create_shader(const char *vertex_source, const char *fragment_source);
+#include <common.h>
+
+#define SHADER_NAME_MAX_LENGTH 64
+
+// Binding points of the uniform blocks create_shader binds in every program
+// that declares them, so one buffer serves them all: View, declared by
+// SHADER_VIEW_BLOCK, and Material, whose layout is up to the programs'
+// owner. Other blocks start at SHADER_FIRST_FREE_BINDING.
+#define SHADER_VIEW_BINDING       0
+#define SHADER_MATERIAL_BINDING   1
+#define SHADER_FIRST_FREE_BINDING 2
+
+#define SHADER_VIEW_BLOCK \
+    "layout(std140) uniform View {\n" \
+    "  mat4 view;\n" \
+    "  mat4 projection;\n" \
+    "};\n"
+
+// An active uniform or attribute, reflected once at link time.
+struct ShaderVariable
+{
+    char name[SHADER_NAME_MAX_LENGTH];
+    uint32_t hash;
+    int location;
+    unsigned int type;
+    int size;
+
+    // Last value uploaded through the setters below, so repeated uploads
+    // of the same value never reach the driver.
+    bool cached;
+    union
+    {
+        float f[16];
+        int i[4];
+    } value;
+};
+
+// Variables are stored in open-addressed hash tables whose capacity is a
+// power of two. Lookups by name are meant for setup code; the hot loop should
+// hold on to the returned variables instead.
+struct Shader
+{
+    unsigned int program;
+
+    struct ShaderVariable *uniforms;
+    int uniform_capacity;
+    int uniform_count;
+
+    struct ShaderVariable *attributes;
+    int attribute_capacity;
+    int attribute_count;
+};
+
+// Programs created so far and the seconds spent creating them.
+struct ShaderCacheStats
+{
+    int loaded;
+    double load_time;
+    int compiled;
+    double compile_time;
+
+    // Cached binaries that were unreadable or that the driver refused;
+    // these programs were compiled instead.
+    int rejected;
+};
+
+// Linked programs are saved to directory as driver binaries, keyed by their
+// sources and the GL vendor, renderer and version, and later runs load them
+// instead of compiling. Drivers without binary formats skip the cache. NULL,
+// the default, turns it off. directory must outlive its use.
+void set_shader_cache_directory(const char *directory);
+const struct ShaderCacheStats* get_shader_cache_stats();
+
+bool create_shader(struct Shader *shader, const char *vertex_source, const char *fragment_source);
+void destroy_shader(struct Shader *shader);
+void bind_shader(const struct Shader *shader);
+
+// Binds the uniform block called name to a binding point. Returns false when
+// the program has no such active block.
+bool set_shader_block_binding(struct Shader *shader, const char *name, unsigned int binding);
+
+// Returns NULL when the program has no active variable with that name, which
+// happens when the compiler optimises it away. All setters accept NULL.
+struct ShaderVariable* get_shader_uniform(struct Shader *shader, const char *name);
+struct ShaderVariable* get_shader_attribute(struct Shader *shader, const char *name);
+
+// The shader owning the uniform must be bound.
+void set_shader_int(struct ShaderVariable *uniform, int value);
+void set_shader_float(struct ShaderVariable *uniform, float value);
+void set_shader_vec2(struct ShaderVariable *uniform, const float *value);
+void set_shader_vec3(struct ShaderVariable *uniform, const float *value);
+void set_shader_vec4(struct ShaderVariable *uniform, const float *value);
+void set_shader_mat4(struct ShaderVariable *uniform, const float *value);
+
+// Sets the first count elements of a vec4 array. Arrays are not cached.
+void set_shader_vec4_array(struct ShaderVariable *uniform, const float *values, int count);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef TSL_GRAPHICS_STREAM_BUFFER_H
+#define TSL_GRAPHICS_STREAM_BUFFER_H
+
+#include <common.h>
+
+// Regions in the ring; the CPU writes one while the GPU may still be
+// reading the others.
+#define STREAM_BUFFER_REGIONS 3
+
+// A GL buffer for data rewritten every frame, split into regions written in
+// turn. Each region is fenced after the draws that read it and waited on
+// only when the ring comes back around to it, so writes neither reallocate
+// the buffer nor sync with the GPU implicitly.
+//
+// With ARB_buffer_storage the buffer is mapped once, persistently and
+// coherently; otherwise each region is mapped unsynchronized with
+// glMapBufferRange while it is written.
+struct StreamBuffer
+{
+    unsigned int buffer;
+    size_t region_size;
+    bool persistent;
+    uint8_t *mapping;
+
+    // The region last mapped and its GLsync fences, NULL when unused.
+    int region;
+    void *fences[STREAM_BUFFER_REGIONS];
+
+    // Regions written, and how many of them had to wait for the GPU.
+    size_t write_count;
+    size_t stall_count;
+};
+
+bool init_stream_buffer(struct StreamBuffer *stream, size_t region_size);
+void destroy_stream_buffer(struct StreamBuffer *stream);
+
+// Moves to the next region and maps it for size bytes of writes, growing
+// the buffer first if size does not fit. The memory is write-only. Returns
+// NULL on failure.
+void* map_stream_region(struct StreamBuffer *stream, size_t size);
+
+// Makes the writes visible to GL. The region starts at
+// get_stream_region_offset in buffer.
+void unmap_stream_region(struct StreamBuffer *stream);
+size_t get_stream_region_offset(const struct StreamBuffer *stream);
+
+// Call after the last draw that reads the current region.
+void fence_stream_region(struct StreamBuffer *stream);
+
+#endif
\ No newline at end of file
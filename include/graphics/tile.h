@@ -0,0 +1,46 @@
+#ifndef TSL_GRAPHICS_TILE_H
+#define TSL_GRAPHICS_TILE_H
+
+#include <common.h>
+
+#define TILE_MESH_MAX_COUNT   8
+#define TILE_LATTICE_MAX_DRAWS 64
+
+// Interleaved vertex layout: vec3 position followed by vec3 color.
+struct TileMesh
+{
+    const float *vertices;
+    size_t vertex_count;
+    const unsigned int *indices;
+    size_t index_count;
+};
+
+// Per-instance placement of a tile: a 2x2 linear part stored column-major
+// followed by a translation. Enough to express the mirrored variant as well.
+struct TileInstance
+{
+    float linear[4];
+    float offset[2];
+};
+
+// Tiles of one mesh placed on a lattice by the vertex shader rather than
+// from instances. Instance n of the draw is the tile in column
+// first_column + n % columns and row first_row + n / columns, at
+// linear * p + column * column_step + row * row_step + offset. A tile whose
+// bounding circle, centred bounds[0], bounds[1] from that cell with radius
+// bounds[2], misses the region given with the draw is dropped.
+struct LatticeDraw
+{
+    int mesh;
+    float linear[4];
+    float offset[2];
+    float column_step[2];
+    float row_step[2];
+    int first_column;
+    int first_row;
+    unsigned int columns;
+    size_t count;
+    float bounds[3];
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,138 @@
+#ifndef TSL_GRAPHICS_TILE_RENDERER_H
+#define TSL_GRAPHICS_TILE_RENDERER_H
+
+#include <common.h>
+#include <graphics/mesh_builder.h>
+#include <graphics/raster.h>
+#include <graphics/shader.h>
+#include <graphics/stream_buffer.h>
+#include <graphics/tile.h>
+
+enum RenderBackend
+{
+    RENDER_BACKEND_GL,
+    RENDER_BACKEND_CPU
+};
+
+// Uniform buffer binding point of the TileLattice block.
+#define TILE_LATTICE_BINDING SHADER_FIRST_FREE_BINDING
+
+enum TileDrawMode
+{
+    TILE_DRAW_INSTANCED,
+    TILE_DRAW_PER_TILE,
+
+    // Draws what set_tile_lattice gave, with no per-tile data.
+    TILE_DRAW_PROCEDURAL
+};
+
+struct TileRenderer
+{
+    enum RenderBackend backend;
+
+    struct Shader instanced_shader;
+    struct Shader per_tile_shader;
+    struct ShaderVariable *per_tile_model;
+    struct Shader procedural_shader;
+
+    // Camera from set_tile_view, and with the GL backend the View and
+    // Material blocks every program reads; see SHADER_VIEW_BINDING.
+    float view[16];
+    float projection[16];
+    unsigned int view_buffer;
+    unsigned int material_buffer;
+
+    // The meshes are packed into one vertex and one index buffer; see
+    // PackedMeshes. index_offset is in bytes.
+    int mesh_count;
+    unsigned int vao[TILE_MESH_MAX_COUNT];
+    unsigned int vertex_buffer;
+    unsigned int index_buffer;
+    unsigned int index_type;
+    size_t index_offset[TILE_MESH_MAX_COUNT];
+    size_t index_count[TILE_MESH_MAX_COUNT];
+
+    // All instances live in one buffer, grouped by mesh.
+    unsigned int instance_buffer;
+    struct TileInstance *instances;
+    size_t instance_capacity;
+    size_t instance_first[TILE_MESH_MAX_COUNT];
+    size_t instance_count[TILE_MESH_MAX_COUNT];
+
+    // The draws of TILE_DRAW_PROCEDURAL. Each one's TileLattice block sits
+    // lattice_stride bytes after the last in lattice_buffer.
+    struct LatticeDraw lattice_draws[TILE_LATTICE_MAX_DRAWS];
+    int lattice_draw_count;
+    unsigned int lattice_buffer;
+    size_t lattice_stride;
+
+    // Instances from map_tile_instances, created on first use. streaming
+    // is set while the instances drawn live there rather than in
+    // instance_buffer, and stream_mapped while a region is mapped for
+    // commit_tile_instances.
+    struct StreamBuffer instance_stream;
+    bool streaming;
+    bool stream_mapped;
+
+    // CPU backend only. Mesh data is referenced, not copied.
+    struct TileMesh meshes[TILE_MESH_MAX_COUNT];
+    struct Rasterizer rasterizer;
+    struct RasterTarget *target;
+};
+
+// The GL backend uploads the meshes in format, or the default VertexFormat
+// when it is NULL. The CPU backend rasterizes the TileMesh data as it is; it
+// makes no GL calls and needs no context, and draws into the target given
+// to set_tile_render_target, spreading the work over pool when one is
+// given. pool must outlive the renderer.
+bool init_tile_renderer(
+    struct TileRenderer *renderer,
+    enum RenderBackend backend,
+    const struct TileMesh *meshes,
+    int mesh_count,
+    const struct VertexFormat *format,
+    struct ThreadPool *pool
+);
+void destroy_tile_renderer(struct TileRenderer *renderer);
+void set_tile_render_target(struct TileRenderer *renderer, struct RasterTarget *target);
+
+// instances holds counts[0] instances of mesh 0, then counts[1] of mesh 1...
+void set_tile_instances(
+    struct TileRenderer *renderer,
+    const struct TileInstance *instances,
+    const size_t *counts
+);
+// For instances that change from frame to frame: returns room for total
+// instances, which the caller writes in the layout set_tile_instances takes
+// and hands over with commit_tile_instances. With GL this is a region of a
+// mapped ring buffer, so nothing is copied; it is write-only and only the
+// instanced draw path reads it. Returns NULL on failure; the commit that
+// follows then draws nothing.
+struct TileInstance* map_tile_instances(struct TileRenderer *renderer, size_t total);
+void commit_tile_instances(struct TileRenderer *renderer, const size_t *counts);
+
+// GL backend only. Tiles for TILE_DRAW_PROCEDURAL, which only uploads
+// these few draws however many tiles they cover. Tiles whose bounds miss
+// region are dropped; NULL keeps them all. Returns false, and draws
+// nothing, when there are more than TILE_LATTICE_MAX_DRAWS draws.
+bool set_tile_lattice(
+    struct TileRenderer *renderer,
+    const struct LatticeDraw *draws,
+    int draw_count,
+    const float *region
+);
+
+size_t get_tile_instance_count(const struct TileRenderer *renderer);
+
+// The rectangle x0, y0, x1, y1 of the z = 0 plane, where tiles lie, that
+// view and projection show.
+void get_visible_region(const float *view, const float *projection, float *region);
+
+// The camera for the draws that follow. Only needs calling when it
+// changes; the GL backend uploads it once for all programs.
+void set_tile_view(struct TileRenderer *renderer, const float *view, const float *projection);
+
+void clear_tiles(struct TileRenderer *renderer, const float *color);
+void draw_tiles(struct TileRenderer *renderer, enum TileDrawMode mode);
+
+#endif
\ No newline at end of file
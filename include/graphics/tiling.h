@@ -0,0 +1,165 @@
+#ifndef TSL_GRAPHICS_TILING_H
+#define TSL_GRAPHICS_TILING_H
+
+#include <common.h>
+#include <graphics/tile.h>
+#include <graphics/wallpaper.h>
+
+// The demo tile in two colourings: mesh 0 for plain tiles and mesh 1 for
+// mirrored ones.
+#define DEMO_TILE_MESH_COUNT 2
+
+#define DEMO_TILING_COLUMNS 9
+#define DEMO_TILING_ROWS    2
+
+// meshes must hold DEMO_TILE_MESH_COUNT entries. The vertex and index data
+// is static.
+void get_demo_tile_meshes(struct TileMesh *meshes);
+
+// The same tiles with the border drawn under the fill instead of around it,
+// as the demo tile used to be, to measure the overdraw that saves.
+void get_layered_demo_tile_meshes(struct TileMesh *meshes);
+
+// Lays out `rows` rows of plain tiles interleaved with `rows` rows of
+// mirrored tiles, centred the same way as the original 2x9 demo loops.
+// instances must hold 2 * rows * columns entries; counts receives the
+// number of instances of each mesh.
+void build_tiling(struct TileInstance *instances, size_t *counts, unsigned int columns, unsigned int rows);
+
+// The instances build_tiling would write that overlap region (x0, y0, x1,
+// y1), in the same order, found without visiting the others. With
+// instances NULL only counts are filled in. Returns the total.
+size_t build_visible_tiling(
+    struct TileInstance *instances,
+    size_t *counts,
+    unsigned int columns,
+    unsigned int rows,
+    const float *region
+);
+
+// The tiles build_visible_tiling would write for region as LatticeDraws,
+// at most one per mesh, which need no region of their own. Returns the
+// total.
+size_t build_visible_lattice(
+    struct LatticeDraw *draws,
+    int *draw_count,
+    unsigned int columns,
+    unsigned int rows,
+    const float *region
+);
+
+// Picks columns and rows for a tiling of about tile_count tiles.
+void get_tiling_size(size_t tile_count, unsigned int *columns, unsigned int *rows);
+
+#define TILING_MAX_PROTOTILES         4
+#define TILING_MAX_PROTOTILE_VERTICES 12
+
+// Each prototile gets one mesh for copies placed by rotations and
+// translations and one for copies placed by reflections and glide
+// reflections, in that order.
+#define TILING_MAX_MESHES        (2 * TILING_MAX_PROTOTILES)
+#define TILING_MAX_MESH_VERTICES (3 * TILING_MAX_PROTOTILE_VERTICES + 1)
+#define TILING_MAX_MESH_INDICES  (9 * TILING_MAX_PROTOTILE_VERTICES)
+
+// A polygon filled with one colour inside a border band border_inset wide.
+// Vertices are x, y pairs in world units, in either winding; the polygon
+// must be star-shaped around the mean of its vertices, which every convex
+// polygon is.
+struct Prototile
+{
+    const float *vertices;
+    int vertex_count;
+    float border_inset;
+    float border_color[3];
+
+    // fill_colors[1] is used for the mirrored copies.
+    float fill_colors[2][3];
+};
+
+// A motif of prototiles repeated by the operations of a wallpaper group over
+// a lattice, which must have the group's lattice type. See
+// get_default_lattice and get_fundamental_domain.
+struct TilingDescription
+{
+    const struct WallpaperGroup *group;
+    float lattice[2][2];
+    const struct Prototile *prototiles;
+    int prototile_count;
+};
+
+// A description resolved to world-space transforms and tile meshes. Holds
+// its own mesh data, so the description can go once it is initialised.
+struct Tiling
+{
+    float lattice[2][2];
+    float inverse_lattice[2][2];
+
+    int operation_count;
+    struct TileInstance operations[WALLPAPER_MAX_OPERATIONS];
+    bool mirrored[WALLPAPER_MAX_OPERATIONS];
+
+    // Bounding circle of every prototile under every operation, relative to
+    // the cell origin: x, y and radius.
+    int prototile_count;
+    float bounds[WALLPAPER_MAX_OPERATIONS][TILING_MAX_PROTOTILES][3];
+    float cell_radius;
+
+    int mesh_count;
+    struct TileMesh meshes[TILING_MAX_MESHES];
+    float vertex_data[TILING_MAX_MESHES][6 * TILING_MAX_MESH_VERTICES];
+    unsigned int index_data[TILING_MAX_PROTOTILES][TILING_MAX_MESH_INDICES];
+};
+
+bool init_tiling(struct Tiling *tiling, const struct TilingDescription *description);
+
+// Regions are axis-aligned rectangles given as x0, y0, x1, y1.
+//
+// The capacity is an upper bound on the tiles generated for region, found
+// without visiting them.
+size_t get_tiling_capacity(const struct Tiling *tiling, const float *region);
+
+// Writes every tile that overlaps region in a single pass, grouped by mesh
+// for set_tile_instances: counts receives mesh_count entries. instances must
+// hold get_tiling_capacity entries, or be NULL to only count the tiles.
+// Returns the number of tiles.
+size_t generate_tiling(const struct Tiling *tiling, const float *region, struct TileInstance *instances, size_t *counts);
+
+// The tiles of region as LatticeDraws, one for every pair of operation and
+// prototile; draws must hold TILING_MAX_PROTOTILES *
+// WALLPAPER_MAX_OPERATIONS entries. The draws cover whole lattice rows, so
+// region has to be given with them for the shader to drop the tiles that
+// generate_tiling would leave out. Returns the number of tiles drawn
+// before that.
+size_t generate_tiling_lattice(
+    const struct Tiling *tiling,
+    const float *region,
+    struct LatticeDraw *draws,
+    int *draw_count
+);
+
+// Like generate_tiling but writes the tiles as one transformed triangle
+// list in the TileMesh vertex layout, for consumers without instancing.
+// vertices and indices must hold the capacities returned by
+// get_tiling_geometry_capacity. Returns the number of indices written.
+void get_tiling_geometry_capacity(
+    const struct Tiling *tiling,
+    const float *region,
+    size_t *vertex_capacity,
+    size_t *index_capacity
+);
+size_t generate_tiling_geometry(
+    const struct Tiling *tiling,
+    const float *region,
+    float *vertices,
+    unsigned int *indices,
+    size_t *vertex_count
+);
+
+// A square region centred on the origin holding about tile_count tiles.
+void get_tiling_region(const struct Tiling *tiling, size_t tile_count, float *region);
+
+// The group's fundamental domain on its default lattice, bordered and
+// coloured like the demo tile.
+bool init_wallpaper_tiling(struct Tiling *tiling, const struct WallpaperGroup *group);
+
+#endif
\ No newline at end of file
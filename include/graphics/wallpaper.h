@@ -0,0 +1,65 @@
+#ifndef TSL_GRAPHICS_WALLPAPER_H
+#define TSL_GRAPHICS_WALLPAPER_H
+
+#include <common.h>
+
+#define WALLPAPER_GROUP_COUNT         17
+#define WALLPAPER_MAX_OPERATIONS      12
+#define WALLPAPER_MAX_DOMAIN_VERTICES 5
+
+// The shape of the unit cell a group needs for its operations to be
+// isometries. Centred rectangular groups (cm, cmm) use the conventional
+// rectangular cell with the centring translation among their operations.
+enum LatticeType
+{
+    LATTICE_OBLIQUE,
+    LATTICE_RECTANGULAR,
+    LATTICE_SQUARE,
+
+    // Basis vectors of equal length 120 degrees apart.
+    LATTICE_HEXAGONAL
+};
+
+// An affine map in lattice coordinates, (x, y) -> M (x, y) + t with M
+// stored row-major. Integer entries are all the 17 groups need.
+struct SymmetryOperation
+{
+    int matrix[4];
+    float translation[2];
+};
+
+struct WallpaperGroup
+{
+    // International short symbol, e.g. "p4m".
+    const char *name;
+    enum LatticeType lattice;
+
+    // One operation per copy of the motif in the unit cell, the identity
+    // first. Lattice translations are not listed.
+    int operation_count;
+    struct SymmetryOperation operations[WALLPAPER_MAX_OPERATIONS];
+
+    // A convex fundamental domain in lattice coordinates, counter-clockwise.
+    // Its images under the operations and lattice translations cover the
+    // plane without overlapping.
+    int domain_vertex_count;
+    float domain[WALLPAPER_MAX_DOMAIN_VERTICES][2];
+};
+
+// index is in [0, WALLPAPER_GROUP_COUNT), in the order of the International
+// Tables (p1, p2, pm, ... p6m).
+const struct WallpaperGroup* get_wallpaper_group(int index);
+
+// Returns NULL for an unknown name.
+const struct WallpaperGroup* find_wallpaper_group(const char *name);
+
+// Basis vectors a = lattice[0] and b = lattice[1] of a unit-sized cell of
+// the group's lattice type.
+void get_default_lattice(const struct WallpaperGroup *group, float lattice[2][2]);
+
+// Writes the group's fundamental domain over lattice to vertices as x, y
+// pairs in world units, which makes a prototile that tiles the plane.
+// Returns the vertex count.
+int get_fundamental_domain(const struct WallpaperGroup *group, const float lattice[2][2], float *vertices);
+
+#endif
\ No newline at end of file
@@ -3,6 +3,28 @@
 
 #include <common.h>
 
+// Subsystem an allocation is charged to. A source file picks the tag for
+// all of its allocations by defining MEMORY_TAG before its first include;
+// files that don't are charged to MEMORY_TAG_GENERAL. A block must be
+// resized and freed under the tag it was allocated with.
+enum MemoryTag
+{
+    MEMORY_TAG_GENERAL,
+    MEMORY_TAG_EXPORT,
+    MEMORY_TAG_GEOMETRY,
+    MEMORY_TAG_SHADER,
+    MEMORY_TAG_LOG,
+    MEMORY_TAG_PROFILE,
+    MEMORY_TAG_COUNT
+};
+
+#ifndef MEMORY_TAG
+#define MEMORY_TAG MEMORY_TAG_GENERAL
+#endif
+
+#define reallocate(block, old_size, new_size) \
+    reallocate_tagged((block), (old_size), (new_size), MEMORY_TAG)
+
 #define ALLOC(type) \
     (type*)reallocate(NULL, 0, sizeof(type))
 
@@ -18,8 +40,118 @@
 #define FREE_S(block, size) \
     reallocate((block), (size), 0)
 
-void* reallocate(void *block, size_t old_size, size_t new_size);
+struct MemoryStats
+{
+    size_t allocated;
+    size_t freed;
+    size_t allocation_count;
+    size_t free_count;
+
+    // High-water mark of allocated - freed. Threads publish their usage in
+    // batches of MEMORY_PUBLISH_BYTES, so when several threads share a tag
+    // the peak can be over by up to that much per thread.
+    size_t peak;
+};
+
+#define MEMORY_PUBLISH_BYTES (64 * 1024)
+
+void* reallocate_tagged(void *block, size_t old_size, size_t new_size, enum MemoryTag tag);
+
+// Totals over every tag.
 size_t get_memory_allocated();
 size_t get_memory_freed();
+size_t get_memory_peak();
+
+void get_memory_stats(enum MemoryTag tag, struct MemoryStats *stats);
+const char* get_memory_tag_name(enum MemoryTag tag);
+
+// Logs usage and peak per tag, and warns about every tag that still has
+// blocks outstanding.
+void log_memory_report();
+
+// Linear allocator for memory that dies all at once. Allocations are bumped
+// out of blocks obtained through reallocate and are only released together
+// by reset_arena or destroy_arena. Not thread-safe.
+#define ARENA_ALLOC(arena, type) \
+    (type*)arena_allocate((arena), sizeof(type), _Alignof(type))
+
+#define ARENA_ALLOC_ARRAY(arena, type, count) \
+    (type*)arena_allocate((arena), (count) * sizeof(type), _Alignof(type))
+
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+struct ArenaBlock;
+
+struct Arena
+{
+    enum MemoryTag tag;
+    struct ArenaBlock *first;
+    struct ArenaBlock *current;
+    size_t block_size;
+
+    // Bytes handed out since the last reset, and bytes held in blocks.
+    size_t used;
+    size_t reserved;
+};
+
+// A position to rewind an arena to, for scratch memory nested inside a
+// longer-lived use of the same arena.
+struct ArenaMark
+{
+    struct ArenaBlock *block;
+    size_t offset;
+    size_t used;
+};
+
+// block_size of 0 uses ARENA_DEFAULT_BLOCK_SIZE. Requests larger than a
+// block get a block of their own.
+void init_arena(struct Arena *arena, size_t block_size, enum MemoryTag tag);
+void destroy_arena(struct Arena *arena);
+
+// Returns NULL only if the system is out of memory. alignment must be a
+// power of two.
+void* arena_allocate(struct Arena *arena, size_t size, size_t alignment);
+
+// Forgets every allocation but keeps the blocks for reuse.
+void reset_arena(struct Arena *arena);
+
+struct ArenaMark get_arena_mark(const struct Arena *arena);
+void rewind_arena(struct Arena *arena, struct ArenaMark mark);
+
+// Fixed-size blocks with a free list, for records that are created and
+// destroyed one at a time in large numbers. Blocks are carved out of chunks
+// obtained through reallocate, which are only returned by
+// destroy_block_pool. Not thread-safe.
+#define POOL_ALLOC(pool, type) \
+    (type*)pool_allocate((pool), sizeof(type))
+
+#define POOL_FREE(pool, block) \
+    pool_free((pool), (block))
+
+struct PoolChunk;
+
+struct BlockPool
+{
+    enum MemoryTag tag;
+    size_t block_size;
+    size_t blocks_per_chunk;
+    struct PoolChunk *chunks;
+    void *free_list;
+
+    // Carving position in the newest chunk, so chunks are not threaded onto
+    // the free list up front.
+    uint8_t *next;
+    uint8_t *end;
+
+    size_t live_count;
+};
+
+// blocks_per_chunk of 0 sizes chunks to about 64 KiB.
+void init_block_pool(struct BlockPool *pool, size_t block_size, size_t blocks_per_chunk, enum MemoryTag tag);
+void destroy_block_pool(struct BlockPool *pool);
+// Returns NULL if the system is out of memory or size is larger than the
+// pool's blocks.
+void* pool_allocate(struct BlockPool *pool, size_t size);
+void pool_free(struct BlockPool *pool, void *block);
 
 #endif
\ No newline at end of file
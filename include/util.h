@@ -1,6 +1,16 @@
 #ifndef TSL_UTIL_H
 #define TSL_UTIL_H
 
+#include <stdio.h>
+
 void get_time(char *buffer, int max_size, const char *format);
 
+// Seconds from an arbitrary fixed point, for measuring intervals. Does not
+// depend on GLFW being initialised.
+double get_monotonic_time();
+
+// Writes string quoted, with quotes, backslashes and control characters
+// escaped for JSON.
+void write_json_string(FILE *file, const char *string);
+
 #endif
\ No newline at end of file
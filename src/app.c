@@ -1,24 +1,398 @@
 #include <app.h>
 #include <common.h>
 #include <memory.h>
+#include <util.h>
+#include <core/headless.h>
 #include <core/log.h>
+#include <core/profile.h>
+#include <graphics/capture.h>
+#include <graphics/framebuffer.h>
+#include <graphics/png.h>
 #include <graphics/shader.h>
+#include <graphics/tile_renderer.h>
+#include <graphics/tiling.h>
 
 #include <cglm/call.h>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include <stb_image_write.h>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define WINDOW_TITLE "Tessellation"
 
+// Edge length of the finest Penrose rhombi; the view is 4 units tall.
+#define PENROSE_TILE_SIZE 0.25f
+
+// How often an idle on-demand view checks on screenshots still being read.
+#define CAPTURE_POLL_INTERVAL 0.01
+
+// Default strip size for exports, about 256 MiB of pixels per strip.
+#define EXPORT_STRIP_BYTES ((size_t)256 << 20)
+
 struct Application* get_app_instance()
 {
     static struct Application app;
     return &app;
 }
 
+bool parse_app_config(struct AppConfig *config, int argc, char **argv)
+{
+    config->compare_draw = false;
+    config->compare_frames = 10;
+    config->headless = false;
+    config->width = 1920;
+    config->height = 1080;
+    config->output_path = "tessellation.png";
+    config->backend = RENDER_BACKEND_GL;
+    config->thread_count = 0;
+    config->tile_count = 0;
+    config->wallpaper_group = NULL;
+    config->penrose_depth = 0;
+    config->procedural = false;
+    get_default_png_options(&config->png);
+    config->sequence_prefix = NULL;
+    config->strip_height = 0;
+    config->log_level = LOG_LEVEL_TRACE;
+    config->log_binary_path = NULL;
+    config->profile_path = NULL;
+    config->stats_path = NULL;
+    config->stats_interval = 60;
+    config->render_on_demand = false;
+    config->max_fps = 0;
+    config->vsync = VSYNC_DEFAULT;
+    config->shader_cache_path = "shader_cache";
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--compare-draw") == 0)
+        {
+            config->compare_draw = true;
+        }
+
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            int frames = atoi(argv[++i]);
+            if (frames <= 0)
+            {
+                LOG_ERROR("Invalid frame count: %s", argv[i]);
+                return false;
+            }
+
+            config->compare_frames = (unsigned int)frames;
+        }
+
+        else if (strcmp(argv[i], "--headless") == 0)
+        {
+            config->headless = true;
+        }
+
+        else if ((strcmp(argv[i], "--width") == 0 || strcmp(argv[i], "--height") == 0) && i + 1 < argc)
+        {
+            bool width = strcmp(argv[i], "--width") == 0;
+            int size = atoi(argv[++i]);
+            if (size <= 0)
+            {
+                LOG_ERROR("Invalid image size: %s", argv[i]);
+                return false;
+            }
+
+            *(width ? &config->width : &config->height) = (unsigned int)size;
+        }
+
+        else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "gl") == 0)
+            {
+                config->backend = RENDER_BACKEND_GL;
+            }
+
+            else if (strcmp(argv[i], "cpu") == 0)
+            {
+                config->backend = RENDER_BACKEND_CPU;
+            }
+
+            else
+            {
+                LOG_ERROR("Unknown backend: %s", argv[i]);
+                return false;
+            }
+        }
+
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            int threads = atoi(argv[++i]);
+            if (threads < 0)
+            {
+                LOG_ERROR("Invalid thread count: %s", argv[i]);
+                return false;
+            }
+
+            config->thread_count = threads;
+        }
+
+        else if (strcmp(argv[i], "--tiles") == 0 && i + 1 < argc)
+        {
+            int tiles = atoi(argv[++i]);
+            if (tiles < 2)
+            {
+                LOG_ERROR("Invalid tile count: %s", argv[i]);
+                return false;
+            }
+
+            config->tile_count = (unsigned int)tiles;
+        }
+
+        else if (strcmp(argv[i], "--group") == 0 && i + 1 < argc)
+        {
+            config->wallpaper_group = find_wallpaper_group(argv[++i]);
+            if (config->wallpaper_group == NULL)
+            {
+                LOG_ERROR("Unknown wallpaper group: %s", argv[i]);
+                return false;
+            }
+        }
+
+        else if (strcmp(argv[i], "--penrose") == 0 && i + 1 < argc)
+        {
+            int depth = atoi(argv[++i]);
+            if (depth <= 0 || depth > PENROSE_MAX_DEPTH)
+            {
+                LOG_ERROR("Invalid Penrose depth: %s", argv[i]);
+                return false;
+            }
+
+            config->penrose_depth = (unsigned int)depth;
+        }
+
+        else if (strcmp(argv[i], "--procedural") == 0)
+        {
+            config->procedural = true;
+        }
+
+        else if (strcmp(argv[i], "--png-level") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (argv[i][0] < '0' || argv[i][0] > '9' || argv[i][1] != '\0')
+            {
+                LOG_ERROR("Invalid PNG compression level: %s", argv[i]);
+                return false;
+            }
+
+            config->png.level = argv[i][0] - '0';
+        }
+
+        else if (strcmp(argv[i], "--png-filter") == 0 && i + 1 < argc)
+        {
+            if (!parse_png_filter(argv[++i], &config->png.filter))
+            {
+                LOG_ERROR("Unknown PNG filter: %s", argv[i]);
+                return false;
+            }
+        }
+
+        else if (strcmp(argv[i], "--strip-height") == 0 && i + 1 < argc)
+        {
+            int rows = atoi(argv[++i]);
+            if (rows <= 0)
+            {
+                LOG_ERROR("Invalid strip height: %s", argv[i]);
+                return false;
+            }
+
+            config->strip_height = (unsigned int)rows;
+        }
+
+        else if (strcmp(argv[i], "--sequence") == 0 && i + 1 < argc)
+        {
+            config->sequence_prefix = argv[++i];
+        }
+
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            config->output_path = argv[++i];
+        }
+
+        else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc)
+        {
+            if (!parse_log_level(argv[++i], &config->log_level))
+            {
+                LOG_ERROR("Unknown log level: %s", argv[i]);
+                return false;
+            }
+        }
+
+        else if (strcmp(argv[i], "--log-binary") == 0 && i + 1 < argc)
+        {
+            config->log_binary_path = argv[++i];
+        }
+
+        else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc)
+        {
+            config->stats_path = argv[++i];
+        }
+
+        else if (strcmp(argv[i], "--stats-interval") == 0 && i + 1 < argc)
+        {
+            int frames = atoi(argv[++i]);
+            if (frames <= 0)
+            {
+                LOG_ERROR("Invalid stats interval: %s", argv[i]);
+                return false;
+            }
+
+            config->stats_interval = (unsigned int)frames;
+        }
+
+        else if (strcmp(argv[i], "--on-demand") == 0)
+        {
+            config->render_on_demand = true;
+        }
+
+        else if (strcmp(argv[i], "--max-fps") == 0 && i + 1 < argc)
+        {
+            int fps = atoi(argv[++i]);
+            if (fps < 0)
+            {
+                LOG_ERROR("Invalid frame rate: %s", argv[i]);
+                return false;
+            }
+
+            config->max_fps = (unsigned int)fps;
+        }
+
+        else if (strcmp(argv[i], "--vsync") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "on") == 0)
+            {
+                config->vsync = VSYNC_ON;
+            }
+
+            else if (strcmp(argv[i], "off") == 0)
+            {
+                config->vsync = VSYNC_OFF;
+            }
+
+            else
+            {
+                LOG_ERROR("Unknown vsync mode: %s", argv[i]);
+                return false;
+            }
+        }
+
+        else if (strcmp(argv[i], "--vertex-positions") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "float") == 0)
+            {
+                config->vertex_format.position = VERTEX_POSITION_FLOAT;
+            }
+
+            else if (strcmp(argv[i], "snorm16") == 0)
+            {
+                config->vertex_format.position = VERTEX_POSITION_SNORM16;
+            }
+
+            else if (strcmp(argv[i], "half") == 0)
+            {
+                config->vertex_format.position = VERTEX_POSITION_HALF;
+            }
+
+            else
+            {
+                LOG_ERROR("Unknown vertex position format: %s", argv[i]);
+                return false;
+            }
+        }
+
+        else if (strcmp(argv[i], "--vertex-colors") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "unorm8") == 0)
+            {
+                config->vertex_format.color = VERTEX_COLOR_UNORM8;
+            }
+
+            else if (strcmp(argv[i], "palette") == 0)
+            {
+                config->vertex_format.color = VERTEX_COLOR_PALETTE;
+            }
+
+            else
+            {
+                LOG_ERROR("Unknown vertex colour format: %s", argv[i]);
+                return false;
+            }
+        }
+
+        else if (strcmp(argv[i], "--shader-cache") == 0 && i + 1 < argc)
+        {
+            config->shader_cache_path = argv[++i];
+        }
+
+        else if (strcmp(argv[i], "--no-shader-cache") == 0)
+        {
+            config->shader_cache_path = NULL;
+        }
+
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+        {
+#ifdef TSL_PROFILE
+            config->profile_path = argv[++i];
+#else
+            LOG_ERROR("--profile requires a build with TSL_PROFILE enabled");
+            return false;
+#endif
+        }
+
+        else
+        {
+            LOG_ERROR("Unknown argument: %s", argv[i]);
+            return false;
+        }
+    }
+
+    if (config->penrose_depth > 0 && config->wallpaper_group != NULL)
+    {
+        LOG_ERROR("--penrose and --group can't be combined");
+        return false;
+    }
+
+    // Penrose tiles sit on no lattice.
+    if (config->penrose_depth > 0 && config->procedural)
+    {
+        LOG_ERROR("--procedural can't be combined with --penrose");
+        return false;
+    }
+
+    // The CPU backend has nothing to present to, and the comparison is
+    // between two ways of submitting GL draws.
+    if (config->backend == RENDER_BACKEND_CPU)
+    {
+        if (config->compare_draw)
+        {
+            LOG_ERROR("--compare-draw requires the GL backend");
+            return false;
+        }
+
+        if (config->procedural)
+        {
+            LOG_ERROR("--procedural requires the GL backend");
+            return false;
+        }
+
+        config->headless = true;
+    }
+
+    return true;
+}
+
 static void glfw_error_callback(int error_code, const char *description)
 {
     LOG_ERROR("GLFW Error(%d): %s", error_code, description);
@@ -29,11 +403,61 @@ static void window_resize_callback(GLFWwindow *window, int width, int height)
     struct WindowData *data = (struct WindowData*)glfwGetWindowUserPointer(window);
     data->width = width;
     data->height = height;
+    get_app_instance()->view_dirty = true;
+    get_app_instance()->redraw_requested = true;
 }
 
 static void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 {
     glViewport(0, 0, width, height);
+    get_app_instance()->view_dirty = true;
+    get_app_instance()->redraw_requested = true;
+}
+
+// The window system lost the window's contents, e.g. after it was uncovered.
+static void window_refresh_callback(GLFWwindow *window)
+{
+    get_app_instance()->redraw_requested = true;
+}
+
+static void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    struct Application *app = get_app_instance();
+    if (key == GLFW_KEY_F12 && action == GLFW_PRESS)
+    {
+        app->screenshot_requested = true;
+        app->redraw_requested = true;
+    }
+
+    if (app->config.penrose_depth == 0 || (action != GLFW_PRESS && action != GLFW_REPEAT))
+        return;
+
+    // A tenth of the view height per step. The camera looks down +z, so
+    // world x runs right to left on screen.
+    float step = 0.4f / app->view_zoom;
+    switch (key)
+    {
+        case GLFW_KEY_LEFT:  app->view_center[0] += step; break;
+        case GLFW_KEY_RIGHT: app->view_center[0] -= step; break;
+        case GLFW_KEY_UP:    app->view_center[1] += step; break;
+        case GLFW_KEY_DOWN:  app->view_center[1] -= step; break;
+
+        case GLFW_KEY_EQUAL:
+        case GLFW_KEY_KP_ADD:
+            app->view_zoom *= 1.25f;
+            break;
+
+        case GLFW_KEY_MINUS:
+        case GLFW_KEY_KP_SUBTRACT:
+            app->view_zoom /= 1.25f;
+            break;
+
+        default:
+            return;
+    }
+
+    app->view_dirty = true;
+    app->redraw_requested = true;
 }
 
 static bool init_window(struct Window *window)
@@ -88,309 +512,894 @@ static bool init_window(struct Window *window)
     glfwSetWindowUserPointer(window->native_window, &window->data);
     glfwSetWindowSizeCallback(window->native_window, window_resize_callback);
     glfwSetFramebufferSizeCallback(window->native_window, framebuffer_size_callback);
+    glfwSetWindowRefreshCallback(window->native_window, window_refresh_callback);
+    glfwSetKeyCallback(window->native_window, key_callback);
 
     return true;
 }
 
 bool init_app(struct Application *app)
 {
+    set_log_level(app->config.log_level);
+    set_shader_cache_directory(app->config.shader_cache_path);
+    if (app->config.log_binary_path != NULL && !open_binary_log(app->config.log_binary_path))
+        return false;
+
+#ifdef TSL_PROFILE
+    if (app->config.profile_path != NULL && !start_profiler(app->config.profile_path))
+        return false;
+#endif
+    PROFILE_THREAD("main");
+
     LOG_TRACE("Initialising application...");
 
+    app->start_time = get_monotonic_time();
     glfwSetErrorCallback(glfw_error_callback);
+    app->running = false;
+    app->view_center[0] = 0.0f;
+    app->view_center[1] = 0.0f;
+    app->view_zoom = 1.0f;
+    app->view_dirty = true;
+    init_arena(&app->frame_arena, 0, MEMORY_TAG_GENERAL);
+
+    // Shared by the CPU rasterizer and the PNG encoder.
+    PROFILE_BEGIN("init_thread_pool");
+    bool pool_started = init_thread_pool(&app->thread_pool, app->config.thread_count);
+    PROFILE_END();
+
+    if (!pool_started)
+    {
+        LOG_ERROR("Failed to start worker threads!");
+        return false;
+    }
+    LOG_TRACE("Using %d worker threads", app->thread_pool.worker_count);
 
-    if (!glfwInit())
+    if (app->config.headless)
+    {
+        app->window.native_window = NULL;
+        app->window.data.title = WINDOW_TITLE;
+        app->window.data.width = app->config.width;
+        app->window.data.height = app->config.height;
+
+        if (app->config.backend == RENDER_BACKEND_CPU)
+        {
+            app->headless.backend = HEADLESS_BACKEND_NONE;
+            return true;
+        }
+
+        PROFILE_BEGIN("init_headless_context");
+        bool context_created = init_headless_context(&app->headless);
+        PROFILE_END();
+
+        if (!context_created)
+        {
+            LOG_ERROR("Failed to initialise headless context!");
+            return false;
+        }
+
+        LOG_TRACE("Using headless context: %s", get_headless_backend_name(app->headless.backend));
+        return true;
+    }
+
+    PROFILE_BEGIN("glfwInit");
+    bool glfw_initialised = glfwInit();
+    PROFILE_END();
+
+    if (!glfw_initialised)
     {
         LOG_ERROR("Failed to initialise GLFW!");
         return false;
     }
 
-    if (!init_window(&app->window))
+    PROFILE_BEGIN("init_window");
+    bool window_created = init_window(&app->window);
+    PROFILE_END();
+
+    if (!window_created)
     {
         LOG_ERROR("Failed to initialize window!");
         return false;
     }
 
-    app->running = false;
+    if (app->config.vsync != VSYNC_DEFAULT)
+    {
+        glfwSwapInterval(app->config.vsync == VSYNC_ON ? 1 : 0);
+    }
+
     return true;
 }
 
 void destroy_app(struct Application *app)
 {
     LOG_TRACE("Cleaning up application...");
-    LOG_INFO("Memory allocated: %zu", get_memory_allocated());
-    LOG_INFO("Memory freed: %zu", get_memory_freed());
+
+    if (app->thread_pool.worker_count > 0)
+    {
+        destroy_thread_pool(&app->thread_pool);
+    }
+    destroy_arena(&app->frame_arena);
+
+    if (app->config.penrose_depth > 0)
+    {
+        destroy_penrose_tiling(&app->penrose);
+    }
+
+    // Every other thread has stopped, and the GL context is still current
+    // for the last GPU timings.
+#ifdef TSL_PROFILE
+    if (app->config.profile_path != NULL)
+    {
+        stop_profiler();
+    }
+#endif
+
+    log_memory_report();
+    close_binary_log();
+
+    if (app->config.headless)
+    {
+        destroy_headless_context(&app->headless);
+        return;
+    }
 
     glfwDestroyWindow(app->window.native_window);
     glfwTerminate();
 }
 
-static void save_buffer_to_image(int width, int height)
+// Projection for the part of the image that starts x pixels from the left
+// and y pixels from the top, so an image can be rendered in pieces. The
+// whole image spans 4 / view_zoom units vertically.
+static void compute_region_projection(
+    struct Application *app,
+    int x,
+    int y,
+    int width,
+    int height,
+    mat4 projection)
 {
-    LOG_TRACE("Saving buffer to file: tessellation.png");
+    double image_width = (double)app->window.data.width;
+    double image_height = (double)app->window.data.height;
+    double aspect_ratio = 2.0 * image_width / image_height;
+    double zoom = app->view_zoom;
+
+    glmc_ortho(
+        (float)((-aspect_ratio + 2.0 * aspect_ratio * x / image_width) / zoom),
+        (float)((-aspect_ratio + 2.0 * aspect_ratio * (x + width) / image_width) / zoom),
+        (float)((2.0 - 4.0 * (y + height) / image_height) / zoom),
+        (float)((2.0 - 4.0 * y / image_height) / zoom),
+        0.1f, 100.0f,
+        projection
+    );
+}
 
-    const int size = 4 * width * height;
-    unsigned char *data = ALLOC_ARRAY(unsigned char, size);
-    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
+static void compute_view_projection(struct Application *app, mat4 view, mat4 projection)
+{
+    float x = app->view_center[0];
+    float y = app->view_center[1];
+    glmc_lookat(
+        (vec3){ x, y, -3.0f },
+        (vec3){ x, y,  0.0f },
+        (vec3){ 0.0f, 1.0f, 0.0f },
+        view
+    );
 
-    int status = (int)glGetError();
-    if (status != GL_NO_ERROR)
+    compute_region_projection(
+        app,
+        0, 0,
+        (int)app->window.data.width,
+        (int)app->window.data.height,
+        projection
+    );
+}
+
+static double time_draw_path(
+    struct TileRenderer *renderer,
+    enum TileDrawMode mode,
+    unsigned int frames)
+{
+    // One untimed frame so first-use driver work is not measured.
+    glClear(GL_COLOR_BUFFER_BIT);
+    draw_tiles(renderer, mode);
+    glFinish();
+
+    double start = get_monotonic_time();
+    for (unsigned int i = 0; i < frames; i++)
     {
-        LOG_ERROR("GL ERROR (%d)", status);
+        glClear(GL_COLOR_BUFFER_BIT);
+        draw_tiles(renderer, mode);
+        glFinish();
+        PROFILE_FRAME();
     }
 
-    else
+    return 1000.0 * (get_monotonic_time() - start) / frames;
+}
+
+static void compare_draw_paths(struct Application *app, struct TileRenderer *renderer)
+{
+    static const size_t tile_counts[] = { 10000, 100000, 1000000 };
+    static const float everywhere[4] = { -FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX };
+
+    mat4 view, projection;
+    compute_view_projection(app, view, projection);
+    set_tile_view(renderer, (float*)view, (float*)projection);
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    LOG_INFO("Draw path comparison over %u frames:", app->config.compare_frames);
+    for (size_t i = 0; i < sizeof(tile_counts) / sizeof(tile_counts[0]); i++)
+    {
+        unsigned int columns, rows;
+        get_tiling_size(tile_counts[i], &columns, &rows);
+        size_t count = 2 * (size_t)rows * columns;
+
+        struct TileInstance *instances = ALLOC_ARRAY(struct TileInstance, count);
+        size_t counts[2];
+        build_tiling(instances, counts, columns, rows);
+        set_tile_instances(renderer, instances, counts);
+        FREE_ARRAY(instances, struct TileInstance, count);
+
+        struct LatticeDraw draws[2];
+        int draw_count;
+        build_visible_lattice(draws, &draw_count, columns, rows, everywhere);
+        set_tile_lattice(renderer, draws, draw_count, NULL);
+
+        double instanced = time_draw_path(renderer, TILE_DRAW_INSTANCED, app->config.compare_frames);
+        double per_tile = time_draw_path(renderer, TILE_DRAW_PER_TILE, app->config.compare_frames);
+        double procedural = time_draw_path(renderer, TILE_DRAW_PROCEDURAL, app->config.compare_frames);
+
+        LOG_INFO(
+            "%8zu tiles | instanced %9.3f ms (%d draws) | per-tile %9.3f ms (%zu draws) | %.1fx | "
+            "procedural %9.3f ms (%d draws)",
+            count,
+            instanced, renderer->mesh_count,
+            per_tile, count,
+            per_tile / instanced,
+            procedural, draw_count
+        );
+    }
+}
+
+// Everything the view shows in world units; see compute_region_projection.
+static void get_view_region(struct Application *app, float *region)
+{
+    float half_height = 2.0f / app->view_zoom;
+    float half_width = half_height * app->window.data.width / app->window.data.height;
+    region[0] = app->view_center[0] - half_width;
+    region[1] = app->view_center[1] - half_height;
+    region[2] = app->view_center[0] + half_width;
+    region[3] = app->view_center[1] + half_height;
+}
+
+// Sets the extent of the demo or wallpaper tiling; its tiles are selected
+// per frame by cull_tiles.
+static void init_tiling_extent(struct Application *app)
+{
+    size_t counts[TILING_MAX_MESHES];
+    if (app->config.wallpaper_group != NULL)
     {
-        stbi_flip_vertically_on_write(true);
-        status = stbi_write_png("tessellation.png", width, height, 4, data, 4 * width);
-        if (status == 0)
+        if (app->config.tile_count > 0)
         {
-            LOG_ERROR("Failed to save buffer to file");   
+            get_tiling_region(&app->wallpaper, app->config.tile_count, app->wallpaper_region);
         }
+
+        else
+        {
+            get_view_region(app, app->wallpaper_region);
+        }
+
+        app->tile_count = generate_tiling(&app->wallpaper, app->wallpaper_region, NULL, counts);
+        LOG_INFO("Wallpaper group %s: %zu tiles", app->config.wallpaper_group->name, app->tile_count);
+        return;
+    }
+
+    app->demo_columns = DEMO_TILING_COLUMNS;
+    app->demo_rows = DEMO_TILING_ROWS;
+    if (app->config.tile_count > 0)
+    {
+        get_tiling_size(app->config.tile_count, &app->demo_columns, &app->demo_rows);
     }
 
-    FREE_ARRAY(data, unsigned char, size);
+    app->tile_count = 2 * (size_t)app->demo_rows * app->demo_columns;
 }
 
-int run_app(struct Application *app)
+// Wallpaper tiles that overlap both region and the tiling's extent, written
+// straight into the renderer's instance stream.
+static size_t select_wallpaper_tiles(
+    struct Application *app,
+    struct TileRenderer *renderer,
+    const float *region,
+    size_t *counts)
 {
-    LOG_TRACE("Running application...");
-    app->running = true;
-
-    float model1[] = {
-        // Location           // Color
-         0.0f, 0.0f, 0.0f,    1.0f, 1.0f, 1.0f,
-        -1.0f, 0.0f, 0.0f,    1.0f, 1.0f, 1.0f,
-        -2.0f, 0.5f, 0.0f,    1.0f, 1.0f, 1.0f,
-        -1.0f, 0.5f, 0.0f,    1.0f, 1.0f, 1.0f,
-         0.0f, 1.0f, 0.0f,    1.0f, 1.0f, 1.0f,
-        -1.0f, 1.0f, 0.0f,    1.0f, 1.0f, 1.0f,
-
-        -0.20f, 0.05f, 0.0f,    0.2f, 0.5f, 0.8f,
-        -1.00f, 0.05f, 0.0f,    0.2f, 0.5f, 0.8f,
-        -1.90f, 0.50f, 0.0f,    0.2f, 0.5f, 0.8f,
-        -1.10f, 0.50f, 0.0f,    0.2f, 0.5f, 0.8f,
-        -0.20f, 0.95f, 0.0f,    0.2f, 0.5f, 0.8f,
-        -1.00f, 0.95f, 0.0f,    0.2f, 0.5f, 0.8f
+    const float *extent = app->wallpaper_region;
+    float bounds[4] = {
+        region[0] > extent[0] ? region[0] : extent[0],
+        region[1] > extent[1] ? region[1] : extent[1],
+        region[2] < extent[2] ? region[2] : extent[2],
+        region[3] < extent[3] ? region[3] : extent[3]
     };
 
-    float model2[] = {
-        // Location           // Color
-         0.0f, 0.0f, 0.0f,    1.0f, 1.0f, 1.0f,
-        -1.0f, 0.0f, 0.0f,    1.0f, 1.0f, 1.0f,
-        -2.0f, 0.5f, 0.0f,    1.0f, 1.0f, 1.0f,
-        -1.0f, 0.5f, 0.0f,    1.0f, 1.0f, 1.0f,
-         0.0f, 1.0f, 0.0f,    1.0f, 1.0f, 1.0f,
-        -1.0f, 1.0f, 0.0f,    1.0f, 1.0f, 1.0f,
-
-        -0.20f, 0.05f, 0.0f,    0.9f, 0.9f, 0.2f, 
-        -1.00f, 0.05f, 0.0f,    0.9f, 0.9f, 0.2f, 
-        -1.90f, 0.50f, 0.0f,    0.9f, 0.9f, 0.2f, 
-        -1.10f, 0.50f, 0.0f,    0.9f, 0.9f, 0.2f, 
-        -0.20f, 0.95f, 0.0f,    0.9f, 0.9f, 0.2f, 
-        -1.00f, 0.95f, 0.0f,    0.9f, 0.9f, 0.2f
-    };
+    memset(counts, 0, TILING_MAX_MESHES * sizeof(size_t));
+    bool empty = bounds[0] > bounds[2] || bounds[1] > bounds[3];
+    struct TileInstance *instances = map_tile_instances(
+        renderer, empty ? 0 : get_tiling_capacity(&app->wallpaper, bounds));
+    size_t count = 0;
+    if (instances != NULL && !empty)
+    {
+        count = generate_tiling(&app->wallpaper, bounds, instances, counts);
+    }
 
-    unsigned int indices[] = {
-        // Border.
-        0, 1, 2,
-        0, 3, 2,
-        2, 3, 4,
-        2, 5, 4,
-
-        // Fill.
-        6, 7, 8,
-        6, 9, 8,
-        8, 9, 10,
-        8, 11, 10
+    commit_tile_instances(renderer, counts);
+    return count;
+}
+
+static size_t select_demo_tiles(
+    struct Application *app,
+    struct TileRenderer *renderer,
+    const float *region,
+    size_t *counts)
+{
+    size_t count = build_visible_tiling(NULL, counts, app->demo_columns, app->demo_rows, region);
+    struct TileInstance *instances = map_tile_instances(renderer, count);
+    if (instances == NULL)
+    {
+        counts[0] = 0;
+        counts[1] = 0;
+        count = 0;
+    }
+
+    else
+    {
+        build_visible_tiling(instances, counts, app->demo_columns, app->demo_rows, region);
+    }
+
+    commit_tile_instances(renderer, counts);
+    return count;
+}
+
+// The demo or wallpaper tiles of region as lattice draws for
+// TILE_DRAW_PROCEDURAL; see select_wallpaper_tiles and select_demo_tiles.
+static size_t select_lattice_tiles(struct Application *app, struct TileRenderer *renderer, const float *region)
+{
+    struct LatticeDraw *draws = ARENA_ALLOC_ARRAY(&app->frame_arena, struct LatticeDraw, TILE_LATTICE_MAX_DRAWS);
+    int draw_count = 0;
+    if (draws == NULL)
+    {
+        set_tile_lattice(renderer, NULL, 0, NULL);
+        return 0;
+    }
+
+    if (app->config.wallpaper_group == NULL)
+    {
+        size_t count = build_visible_lattice(draws, &draw_count, app->demo_columns, app->demo_rows, region);
+        return set_tile_lattice(renderer, draws, draw_count, NULL) ? count : 0;
+    }
+
+    const float *extent = app->wallpaper_region;
+    float bounds[4] = {
+        region[0] > extent[0] ? region[0] : extent[0],
+        region[1] > extent[1] ? region[1] : extent[1],
+        region[2] < extent[2] ? region[2] : extent[2],
+        region[3] < extent[3] ? region[3] : extent[3]
     };
 
-    const char *vertex_source =
-        "#version 330 core\n"
-        "layout(location = 0) in vec3 a_Pos;\n"
-        "layout(location = 1) in vec3 a_Color;\n"
-        "out vec4 color;\n"
-        "uniform mat4 model;\n"
-        "uniform mat4 view;\n"
-        "uniform mat4 projection;\n"
-        "void main() {\n"
-        "  color = vec4(a_Color, 1.0);\n"
-        "  gl_Position = projection * view * model * vec4(a_Pos, 1.0);\n"
-        "}";
-    
-    const char *fragment_source =
-        "#version 330 core\n"
-        "in vec4 color;\n"
-        "out vec4 pixel;\n"
-        "void main() {\n"
-        "  pixel = color;\n"
-        "}";
-    
-    unsigned int shader_program = create_shader(vertex_source, fragment_source);
-
-    unsigned int vao[2];
-    glGenVertexArrays(2, vao);
-    glBindVertexArray(vao[0]);
-
-    unsigned int vbo[3];
-    glGenBuffers(3, vbo);
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo[0]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(model1), model1, GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(
-        0,
-        3,
-        GL_FLOAT,
-        GL_FALSE,
-        6 * sizeof(float),
-        (void*)0
-    );
+    size_t count = 0;
+    if (bounds[0] <= bounds[2] && bounds[1] <= bounds[3])
+    {
+        count = generate_tiling_lattice(&app->wallpaper, bounds, draws, &draw_count);
+    }
 
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(
-        1,
-        3,
-        GL_FLOAT,
-        GL_FALSE,
-        6 * sizeof(float),
-        (void*)(3 * sizeof(float))
-    );
+    return set_tile_lattice(renderer, draws, draw_count, bounds) ? count : 0;
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[2]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+static void select_penrose_tiles(struct Application *app, struct TileRenderer *renderer)
+{
+    size_t counts[PENROSE_MESH_COUNT] = { 0 };
+    size_t total = app->penrose.counts[0] + app->penrose.counts[1];
+    struct TileInstance *instances = map_tile_instances(renderer, total);
+    if (instances != NULL)
+    {
+        memcpy(instances, app->penrose.instances, total * sizeof(struct TileInstance));
+        memcpy(counts, app->penrose.counts, sizeof(counts));
+    }
 
-    glBindVertexArray(vao[1]);
+    commit_tile_instances(renderer, counts);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo[1]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(model2), model2, GL_STATIC_DRAW);
+// Uploads the tiles that overlap what view and projection show, height
+// pixels tall, unless they were already selected for the same region. The
+// tiles left out go into render_counters.
+static void cull_tiles(struct Application *app, struct TileRenderer *renderer, mat4 view, mat4 projection, int height)
+{
+    float region[4];
+    get_visible_region((float*)view, (float*)projection, region);
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(
-        0,
-        3,
-        GL_FLOAT,
-        GL_FALSE,
-        6 * sizeof(float),
-        (void*)0
-    );
+    if (!app->has_visible_region || memcmp(region, app->visible_region, sizeof(region)) != 0)
+    {
+        PROFILE_BEGIN("cull_tiles");
+        if (app->config.penrose_depth > 0)
+        {
+            struct PenroseStats stats;
+            float pixels_per_unit = (float)height / (region[3] - region[1]);
+            update_penrose_tiling(&app->penrose, region, pixels_per_unit, &app->frame_arena, &stats);
+            select_penrose_tiles(app, renderer);
+            app->tiles_culled = stats.culled;
+
+            LOG_TRACE(
+                "Penrose view: %zu tiles, %zu triangles visited, %zu created, %zu freed, %zu live",
+                stats.tiles, stats.visited, stats.created, stats.freed, stats.live
+            );
+        }
 
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(
-        1,
-        3,
-        GL_FLOAT,
-        GL_FALSE,
-        6 * sizeof(float),
-        (void*)(3 * sizeof(float))
+        else
+        {
+            size_t counts[TILING_MAX_MESHES];
+            size_t count;
+            if (app->config.procedural)
+            {
+                count = select_lattice_tiles(app, renderer, region);
+            }
+
+            else
+            {
+                count = app->config.wallpaper_group != NULL
+                    ? select_wallpaper_tiles(app, renderer, region, counts)
+                    : select_demo_tiles(app, renderer, region, counts);
+            }
+
+            // Lattice draws cover whole rows, which can take in more wallpaper
+            // tiles than the tiling has; the shader drops those.
+            app->tiles_culled = count < app->tile_count ? app->tile_count - count : 0;
+        }
+
+        memcpy(app->visible_region, region, sizeof(region));
+        app->has_visible_region = true;
+        PROFILE_END();
+    }
+
+    render_counters.tiles_culled += app->tiles_culled;
+}
+
+static void render_region(
+    struct Application *app,
+    struct TileRenderer *renderer,
+    int x,
+    int y,
+    int width,
+    int height)
+{
+    clear_tiles(renderer, (float[]){ 0.0f, 0.0f, 0.0f, 1.0f });
+
+    // The interactive view keeps its camera until something moves it;
+    // export strips each have their own rectangle.
+    int rect[4] = { x, y, width, height };
+    if (app->view_dirty || memcmp(rect, app->view_rect, sizeof(rect)) != 0)
+    {
+        compute_view_projection(app, (vec4*)app->view, (vec4*)app->projection);
+        compute_region_projection(app, x, y, width, height, (vec4*)app->projection);
+        set_tile_view(renderer, app->view, app->projection);
+        memcpy(app->view_rect, rect, sizeof(rect));
+        app->view_dirty = false;
+    }
+
+    cull_tiles(app, renderer, (vec4*)app->view, (vec4*)app->projection, height);
+
+    enum TileDrawMode mode = app->config.procedural ? TILE_DRAW_PROCEDURAL : TILE_DRAW_INSTANCED;
+    draw_tiles(renderer, mode);
+}
+
+static void render_frame(struct Application *app, struct TileRenderer *renderer)
+{
+    PROFILE_BEGIN("render_frame");
+    render_region(
+        app,
+        renderer,
+        0, 0,
+        (int)app->window.data.width,
+        (int)app->window.data.height
     );
+    PROFILE_END();
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[2]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+// A capture path in the frame arena, cut to CAPTURE_PATH_SIZE like the
+// capture's own copy. NULL if the arena is out of memory.
+static const char* format_capture_path(struct Application *app, const char *format, ...)
+{
+    char *path = ARENA_ALLOC_ARRAY(&app->frame_arena, char, CAPTURE_PATH_SIZE);
+    if (path == NULL)
+        return NULL;
 
-    while (app->running)
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(path, CAPTURE_PATH_SIZE, format, arguments);
+    va_end(arguments);
+
+    return path;
+}
+
+// Reads back the frame just drawn when a screenshot or a sequence asks for
+// it; the PNGs are written in the background.
+static void capture_frame(struct Application *app)
+{
+    PROFILE_BEGIN("capture_frame");
+    int width = (int)app->window.data.width;
+    int height = (int)app->window.data.height;
+
+    if (app->config.sequence_prefix != NULL)
     {
-        if (glfwWindowShouldClose(app->window.native_window))
+        const char *path = format_capture_path(app, "%s_%06u.png", app->config.sequence_prefix, app->frame_index);
+        if (path != NULL)
         {
-            close_app(app);
+            request_capture(&app->capture, width, height, path);
         }
+    }
 
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
+    if (app->screenshot_requested)
+    {
+        const char *path = format_capture_path(app, "screenshot_%03u.png", app->screenshot_count++);
+        if (path != NULL)
+        {
+            request_capture(&app->capture, width, height, path);
+            LOG_INFO("Saving screenshot to %s", path);
+        }
+        app->screenshot_requested = false;
+    }
 
-        glUseProgram(shader_program);
+    app->frame_index++;
+    poll_frame_capture(&app->capture);
+    PROFILE_END();
+}
 
-        mat4 view;
-        glmc_lookat(
-            (vec3){ 0.0f, 0.0f, -3.0f },
-            (vec3){ 0.0f, 0.0f,  0.0f },
-            (vec3){ 0.0f, 1.0f,  0.0f },
-            view
-        );
+static void log_time_to_first_image(struct Application *app)
+{
+    LOG_INFO(
+        "First image after %.1f ms (%s backend)",
+        1000.0 * (get_monotonic_time() - app->start_time),
+        app->config.backend == RENDER_BACKEND_CPU ? "CPU" : "GL"
+    );
 
-        glUniformMatrix4fv(
-            glGetUniformLocation(shader_program, "view"),
-            1,
-            GL_FALSE,
-            (float*)view
+    if (app->config.backend == RENDER_BACKEND_GL)
+    {
+        const struct ShaderCacheStats *shaders = get_shader_cache_stats();
+        LOG_INFO(
+            "Shaders: %d loaded from cache in %.1f ms, %d compiled in %.1f ms, %d cache entries rejected",
+            shaders->loaded, 1000.0 * shaders->load_time,
+            shaders->compiled, 1000.0 * shaders->compile_time,
+            shaders->rejected
         );
+    }
+}
 
-        float aspect_ratio =
-            2 * (float)app->window.data.width / (float)app->window.data.height;
+static int get_strip_height(struct Application *app, int max_height)
+{
+    int height = (int)app->config.height;
+    int strip_height = (int)app->config.strip_height;
+    if (strip_height == 0)
+    {
+        strip_height = (int)(EXPORT_STRIP_BYTES / (4 * (size_t)app->config.width));
+        strip_height = strip_height > 0 ? strip_height : 1;
+    }
 
-        mat4 projection;
-        glmc_ortho(
-           -aspect_ratio, aspect_ratio,
-           -2.0f, 2.0f,
-            0.1f, 100.0f,
-            projection
-        );
+    strip_height = strip_height < height ? strip_height : height;
+    return strip_height < max_height ? strip_height : max_height;
+}
 
-        glUniformMatrix4fv(
-            glGetUniformLocation(shader_program, "projection"),
-            1,
-            GL_FALSE,
-            (float*)projection
-        );
+// Renders the image in horizontal strips, each narrowed to its rows with
+// its own projection and appended to the PNG as soon as it is drawn, so
+// memory is bounded by the strip size instead of the image size. With GL,
+// strips wider than the largest renderbuffer are drawn in columns.
+static int run_export(struct Application *app, struct TileRenderer *renderer)
+{
+    int width = (int)app->config.width;
+    int height = (int)app->config.height;
+
+    int max_size = INT_MAX;
+    if (app->config.backend == RENDER_BACKEND_GL)
+    {
+        glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_size);
+    }
 
-        glBindVertexArray(vao[0]);
-        for (int i = 0; i < 2; i++)
+    int strip_height = get_strip_height(app, max_size);
+    int column_width = width < max_size ? width : max_size;
+
+    struct Framebuffer framebuffer;
+    if (app->config.backend == RENDER_BACKEND_GL)
+    {
+        if (!create_framebuffer(&framebuffer, column_width, strip_height))
         {
-            float y = 1.0f - 2.0f * i;
-            for (int j = 0; j < 9; j++)
-            {
-                float x = 5.0f - 1.0f * j;
-                mat4 model;
-                glmc_mat4_identity(model);
-                glmc_translate(model, (vec3){ x, y, 0.0f });
-
-                glUniformMatrix4fv(
-                    glGetUniformLocation(shader_program, "model"),
-                    1,
-                    GL_FALSE,
-                    (float*)model
-                );
-
-                glDrawElements(GL_TRIANGLES, 24, GL_UNSIGNED_INT, NULL);
-            }
+            LOG_ERROR("Failed to create offscreen framebuffer!");
+            return 1;
+        }
+
+        bind_framebuffer(&framebuffer);
+    }
+
+    // Bottom-up RGBA rows, as both glReadPixels and the CPU backend
+    // produce them.
+    size_t strip_size = 4 * (size_t)width * strip_height;
+    uint8_t *strip = ALLOC_ARRAY(uint8_t, strip_size);
+
+    struct PngWriter writer;
+    bool success = open_png_writer(
+        &writer, app->config.output_path, width, height, &app->config.png, &app->thread_pool);
+
+    LOG_TRACE(
+        "Exporting %dx%d in strips of %d rows and columns of %d pixels",
+        width, height, strip_height, column_width
+    );
+
+    for (int y = 0; success && y < height; y += strip_height)
+    {
+        PROFILE_BEGIN("export_strip");
+        reset_arena(&app->frame_arena);
+        int rows = height - y < strip_height ? height - y : strip_height;
+
+        if (app->config.backend == RENDER_BACKEND_CPU)
+        {
+            struct RasterTarget target = { strip, width, rows };
+            set_tile_render_target(renderer, &target);
+            render_region(app, renderer, 0, y, width, rows);
         }
 
-        glBindVertexArray(vao[1]);
-        for (int i = 0; i < 2; i++)
+        else
         {
-            float y = 0.0f - 2.0f * i;
-            for (int j = 0; j < 9; j++)
+            // Each column lands at its place in the strip straight from
+            // the read.
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            glPixelStorei(GL_PACK_ROW_LENGTH, width);
+            for (int x = 0; x < width; x += column_width)
+            {
+                int columns = width - x < column_width ? width - x : column_width;
+                glViewport(0, 0, columns, rows);
+                render_region(app, renderer, x, y, columns, rows);
+
+                PROFILE_BEGIN("glReadPixels");
+                glReadPixels(0, 0, columns, rows, GL_RGBA, GL_UNSIGNED_BYTE, strip + 4 * (size_t)x);
+                PROFILE_END();
+            }
+            glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+
+            int status = (int)glGetError();
+            if (status != GL_NO_ERROR)
             {
-                float x = 5.0f - 1.0f * j;
-                mat4 model;
-                glmc_mat4_identity(model);
-                glmc_scale(model, (vec3){ -1.0f, 1.0f, 0.0f });
-                glmc_translate(model, (vec3){ x, y, 0.0f });
-
-                glUniformMatrix4fv(
-                    glGetUniformLocation(shader_program, "model"),
-                    1,
-                    GL_FALSE,
-                    (float*)model
-                );
-
-                glDrawElements(GL_TRIANGLES, 24, GL_UNSIGNED_INT, NULL);
+                LOG_ERROR("GL ERROR (%d)", status);
+                success = false;
+                PROFILE_END();
+                break;
             }
+            PROFILE_FRAME();
         }
 
+        success = write_png_rows(&writer, strip, rows, true);
+        PROFILE_END();
+    }
+
+    if (writer.file != NULL)
+    {
+        success = close_png_writer(&writer) && success;
+    }
+
+    if (success)
+    {
+        log_time_to_first_image(app);
+    }
+
+    else
+    {
+        LOG_ERROR("Failed to export %s", app->config.output_path);
+    }
+
+    FREE_ARRAY(strip, uint8_t, strip_size);
+    if (app->config.backend == RENDER_BACKEND_GL)
+    {
+        unbind_framebuffer();
+        destroy_framebuffer(&framebuffer);
+    }
+
+    return success ? 0 : 1;
+}
+
+// Runs the draw path comparison in an offscreen framebuffer at the
+// configured resolution, or exports the image.
+static int run_headless(struct Application *app, struct TileRenderer *renderer)
+{
+    if (!app->config.compare_draw)
+        return run_export(app, renderer);
+
+    struct Framebuffer framebuffer;
+    if (!create_framebuffer(&framebuffer, (int)app->config.width, (int)app->config.height))
+    {
+        LOG_ERROR("Failed to create offscreen framebuffer!");
+        return 1;
+    }
+
+    bind_framebuffer(&framebuffer);
+    compare_draw_paths(app, renderer);
+    unbind_framebuffer();
+
+    destroy_framebuffer(&framebuffer);
+    return 0;
+}
+
+// Waits for events until the next frame is due: in on-demand mode until
+// something asks for a redraw, and with a frame cap until the frame's time
+// slot has come. Returns false if no frame should be drawn yet.
+static bool wait_for_frame(struct Application *app)
+{
+    if (app->config.render_on_demand && !app->redraw_requested &&
+        !glfwWindowShouldClose(app->window.native_window))
+    {
+        // Reads in flight still need polling to reach the encoder.
+        if (app->capture.pending > 0)
+        {
+            glfwWaitEventsTimeout(CAPTURE_POLL_INTERVAL);
+            poll_frame_capture(&app->capture);
+        }
+
+        else
+        {
+            PROFILE_BEGIN("glfwWaitEvents");
+            glfwWaitEvents();
+            PROFILE_END();
+        }
+
+        return false;
+    }
+
+    if (app->config.max_fps > 0)
+    {
+        double remaining = app->last_frame_time + 1.0 / app->config.max_fps - get_monotonic_time();
+        if (remaining > 0.0)
+        {
+            glfwWaitEventsTimeout(remaining);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int run_app(struct Application *app)
+{
+    LOG_TRACE("Running application...");
+    app->running = true;
+
+    // Mesh data is referenced by the renderer, so the tilings outlive it.
+    struct TileMesh meshes[TILE_MESH_MAX_COUNT];
+    int mesh_count = DEMO_TILE_MESH_COUNT;
+    if (app->config.penrose_depth > 0)
+    {
+        if (!init_penrose_tiling(&app->penrose, (int)app->config.penrose_depth, PENROSE_TILE_SIZE))
+            return 1;
+
+        memcpy(meshes, app->penrose.meshes, sizeof(app->penrose.meshes));
+        mesh_count = PENROSE_MESH_COUNT;
+    }
+
+    else if (app->config.wallpaper_group != NULL)
+    {
+        if (!init_wallpaper_tiling(&app->wallpaper, app->config.wallpaper_group))
+        {
+            LOG_ERROR("Failed to set up wallpaper group %s!", app->config.wallpaper_group->name);
+            return 1;
+        }
+
+        memcpy(meshes, app->wallpaper.meshes, app->wallpaper.mesh_count * sizeof(struct TileMesh));
+        mesh_count = app->wallpaper.mesh_count;
+    }
+
+    else
+    {
+        get_demo_tile_meshes(meshes);
+    }
+
+    PROFILE_BEGIN("init_tile_renderer");
+    struct TileRenderer renderer;
+    bool renderer_created = init_tile_renderer(
+        &renderer, app->config.backend, meshes, mesh_count, &app->config.vertex_format, &app->thread_pool);
+    PROFILE_END();
+
+    if (!renderer_created)
+    {
+        LOG_ERROR("Failed to initialise tile renderer!");
+        return 1;
+    }
+
+    if (app->config.penrose_depth == 0)
+    {
+        init_tiling_extent(app);
+    }
+
+    if (app->config.headless)
+    {
+        int status = run_headless(app, &renderer);
+        destroy_tile_renderer(&renderer);
+        return status;
+    }
+
+    if (app->config.compare_draw)
+    {
+        compare_draw_paths(app, &renderer);
+        destroy_tile_renderer(&renderer);
+        return 0;
+    }
+
+    if (!init_frame_capture(&app->capture, &app->config.png, &app->thread_pool))
+    {
+        LOG_ERROR("Failed to initialise frame capture!");
+        destroy_tile_renderer(&renderer);
+        return 1;
+    }
+
+    init_render_stats(&app->render_stats, true);
+    if (app->config.stats_path != NULL &&
+        !open_render_stats_dump(&app->render_stats, app->config.stats_path, app->config.stats_interval))
+    {
+        destroy_render_stats(&app->render_stats);
+        destroy_frame_capture(&app->capture);
+        destroy_tile_renderer(&renderer);
+        return 1;
+    }
+
+    if (app->config.render_on_demand)
+    {
+        LOG_TRACE("Rendering on demand");
+    }
+
+    app->redraw_requested = true;
+    app->last_frame_time = -INFINITY;
+    while (app->running)
+    {
+        if (!wait_for_frame(app))
+            continue;
+
+        // Events handled during this frame ask for the next one.
+        app->redraw_requested = false;
+        app->last_frame_time = get_monotonic_time();
+
+        PROFILE_BEGIN("frame");
+        begin_render_stats_frame(&app->render_stats);
+        reset_arena(&app->frame_arena);
+
+        if (glfwWindowShouldClose(app->window.native_window))
+        {
+            close_app(app);
+        }
+
+        render_frame(app, &renderer);
+        capture_frame(app);
+
+        PROFILE_BEGIN("glfwSwapBuffers");
         glfwSwapBuffers(app->window.native_window);
+        PROFILE_END();
+
+        if (app->render_stats.frame_count == 0)
+        {
+            log_time_to_first_image(app);
+        }
+
+        PROFILE_BEGIN("glfwPollEvents");
         glfwPollEvents();
+        PROFILE_END();
+
+        end_render_stats_frame(&app->render_stats);
+        PROFILE_END();
+        PROFILE_FRAME();
     }
 
-    save_buffer_to_image(
+    log_render_stats(&app->render_stats);
+    destroy_render_stats(&app->render_stats);
+
+    // The last frame is still in the back buffer.
+    request_capture(
+        &app->capture,
         (int)app->window.data.width,
-        (int)app->window.data.height
+        (int)app->window.data.height,
+        app->config.output_path
     );
 
-    glDeleteBuffers(3, vbo);
-    glDeleteVertexArrays(2, vao);
-
-    glDeleteProgram(shader_program);
+    // Waits for the encoder to write every outstanding capture.
+    destroy_frame_capture(&app->capture);
+    destroy_tile_renderer(&renderer);
 
     return 0;
 }
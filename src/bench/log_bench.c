@@ -0,0 +1,100 @@
+#include <common.h>
+#include <memory.h>
+#include <core/log.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Times every LOG_TRACE call on the calling thread, with the output going to
+// a file: written synchronously, through the async queue, and through the
+// queue into a binary log. Calls come in bursts that fit the queue, with a
+// flush between bursts, so the async numbers show the cost of queueing
+// rather than of a full queue. Drain is the wall time per message including
+// the flushes, which is what the writer thread costs.
+
+#define BENCH_CALLS 200000
+#define BENCH_BURST 1000
+
+static uint64_t get_nanoseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static int compare_latencies(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void run_bench(const char *name, bool async, const char *binary_path, uint64_t *latencies)
+{
+    set_log_async(async);
+    if (binary_path != NULL && !open_binary_log(binary_path))
+        return;
+
+    uint64_t bench_start = get_nanoseconds();
+    for (int i = 0; i < BENCH_CALLS; i++)
+    {
+        double milliseconds = 0.25 * (double)(i % 97);
+        size_t tile = (size_t)i * 31;
+
+        uint64_t start = get_nanoseconds();
+        LOG_TRACE("Frame %d: tile %zu drawn in %.3f ms by %s", i, tile, milliseconds, name);
+        latencies[i] = get_nanoseconds() - start;
+
+        if ((i + 1) % BENCH_BURST == 0)
+        {
+            flush_log();
+        }
+    }
+    flush_log();
+    uint64_t drain = get_nanoseconds() - bench_start;
+    close_binary_log();
+
+    uint64_t total = 0;
+    for (int i = 0; i < BENCH_CALLS; i++)
+    {
+        total += latencies[i];
+    }
+    qsort(latencies, BENCH_CALLS, sizeof(uint64_t), compare_latencies);
+
+    fprintf(
+        stderr,
+        "%-6s | mean %5.0f ns | p50 %5llu ns | p99 %5llu ns | p99.9 %6llu ns | max %8llu ns | drain %5.0f ns\n",
+        name,
+        (double)total / BENCH_CALLS,
+        (unsigned long long)latencies[BENCH_CALLS / 2],
+        (unsigned long long)latencies[BENCH_CALLS * 99 / 100],
+        (unsigned long long)latencies[BENCH_CALLS * 999 / 1000],
+        (unsigned long long)latencies[BENCH_CALLS - 1],
+        (double)drain / BENCH_CALLS
+    );
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "log_bench.log";
+    if (freopen(path, "w", stdout) == NULL)
+    {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return 1;
+    }
+
+    uint64_t *latencies = ALLOC_ARRAY(uint64_t, BENCH_CALLS);
+    fprintf(stderr, "%d calls per mode, logging to %s\n", BENCH_CALLS, path);
+    size_t binary_path_size = strlen(path) + 5;
+    char *binary_path = ALLOC_ARRAY(char, binary_path_size);
+    snprintf(binary_path, binary_path_size, "%s.bin", path);
+
+    run_bench("sync", false, NULL, latencies);
+    run_bench("async", true, NULL, latencies);
+    run_bench("binary", true, binary_path, latencies);
+    FREE_ARRAY(binary_path, char, binary_path_size);
+    FREE_ARRAY(latencies, uint64_t, BENCH_CALLS);
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,640 @@
+#include <common.h>
+#include <memory.h>
+#include <util.h>
+#include <core/headless.h>
+#include <core/log.h>
+#include <core/thread_pool.h>
+#include <graphics/framebuffer.h>
+#include <graphics/mesh_optimizer.h>
+#include <graphics/penrose.h>
+#include <graphics/png.h>
+#include <graphics/raster.h>
+#include <graphics/tile_renderer.h>
+#include <graphics/tiling.h>
+
+#include <cglm/call.h>
+#include <glad/glad.h>
+
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Runs fixed scenes headlessly and reports warmed-up timings and
+// allocations for each, on the console and as JSON:
+//
+//     tessellation_bench [--output <path>] [--iterations <count>]
+//                        [--warmup <count>] [--threads <count>] [--filter <text>]
+//
+// Every scene is deterministic, so results from different builds on the same
+// machine are comparable. GL scenes are skipped when no headless context can
+// be created.
+
+#define BENCH_MAX_ITERATIONS 1000
+#define BENCH_DRAW_WIDTH 1920
+#define BENCH_DRAW_HEIGHT 1080
+#define BENCH_PNG_PATH "tessellation_bench.png"
+
+static const size_t tile_counts[] = { 10000, 100000, 1000000 };
+static const int resolutions[][2] = { { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+
+// One group per lattice type.
+static const char *wallpaper_groups[] = { "p2", "pgg", "p4m", "p6m" };
+
+struct Bench
+{
+    int warmup;
+    int iterations;
+    const char *filter;
+
+    FILE *output;
+    bool first_result;
+
+    struct ThreadPool pool;
+    struct HeadlessContext headless;
+    bool has_gl;
+    struct TileMesh meshes[DEMO_TILE_MESH_COUNT];
+};
+
+typedef void (*BenchFunction)(void *data);
+
+// A tiling and the renderer drawing it. Instances are built up front so
+// only the measured step runs in the loop.
+struct TilingScene
+{
+    unsigned int columns;
+    unsigned int rows;
+    size_t count;
+    struct TileInstance *instances;
+    size_t counts[DEMO_TILE_MESH_COUNT];
+
+    struct TileRenderer *renderer;
+    enum TileDrawMode mode;
+    mat4 view;
+    mat4 projection;
+};
+
+// A wallpaper tiling generated into a buffer of its capacity.
+struct WallpaperScene
+{
+    struct Tiling tiling;
+    float region[4];
+    size_t capacity;
+    struct TileInstance *instances;
+    size_t counts[TILING_MAX_MESHES];
+};
+
+// A level-12 Penrose tiling seen through the application's view, which
+// pans a little further every run.
+struct PenroseScene
+{
+    struct PenroseTiling tiling;
+    struct Arena scratch;
+    float region[4];
+    float pixels_per_unit;
+};
+
+struct ImageScene
+{
+    int width;
+    int height;
+    uint8_t *pixels;
+    struct PngOptions png;
+    struct ThreadPool *pool;
+};
+
+static size_t get_allocation_count()
+{
+    size_t count = 0;
+    for (int i = 0; i < MEMORY_TAG_COUNT; i++)
+    {
+        struct MemoryStats stats;
+        get_memory_stats((enum MemoryTag)i, &stats);
+        count += stats.allocation_count;
+    }
+
+    return count;
+}
+
+static int compare_times(const void *a, const void *b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double get_percentile(const double *sorted, int count, int percent)
+{
+    int rank = (percent * count + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void run_scene(struct Bench *bench, const char *name, BenchFunction function, void *data)
+{
+    if (bench->filter != NULL && strstr(name, bench->filter) == NULL)
+        return;
+
+    // Messages logged by the runs, like the rasterizer's per-frame stages,
+    // would be timed too. The level only changes here, between runs, while
+    // no worker threads are reading it.
+    enum LogLevel level = core_log_level;
+    set_log_level(level > LOG_LEVEL_WARN ? level : LOG_LEVEL_WARN);
+
+    for (int i = 0; i < bench->warmup; i++)
+    {
+        function(data);
+    }
+
+    double times[BENCH_MAX_ITERATIONS];
+    size_t bytes = get_memory_allocated();
+    size_t allocations = get_allocation_count();
+    for (int i = 0; i < bench->iterations; i++)
+    {
+        double start = get_monotonic_time();
+        function(data);
+        times[i] = 1000.0 * (get_monotonic_time() - start);
+    }
+    bytes = get_memory_allocated() - bytes;
+    allocations = get_allocation_count() - allocations;
+    set_log_level(level);
+
+    int count = bench->iterations;
+    double mean = 0.0;
+    for (int i = 0; i < count; i++)
+    {
+        mean += times[i];
+    }
+    mean /= count;
+
+    qsort(times, (size_t)count, sizeof(double), compare_times);
+    double median = get_percentile(times, count, 50);
+    double p95 = get_percentile(times, count, 95);
+    double p99 = get_percentile(times, count, 99);
+
+    LOG_INFO(
+        "%-34s | mean %9.3f ms | median %9.3f ms | p95 %9.3f ms | p99 %9.3f ms | %10zu B %6zu allocs per run",
+        name, mean, median, p95, p99, bytes / count, allocations / count
+    );
+
+    fprintf(
+        bench->output,
+        "%s\n    {\"name\": \"%s\", \"iterations\": %d, \"mean_ms\": %.4f, \"median_ms\": %.4f, "
+        "\"p95_ms\": %.4f, \"p99_ms\": %.4f, \"min_ms\": %.4f, \"max_ms\": %.4f, "
+        "\"bytes_per_run\": %zu, \"allocations_per_run\": %zu}",
+        bench->first_result ? "" : ",",
+        name, count, mean, median, p95, p99, times[0], times[count - 1],
+        bytes / count, allocations / count
+    );
+    bench->first_result = false;
+}
+
+// Same camera as the application: the tiling seen head on, 4 units tall.
+static void compute_scene_camera(struct TilingScene *scene, int width, int height)
+{
+    float aspect_ratio = 2.0f * (float)width / (float)height;
+
+    glmc_lookat(
+        (vec3){ 0.0f, 0.0f, -3.0f },
+        (vec3){ 0.0f, 0.0f,  0.0f },
+        (vec3){ 0.0f, 1.0f,  0.0f },
+        scene->view
+    );
+    glmc_ortho(-aspect_ratio, aspect_ratio, -2.0f, 2.0f, 0.1f, 100.0f, scene->projection);
+}
+
+// A tile_count of 0 gives the application's demo tiling.
+static void init_tiling_scene(struct TilingScene *scene, size_t tile_count)
+{
+    memset(scene, 0, sizeof(struct TilingScene));
+    scene->columns = DEMO_TILING_COLUMNS;
+    scene->rows = DEMO_TILING_ROWS;
+    if (tile_count > 0)
+    {
+        get_tiling_size(tile_count, &scene->columns, &scene->rows);
+    }
+
+    scene->count = 2 * (size_t)scene->rows * scene->columns;
+    scene->instances = ALLOC_ARRAY(struct TileInstance, scene->count);
+    build_tiling(scene->instances, scene->counts, scene->columns, scene->rows);
+    compute_scene_camera(scene, BENCH_DRAW_WIDTH, BENCH_DRAW_HEIGHT);
+}
+
+static void destroy_tiling_scene(struct TilingScene *scene)
+{
+    FREE_ARRAY(scene->instances, struct TileInstance, scene->count);
+}
+
+static void bench_build_tiling(void *data)
+{
+    struct TilingScene *scene = (struct TilingScene*)data;
+    build_tiling(scene->instances, scene->counts, scene->columns, scene->rows);
+}
+
+// What culling does per frame: the visible range of the same tiling.
+static void bench_cull_tiling(void *data)
+{
+    struct TilingScene *scene = (struct TilingScene*)data;
+    float region[4];
+    get_visible_region((float*)scene->view, (float*)scene->projection, region);
+    build_visible_tiling(scene->instances, scene->counts, scene->columns, scene->rows, region);
+}
+
+static void bench_generate_wallpaper(void *data)
+{
+    struct WallpaperScene *scene = (struct WallpaperScene*)data;
+    generate_tiling(&scene->tiling, scene->region, scene->instances, scene->counts);
+}
+
+static void bench_pan_penrose(void *data)
+{
+    struct PenroseScene *scene = (struct PenroseScene*)data;
+    scene->region[0] += 0.05f;
+    scene->region[2] += 0.05f;
+    update_penrose_tiling(&scene->tiling, scene->region, scene->pixels_per_unit, &scene->scratch, NULL);
+}
+
+static void bench_upload_instances(void *data)
+{
+    struct TilingScene *scene = (struct TilingScene*)data;
+    set_tile_instances(scene->renderer, scene->instances, scene->counts);
+    glFinish();
+}
+
+// The same instances written into the renderer's mapped stream instead.
+static void bench_stream_instances(void *data)
+{
+    struct TilingScene *scene = (struct TilingScene*)data;
+    size_t total = scene->counts[0] + scene->counts[1];
+    struct TileInstance *instances = map_tile_instances(scene->renderer, total);
+    if (instances == NULL)
+    {
+        LOG_ERROR("Failed to map room for %zu instances, the run draws nothing", total);
+        size_t none[DEMO_TILE_MESH_COUNT] = { 0 };
+        commit_tile_instances(scene->renderer, none);
+        return;
+    }
+
+    memcpy(instances, scene->instances, total * sizeof(struct TileInstance));
+    commit_tile_instances(scene->renderer, scene->counts);
+    glFinish();
+}
+
+// Submission and the GPU work it causes; glFinish keeps frames from
+// overlapping so each run measures one whole frame.
+static void bench_draw_gl(void *data)
+{
+    struct TilingScene *scene = (struct TilingScene*)data;
+    clear_tiles(scene->renderer, (float[]){ 0.0f, 0.0f, 0.0f, 1.0f });
+    draw_tiles(scene->renderer, scene->mode);
+    glFinish();
+}
+
+static void bench_draw_cpu(void *data)
+{
+    struct TilingScene *scene = (struct TilingScene*)data;
+    clear_tiles(scene->renderer, (float[]){ 0.0f, 0.0f, 0.0f, 1.0f });
+    draw_tiles(scene->renderer, TILE_DRAW_INSTANCED);
+}
+
+static void bench_read_pixels(void *data)
+{
+    struct ImageScene *scene = (struct ImageScene*)data;
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, scene->width, scene->height, GL_RGBA, GL_UNSIGNED_BYTE, scene->pixels);
+}
+
+static void bench_write_png(void *data)
+{
+    struct ImageScene *scene = (struct ImageScene*)data;
+    write_png(BENCH_PNG_PATH, scene->pixels, scene->width, scene->height, true, &scene->png, scene->pool);
+}
+
+static void run_geometry_scenes(struct Bench *bench)
+{
+    // Not timed; the demo tile's overdraw as it was drawn before its border
+    // became a ring around the fill, and as it is now.
+    struct TileMesh layered[DEMO_TILE_MESH_COUNT];
+    get_layered_demo_tile_meshes(layered);
+    for (int i = 0; i < DEMO_TILE_MESH_COUNT; i++)
+    {
+        LOG_INFO(
+            "Demo tile mesh %d overdraw: %.3f with the border under the fill, %.3f as a ring",
+            i,
+            get_mesh_overdraw(&layered[i], MESH_OVERDRAW_RESOLUTION),
+            get_mesh_overdraw(&bench->meshes[i], MESH_OVERDRAW_RESOLUTION)
+        );
+    }
+
+    for (size_t i = 0; i < sizeof(tile_counts) / sizeof(tile_counts[0]); i++)
+    {
+        char name[64];
+        struct TilingScene scene;
+        init_tiling_scene(&scene, tile_counts[i]);
+
+        snprintf(name, sizeof(name), "geometry/build/%zu", tile_counts[i]);
+        run_scene(bench, name, bench_build_tiling, &scene);
+
+        snprintf(name, sizeof(name), "geometry/cull/%zu", tile_counts[i]);
+        run_scene(bench, name, bench_cull_tiling, &scene);
+
+        destroy_tiling_scene(&scene);
+    }
+
+    size_t tile_count = tile_counts[sizeof(tile_counts) / sizeof(tile_counts[0]) - 1];
+    for (size_t i = 0; i < sizeof(wallpaper_groups) / sizeof(wallpaper_groups[0]); i++)
+    {
+        char name[64];
+        struct WallpaperScene scene;
+        init_wallpaper_tiling(&scene.tiling, find_wallpaper_group(wallpaper_groups[i]));
+        get_tiling_region(&scene.tiling, tile_count, scene.region);
+        scene.capacity = get_tiling_capacity(&scene.tiling, scene.region);
+        scene.instances = ALLOC_ARRAY(struct TileInstance, scene.capacity);
+
+        snprintf(name, sizeof(name), "geometry/wallpaper/%s/%zu", wallpaper_groups[i], tile_count);
+        run_scene(bench, name, bench_generate_wallpaper, &scene);
+
+        FREE_ARRAY(scene.instances, struct TileInstance, scene.capacity);
+    }
+
+    struct PenroseScene penrose;
+    init_penrose_tiling(&penrose.tiling, 12, 0.25f);
+    init_arena(&penrose.scratch, 0, MEMORY_TAG_GEOMETRY);
+    float aspect_ratio = 2.0f * BENCH_DRAW_WIDTH / BENCH_DRAW_HEIGHT;
+    memcpy(penrose.region, (float[]){ -aspect_ratio, -2.0f, aspect_ratio, 2.0f }, sizeof(penrose.region));
+    penrose.pixels_per_unit = BENCH_DRAW_HEIGHT / 4.0f;
+    update_penrose_tiling(&penrose.tiling, penrose.region, penrose.pixels_per_unit, &penrose.scratch, NULL);
+
+    run_scene(bench, "geometry/penrose/pan/12", bench_pan_penrose, &penrose);
+    destroy_penrose_tiling(&penrose.tiling);
+    destroy_arena(&penrose.scratch);
+}
+
+static void run_cpu_draw_scenes(struct Bench *bench)
+{
+    struct RasterTarget target;
+    if (!create_raster_target(&target, BENCH_DRAW_WIDTH, BENCH_DRAW_HEIGHT))
+        return;
+
+    struct TileRenderer renderer;
+    init_tile_renderer(&renderer, RENDER_BACKEND_CPU, bench->meshes, DEMO_TILE_MESH_COUNT, NULL, &bench->pool);
+    set_tile_render_target(&renderer, &target);
+
+    for (size_t i = 0; i < sizeof(tile_counts) / sizeof(tile_counts[0]); i++)
+    {
+        char name[64];
+        struct TilingScene scene;
+        init_tiling_scene(&scene, tile_counts[i]);
+        scene.renderer = &renderer;
+        set_tile_view(&renderer, (float*)scene.view, (float*)scene.projection);
+        set_tile_instances(&renderer, scene.instances, scene.counts);
+
+        snprintf(name, sizeof(name), "draw/cpu/%zu", tile_counts[i]);
+        run_scene(bench, name, bench_draw_cpu, &scene);
+
+        destroy_tiling_scene(&scene);
+    }
+
+    destroy_tile_renderer(&renderer);
+    destroy_raster_target(&target);
+}
+
+static void run_gl_draw_scenes(struct Bench *bench)
+{
+    struct Framebuffer framebuffer;
+    if (!create_framebuffer(&framebuffer, BENCH_DRAW_WIDTH, BENCH_DRAW_HEIGHT))
+        return;
+
+    bind_framebuffer(&framebuffer);
+
+    struct TileRenderer renderer;
+    if (!init_tile_renderer(&renderer, RENDER_BACKEND_GL, bench->meshes, DEMO_TILE_MESH_COUNT, NULL, NULL))
+    {
+        unbind_framebuffer();
+        destroy_framebuffer(&framebuffer);
+        return;
+    }
+
+    for (size_t i = 0; i < sizeof(tile_counts) / sizeof(tile_counts[0]); i++)
+    {
+        char name[64];
+        struct TilingScene scene;
+        init_tiling_scene(&scene, tile_counts[i]);
+        scene.renderer = &renderer;
+        set_tile_view(&renderer, (float*)scene.view, (float*)scene.projection);
+
+        snprintf(name, sizeof(name), "upload/%zu", tile_counts[i]);
+        run_scene(bench, name, bench_upload_instances, &scene);
+
+        snprintf(name, sizeof(name), "upload_stream/%zu", tile_counts[i]);
+        run_scene(bench, name, bench_stream_instances, &scene);
+
+        set_tile_instances(&renderer, scene.instances, scene.counts);
+        scene.mode = TILE_DRAW_INSTANCED;
+        snprintf(name, sizeof(name), "draw/gl_instanced/%zu", tile_counts[i]);
+        run_scene(bench, name, bench_draw_gl, &scene);
+
+        // The same tiles placed by the vertex shader, with nothing uploaded
+        // per tile.
+        struct LatticeDraw draws[DEMO_TILE_MESH_COUNT];
+        int draw_count;
+        float everywhere[4] = { -FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX };
+        build_visible_lattice(draws, &draw_count, scene.columns, scene.rows, everywhere);
+        set_tile_lattice(&renderer, draws, draw_count, NULL);
+        scene.mode = TILE_DRAW_PROCEDURAL;
+        snprintf(name, sizeof(name), "draw/gl_procedural/%zu", tile_counts[i]);
+        run_scene(bench, name, bench_draw_gl, &scene);
+
+        // One draw call per tile gets slow quickly; the smallest scene is
+        // enough to compare against.
+        if (i == 0)
+        {
+            scene.mode = TILE_DRAW_PER_TILE;
+            snprintf(name, sizeof(name), "draw/gl_per_tile/%zu", tile_counts[i]);
+            run_scene(bench, name, bench_draw_gl, &scene);
+        }
+
+        destroy_tiling_scene(&scene);
+    }
+
+    destroy_tile_renderer(&renderer);
+    unbind_framebuffer();
+    destroy_framebuffer(&framebuffer);
+}
+
+// Renders the demo tiling once per resolution, then times reading it back
+// and encoding it.
+static void run_image_scenes(struct Bench *bench)
+{
+    struct TileRenderer renderer;
+    if (!init_tile_renderer(&renderer, RENDER_BACKEND_GL, bench->meshes, DEMO_TILE_MESH_COUNT, NULL, NULL))
+        return;
+
+    struct TilingScene tiling;
+    init_tiling_scene(&tiling, 0);
+    tiling.renderer = &renderer;
+    set_tile_instances(&renderer, tiling.instances, tiling.counts);
+
+    for (size_t i = 0; i < sizeof(resolutions) / sizeof(resolutions[0]); i++)
+    {
+        struct ImageScene scene;
+        scene.width = resolutions[i][0];
+        scene.height = resolutions[i][1];
+        scene.pool = &bench->pool;
+        get_default_png_options(&scene.png);
+
+        struct Framebuffer framebuffer;
+        if (!create_framebuffer(&framebuffer, scene.width, scene.height))
+            continue;
+
+        bind_framebuffer(&framebuffer);
+        compute_scene_camera(&tiling, scene.width, scene.height);
+        set_tile_view(&renderer, (float*)tiling.view, (float*)tiling.projection);
+        bench_draw_gl(&tiling);
+
+        size_t size = 4 * (size_t)scene.width * scene.height;
+        scene.pixels = ALLOC_ARRAY(uint8_t, size);
+
+        char name[64];
+        snprintf(name, sizeof(name), "readback/%dx%d", scene.width, scene.height);
+        run_scene(bench, name, bench_read_pixels, &scene);
+
+        // Encoding needs the pixels even when readback was filtered out.
+        bench_read_pixels(&scene);
+        snprintf(name, sizeof(name), "png/%dx%d", scene.width, scene.height);
+        run_scene(bench, name, bench_write_png, &scene);
+
+        FREE_ARRAY(scene.pixels, uint8_t, size);
+        unbind_framebuffer();
+        destroy_framebuffer(&framebuffer);
+    }
+
+    remove(BENCH_PNG_PATH);
+    destroy_tiling_scene(&tiling);
+    destroy_tile_renderer(&renderer);
+}
+
+static bool parse_count(const char *text, int min, int max, int *count)
+{
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (*end != '\0' || value < min || value > max)
+        return false;
+
+    *count = (int)value;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    struct Bench bench;
+    memset(&bench, 0, sizeof(struct Bench));
+    bench.warmup = 3;
+    bench.iterations = 20;
+    bench.first_result = true;
+
+    const char *output_path = "tessellation_bench.json";
+    int thread_count = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool valid = i + 1 < argc;
+        if (valid && strcmp(argv[i], "--output") == 0)
+        {
+            output_path = argv[++i];
+        }
+
+        else if (valid && strcmp(argv[i], "--iterations") == 0)
+        {
+            valid = parse_count(argv[++i], 1, BENCH_MAX_ITERATIONS, &bench.iterations);
+        }
+
+        else if (valid && strcmp(argv[i], "--warmup") == 0)
+        {
+            valid = parse_count(argv[++i], 0, BENCH_MAX_ITERATIONS, &bench.warmup);
+        }
+
+        else if (valid && strcmp(argv[i], "--threads") == 0)
+        {
+            valid = parse_count(argv[++i], 0, 1024, &thread_count);
+        }
+
+        else if (valid && strcmp(argv[i], "--filter") == 0)
+        {
+            bench.filter = argv[++i];
+        }
+
+        else
+        {
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            LOG_FATAL(
+                "Usage: %s [--output <path>] [--iterations <count>] [--warmup <count>] "
+                "[--threads <count>] [--filter <text>]",
+                argv[0]
+            );
+            return 1;
+        }
+    }
+
+    bench.output = fopen(output_path, "w");
+    if (bench.output == NULL)
+    {
+        LOG_FATAL("Failed to create %s", output_path);
+        return 1;
+    }
+
+    if (!init_thread_pool(&bench.pool, thread_count))
+    {
+        LOG_FATAL("Failed to start the thread pool");
+        fclose(bench.output);
+        return 1;
+    }
+
+    get_demo_tile_meshes(bench.meshes);
+
+    bench.has_gl = init_headless_context(&bench.headless);
+    const char *renderer = bench.has_gl ? (const char*)glGetString(GL_RENDERER) : "none";
+    renderer = renderer != NULL ? renderer : "unknown";
+    if (!bench.has_gl)
+    {
+        LOG_WARN("No headless GL context, skipping the GL scenes");
+    }
+
+    LOG_INFO(
+        "%d warmup and %d timed runs per scene, %d threads, GL renderer: %s",
+        bench.warmup, bench.iterations, bench.pool.worker_count, renderer
+    );
+
+    fprintf(
+        bench.output,
+        "{\n  \"warmup\": %d,\n  \"iterations\": %d,\n  \"threads\": %d,\n  \"gl_renderer\": ",
+        bench.warmup, bench.iterations, bench.pool.worker_count
+    );
+    write_json_string(bench.output, renderer);
+    fprintf(bench.output, ",\n  \"results\": [");
+
+    run_geometry_scenes(&bench);
+    run_cpu_draw_scenes(&bench);
+    if (bench.has_gl)
+    {
+        run_gl_draw_scenes(&bench);
+        run_image_scenes(&bench);
+        destroy_headless_context(&bench.headless);
+    }
+
+    fprintf(bench.output, "\n  ]\n}\n");
+    bool success = fclose(bench.output) == 0;
+    destroy_thread_pool(&bench.pool);
+
+    if (!success)
+    {
+        LOG_ERROR("Failed to write %s", output_path);
+        return 1;
+    }
+
+    LOG_INFO("Results written to %s", output_path);
+    return 0;
+}
\ No newline at end of file
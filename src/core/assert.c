@@ -1,5 +1,6 @@
 #include <util.h>
 #include <core/assert.h>
+#include <core/log.h>
 
 #include <stdio.h>
 #include <signal.h>
@@ -12,7 +13,10 @@ void core_assert(bool condition, const char *format, ...)
 {
     if (condition)
         return;
-    
+
+    // Queued messages come first, they usually explain the failure.
+    flush_log();
+
     char time[TIME_BUFFER_SIZE];
     get_time(time, TIME_BUFFER_SIZE, "%a %d %b %Y %H:%M:%S");
     fprintf(stderr, "[%s] ASSERT | ", time);
@@ -0,0 +1,232 @@
+#include <common.h>
+#include <core/headless.h>
+#include <core/log.h>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#ifdef TSL_HAS_EGL
+    #include <EGL/egl.h>
+    #include <EGL/eglext.h>
+#endif
+
+#include <string.h>
+
+#ifdef TSL_HAS_EGL
+static bool has_extension(const char *extensions, const char *name)
+{
+    if (extensions == NULL)
+        return false;
+
+    size_t length = strlen(name);
+    for (const char *start = extensions; (start = strstr(start, name)) != NULL; start += length)
+    {
+        bool starts_word = start == extensions || start[-1] == ' ';
+        bool ends_word = start[length] == ' ' || start[length] == '\0';
+        if (starts_word && ends_word)
+            return true;
+    }
+
+    return false;
+}
+
+static bool init_egl_context(struct HeadlessContext *context)
+{
+    const char *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+    EGLDisplay display = EGL_NO_DISPLAY;
+    if (has_extension(client_extensions, "EGL_MESA_platform_surfaceless"))
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (get_platform_display != NULL)
+        {
+            display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        }
+    }
+
+    if (display == EGL_NO_DISPLAY)
+    {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+    {
+        LOG_WARN("EGL: no display available (0x%x)", eglGetError());
+        return false;
+    }
+
+    const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (!has_extension(extensions, "EGL_KHR_surfaceless_context"))
+    {
+        LOG_WARN("EGL: surfaceless contexts are not supported");
+        eglTerminate(display);
+        return false;
+    }
+
+    EGLConfig config = (EGLConfig)0;
+    if (!has_extension(extensions, "EGL_KHR_no_config_context"))
+    {
+        const EGLint config_attributes[] = {
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE
+        };
+
+        EGLint config_count = 0;
+        if (!eglChooseConfig(display, config_attributes, &config, 1, &config_count) || config_count == 0)
+        {
+            LOG_WARN("EGL: no config supports desktop OpenGL");
+            eglTerminate(display);
+            return false;
+        }
+    }
+
+    const EGLint context_attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+
+    EGLContext egl_context = EGL_NO_CONTEXT;
+    if (eglBindAPI(EGL_OPENGL_API))
+    {
+        egl_context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+    }
+
+    if (egl_context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl_context))
+    {
+        LOG_WARN("EGL: failed to create a GL 3.3 core context (0x%x)", eglGetError());
+        if (egl_context != EGL_NO_CONTEXT)
+        {
+            eglDestroyContext(display, egl_context);
+        }
+        eglTerminate(display);
+        return false;
+    }
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+    {
+        LOG_WARN("EGL: failed to load Glad!");
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, egl_context);
+        eglTerminate(display);
+        return false;
+    }
+
+    context->backend = HEADLESS_BACKEND_EGL;
+    context->egl_display = display;
+    context->egl_context = egl_context;
+    return true;
+}
+#endif
+
+static bool init_glfw_context(struct HeadlessContext *context, enum HeadlessBackend backend)
+{
+#ifdef GLFW_PLATFORM_NULL
+    if (backend == HEADLESS_BACKEND_GLFW_OSMESA)
+    {
+        if (!glfwPlatformSupported(GLFW_PLATFORM_NULL))
+            return false;
+
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    }
+
+    else
+    {
+        glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+    }
+#else
+    if (backend == HEADLESS_BACKEND_GLFW_OSMESA)
+        return false;
+#endif
+
+    if (!glfwInit())
+        return false;
+
+    glfwDefaultWindowHints();
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    if (backend == HEADLESS_BACKEND_GLFW_OSMESA)
+    {
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    }
+
+    // The window only carries the context; everything is drawn offscreen.
+    context->window = glfwCreateWindow(1, 1, "Tessellation", NULL, NULL);
+    if (context->window == NULL)
+    {
+        glfwTerminate();
+        return false;
+    }
+
+    glfwMakeContextCurrent(context->window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        glfwDestroyWindow(context->window);
+        context->window = NULL;
+        glfwTerminate();
+        return false;
+    }
+
+    context->backend = backend;
+    return true;
+}
+
+bool init_headless_context(struct HeadlessContext *context)
+{
+    memset(context, 0, sizeof(struct HeadlessContext));
+
+#ifdef TSL_HAS_EGL
+    if (init_egl_context(context))
+        return true;
+#endif
+
+    if (init_glfw_context(context, HEADLESS_BACKEND_GLFW_OSMESA))
+        return true;
+
+    if (init_glfw_context(context, HEADLESS_BACKEND_GLFW_HIDDEN))
+        return true;
+
+    LOG_ERROR("Failed to create a headless GL context!");
+    return false;
+}
+
+void destroy_headless_context(struct HeadlessContext *context)
+{
+    switch (context->backend)
+    {
+#ifdef TSL_HAS_EGL
+    case HEADLESS_BACKEND_EGL:
+        eglMakeCurrent(context->egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(context->egl_display, context->egl_context);
+        eglTerminate(context->egl_display);
+        break;
+#endif
+
+    case HEADLESS_BACKEND_GLFW_OSMESA:
+    case HEADLESS_BACKEND_GLFW_HIDDEN:
+        glfwDestroyWindow(context->window);
+        glfwTerminate();
+        break;
+
+    default:
+        break;
+    }
+
+    memset(context, 0, sizeof(struct HeadlessContext));
+}
+
+const char* get_headless_backend_name(enum HeadlessBackend backend)
+{
+    switch (backend)
+    {
+    case HEADLESS_BACKEND_EGL:          return "EGL (surfaceless)";
+    case HEADLESS_BACKEND_GLFW_OSMESA:  return "GLFW (OSMesa)";
+    case HEADLESS_BACKEND_GLFW_HIDDEN:  return "GLFW (hidden window)";
+    default:                            return "none";
+    }
+}
\ No newline at end of file
@@ -1,28 +1,538 @@
+#define MEMORY_TAG MEMORY_TAG_LOG
+
+#include <memory.h>
 #include <util.h>
 #include <core/log.h>
+#include <core/log_format.h>
 
+#include <pthread.h>
+#include <sched.h>
+#include <stdalign.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #define TIME_BUFFER_SIZE 25
 
+// Slots in the queue, and bytes of packed arguments a slot can hold. A
+// message whose arguments don't fit, such as a long shader log, is written
+// by the caller after the queue has been flushed.
+#define LOG_RING_SIZE     4096
+#define LOG_ARGUMENT_SIZE 216
+
 static const char* log_levels[] = {
-    "INFO",
     "TRACE",
+    "INFO",
     "WARN",
     "ERROR",
     "FATAL"
 };
 
-void core_log(FILE *stream, enum LogLevel level, const char *format, ...)
+struct LogRecord
+{
+    struct LogSite *site;
+    FILE *stream;
+    struct timespec time;
+    uint16_t size;
+    uint8_t arguments[LOG_ARGUMENT_SIZE];
+};
+
+// A bounded multi-producer queue in the style of Dmitry Vyukov's: every
+// slot carries a sequence number that says whether it is free for the
+// producer holding that position or ready for the writer.
+struct LogSlot
+{
+    alignas(64) _Atomic size_t sequence;
+    struct LogRecord record;
+};
+
+static struct LogSlot ring[LOG_RING_SIZE];
+static _Atomic size_t ring_tail = 0;
+static size_t ring_head = 0;
+static _Atomic size_t records_written = 0;
+
+static _Atomic bool async_enabled = true;
+static _Atomic bool writer_running = false;
+static _Atomic bool writer_sleeping = false;
+static bool writer_stopping = false;
+static pthread_once_t writer_once = PTHREAD_ONCE_INIT;
+static pthread_t writer_thread;
+static pthread_mutex_t writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_condition = PTHREAD_COND_INITIALIZER;
+
+enum LogLevel core_log_level = LOG_LEVEL_TRACE;
+
+// Written by the writer thread and by callers logging synchronously, under
+// binary_mutex. generation tells sites from earlier files apart.
+static _Atomic(FILE*) binary_file = NULL;
+static pthread_mutex_t binary_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t binary_generation = 0;
+static uint32_t binary_site_count = 0;
+
+static void write_text_header(FILE *stream, const struct LogSite *site, const struct timespec *time)
+{
+    // Messages usually arrive in bursts within the same second.
+    static _Thread_local time_t cached_second = -1;
+    static _Thread_local char text[TIME_BUFFER_SIZE];
+
+    if (time->tv_sec != cached_second)
+    {
+        struct tm local;
+        localtime_r(&time->tv_sec, &local);
+        strftime(text, TIME_BUFFER_SIZE, "%a %d %b %Y %H:%M:%S", &local);
+        cached_second = time->tv_sec;
+    }
+
+    fprintf(stream, "[%s] %-6s | ", text, log_levels[site->level]);
+}
+
+static void write_u16(FILE *file, uint16_t value)
+{
+    fwrite(&value, sizeof(value), 1, file);
+}
+
+static void write_u32(FILE *file, uint32_t value)
+{
+    fwrite(&value, sizeof(value), 1, file);
+}
+
+// Starts a binary record for site, describing the site first if this file
+// hasn't seen it. Call with binary_mutex held.
+static void write_binary_header(FILE *file, struct LogSite *site, uint8_t type, const struct timespec *time)
+{
+    if (site->generation != binary_generation || site->id == 0)
+    {
+        site->id = ++binary_site_count;
+        site->generation = binary_generation;
+
+        size_t file_length = strlen(site->file);
+        size_t format_length = strlen(site->format);
+        file_length = file_length < UINT16_MAX ? file_length : UINT16_MAX;
+        format_length = format_length < UINT16_MAX ? format_length : UINT16_MAX;
+
+        fputc(LOG_BINARY_SITE, file);
+        write_u32(file, site->id);
+        fputc((int)site->level, file);
+        write_u32(file, (uint32_t)site->line);
+        write_u16(file, (uint16_t)file_length);
+        fwrite(site->file, 1, file_length, file);
+        write_u16(file, (uint16_t)format_length);
+        fwrite(site->format, 1, format_length, file);
+    }
+
+    uint64_t nanoseconds = (uint64_t)time->tv_sec * 1000000000ull + (uint64_t)time->tv_nsec;
+    fputc(type, file);
+    write_u32(file, site->id);
+    fwrite(&nanoseconds, sizeof(nanoseconds), 1, file);
+}
+
+// Writes a message whose arguments are packed, to the binary log if one is
+// open and as text unless the binary log takes it alone.
+static void write_packed_message(
+    FILE *stream,
+    struct LogSite *site,
+    const struct timespec *time,
+    const uint8_t *arguments,
+    size_t size)
+{
+    bool binary_only = false;
+    if (atomic_load_explicit(&binary_file, memory_order_relaxed) != NULL)
+    {
+        pthread_mutex_lock(&binary_mutex);
+        FILE *binary = atomic_load_explicit(&binary_file, memory_order_relaxed);
+        if (binary != NULL)
+        {
+            write_binary_header(binary, site, LOG_BINARY_MESSAGE, time);
+            write_u16(binary, (uint16_t)size);
+            fwrite(arguments, 1, size, binary);
+            binary_only = site->level < LOG_LEVEL_WARN;
+        }
+        pthread_mutex_unlock(&binary_mutex);
+    }
+
+    if (binary_only)
+        return;
+
+    flockfile(stream);
+    write_text_header(stream, site, time);
+    write_log_arguments(stream, site->format, arguments, size);
+    fputc('\n', stream);
+    funlockfile(stream);
+}
+
+// For messages that couldn't be packed, on the calling thread.
+static void write_formatted_message(FILE *stream, struct LogSite *site, const char *format, va_list *args)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_REALTIME, &time);
+
+    bool binary_only = false;
+    if (atomic_load_explicit(&binary_file, memory_order_relaxed) != NULL)
+    {
+        va_list measuring;
+        va_copy(measuring, *args);
+        int length = vsnprintf(NULL, 0, format, measuring);
+        va_end(measuring);
+
+        if (length >= 0)
+        {
+            char *text = ALLOC_ARRAY(char, (size_t)length + 1);
+            va_list formatting;
+            va_copy(formatting, *args);
+            vsnprintf(text, (size_t)length + 1, format, formatting);
+            va_end(formatting);
+
+            pthread_mutex_lock(&binary_mutex);
+            FILE *binary = atomic_load_explicit(&binary_file, memory_order_relaxed);
+            if (binary != NULL)
+            {
+                write_binary_header(binary, site, LOG_BINARY_TEXT, &time);
+                write_u32(binary, (uint32_t)length);
+                fwrite(text, 1, (size_t)length, binary);
+                binary_only = site->level < LOG_LEVEL_WARN;
+            }
+            pthread_mutex_unlock(&binary_mutex);
+
+            FREE_ARRAY(text, char, (size_t)length + 1);
+        }
+    }
+
+    // A format vsnprintf rejects still goes out as text.
+    if (binary_only)
+        return;
+
+    // Keeps lines from different threads from interleaving.
+    flockfile(stream);
+    write_text_header(stream, site, &time);
+    vfprintf(stream, format, *args);
+    fputc('\n', stream);
+    funlockfile(stream);
+}
+
+static void write_record(const struct LogRecord *record)
+{
+    write_packed_message(record->stream, record->site, &record->time, record->arguments, record->size);
+}
+
+// Writes every record that is ready, in order. Only one thread at a time
+// may call it: the writer, or the thread shutting the writer down.
+static size_t write_ready_records()
+{
+    size_t count = 0;
+    for (;;)
+    {
+        struct LogSlot *slot = &ring[ring_head % LOG_RING_SIZE];
+        if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != ring_head + 1)
+            break;
+
+        write_record(&slot->record);
+        atomic_store_explicit(&slot->sequence, ring_head + LOG_RING_SIZE, memory_order_release);
+        ring_head++;
+        atomic_store_explicit(&records_written, ring_head, memory_order_release);
+        count++;
+    }
+
+    return count;
+}
+
+static bool is_record_ready()
+{
+    const struct LogSlot *slot = &ring[ring_head % LOG_RING_SIZE];
+    return atomic_load_explicit(&slot->sequence, memory_order_acquire) == ring_head + 1;
+}
+
+static void flush_streams()
+{
+    if (atomic_load_explicit(&binary_file, memory_order_relaxed) != NULL)
+    {
+        pthread_mutex_lock(&binary_mutex);
+        FILE *binary = atomic_load_explicit(&binary_file, memory_order_relaxed);
+        if (binary != NULL)
+        {
+            fflush(binary);
+        }
+        pthread_mutex_unlock(&binary_mutex);
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+}
+
+static void* writer_main(void *data)
+{
+    for (;;)
+    {
+        if (write_ready_records() > 0)
+            continue;
+
+        flush_streams();
+
+        pthread_mutex_lock(&writer_mutex);
+        atomic_store(&writer_sleeping, true);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!is_record_ready() && !writer_stopping)
+        {
+            // The timeout only guards against bugs; producers wake us.
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += 1;
+            pthread_cond_timedwait(&writer_condition, &writer_mutex, &deadline);
+        }
+        atomic_store(&writer_sleeping, false);
+        bool stopping = writer_stopping;
+        pthread_mutex_unlock(&writer_mutex);
+
+        if (stopping && !is_record_ready())
+            break;
+    }
+
+    return NULL;
+}
+
+static void wake_writer()
+{
+    pthread_mutex_lock(&writer_mutex);
+    pthread_cond_signal(&writer_condition);
+    pthread_mutex_unlock(&writer_mutex);
+}
+
+static void stop_writer()
+{
+    flush_log();
+
+    pthread_mutex_lock(&writer_mutex);
+    writer_stopping = true;
+    pthread_cond_signal(&writer_condition);
+    pthread_mutex_unlock(&writer_mutex);
+    pthread_join(writer_thread, NULL);
+
+    // Anything logged from here on is written synchronously, and whatever
+    // was queued while the writer was exiting is written now.
+    atomic_store(&writer_running, false);
+    write_ready_records();
+    flush_streams();
+}
+
+static void start_writer()
+{
+    for (size_t i = 0; i < LOG_RING_SIZE; i++)
+    {
+        atomic_init(&ring[i].sequence, i);
+    }
+
+    if (pthread_create(&writer_thread, NULL, writer_main, NULL) != 0)
+        return;
+
+    atomic_store(&writer_running, true);
+    atexit(stop_writer);
+}
+
+static bool is_async()
+{
+    if (!atomic_load_explicit(&async_enabled, memory_order_relaxed))
+        return false;
+
+    pthread_once(&writer_once, start_writer);
+    return atomic_load_explicit(&writer_running, memory_order_relaxed);
+}
+
+static void enqueue_message(FILE *stream, struct LogSite *site, const uint8_t *arguments, size_t size)
+{
+    size_t position = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    struct LogSlot *slot;
+    for (;;)
+    {
+        slot = &ring[position % LOG_RING_SIZE];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+        if (difference == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(
+                &ring_tail, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+
+        // The queue is full: let the writer catch up.
+        else if (difference < 0)
+        {
+            wake_writer();
+            sched_yield();
+            position = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+        }
+
+        else
+        {
+            position = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+        }
+    }
+
+    struct LogRecord *record = &slot->record;
+    record->site = site;
+    record->stream = stream;
+    record->size = (uint16_t)size;
+    clock_gettime(CLOCK_REALTIME, &record->time);
+    memcpy(record->arguments, arguments, size);
+
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+
+    // Pairs with the writer announcing it sleeps before it looks at the
+    // queue a last time, so one side always sees the other.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&writer_sleeping, memory_order_relaxed))
+    {
+        wake_writer();
+    }
+}
+
+static void write_message(FILE *stream, struct LogSite *site, const char *format, va_list *args)
 {
     char time[TIME_BUFFER_SIZE];
     get_time(time, TIME_BUFFER_SIZE, "%a %d %b %Y %H:%M:%S");
-    fprintf(stream, "[%s] %-6s | ", time, log_levels[level]);
 
+    // Keeps lines from different threads from interleaving.
+    flockfile(stream);
+    fprintf(stream, "[%s] %-6s | ", time, log_levels[site->level]);
+    vfprintf(stream, format, *args);
+    fprintf(stream, "\n");
+    funlockfile(stream);
+}
+
+void core_log(FILE *stream, struct LogSite *site, const char *format, ...)
+{
     va_list args;
     va_start(args, format);
-    vfprintf(stream, format, args);
+
+    bool async = is_async();
+    if (async || atomic_load_explicit(&binary_file, memory_order_relaxed) != NULL)
+    {
+        uint8_t arguments[LOG_ARGUMENT_SIZE];
+        size_t size;
+        va_list packing;
+        va_copy(packing, args);
+        bool packed = pack_log_arguments(format, &packing, arguments, LOG_ARGUMENT_SIZE, &size);
+        va_end(packing);
+
+        if (packed && async)
+        {
+            enqueue_message(stream, site, arguments, size);
+        }
+
+        else if (packed)
+        {
+            struct timespec time;
+            clock_gettime(CLOCK_REALTIME, &time);
+            write_packed_message(stream, site, &time, arguments, size);
+        }
+
+        else
+        {
+            flush_log();
+            write_formatted_message(stream, site, format, &args);
+        }
+    }
+
+    else
+    {
+        write_message(stream, site, format, &args);
+    }
     va_end(args);
 
-    fprintf(stream, "\n");
+    if (site->level == LOG_LEVEL_FATAL)
+    {
+        flush_log();
+    }
+}
+
+void flush_log()
+{
+    if (atomic_load(&writer_running))
+    {
+        size_t position = atomic_load(&ring_tail);
+        wake_writer();
+
+        while (atomic_load_explicit(&records_written, memory_order_acquire) < position)
+        {
+            struct timespec pause = { 0, 50000 };
+            nanosleep(&pause, NULL);
+        }
+    }
+
+    flush_streams();
+}
+
+void set_log_async(bool async)
+{
+    if (!async)
+    {
+        flush_log();
+    }
+
+    atomic_store(&async_enabled, async);
+}
+
+void set_log_level(enum LogLevel level)
+{
+    core_log_level = level;
+}
+
+bool parse_log_level(const char *name, enum LogLevel *level)
+{
+    static const char* names[] = { "trace", "info", "warn", "error", "fatal" };
+
+    for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++)
+    {
+        if (strcmp(name, names[i]) == 0)
+        {
+            *level = (enum LogLevel)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool open_binary_log(const char *path)
+{
+    close_binary_log();
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        LOG_ERROR("Failed to open binary log %s", path);
+        return false;
+    }
+
+    uint32_t byte_order = LOG_BINARY_BYTE_ORDER;
+    fwrite(LOG_BINARY_MAGIC, 1, sizeof(LOG_BINARY_MAGIC), file);
+    fwrite(&byte_order, sizeof(byte_order), 1, file);
+
+    // Sites described in an earlier file have to be described again.
+    pthread_mutex_lock(&binary_mutex);
+    binary_generation++;
+    binary_site_count = 0;
+    atomic_store_explicit(&binary_file, file, memory_order_relaxed);
+    pthread_mutex_unlock(&binary_mutex);
+
+    return true;
+}
+
+void close_binary_log()
+{
+    if (atomic_load(&binary_file) == NULL)
+        return;
+
+    flush_log();
+    pthread_mutex_lock(&binary_mutex);
+    FILE *file = atomic_exchange(&binary_file, NULL);
+    pthread_mutex_unlock(&binary_mutex);
+
+    if (file != NULL && fclose(file) != 0)
+    {
+        LOG_ERROR("Failed to write binary log");
+    }
 }
\ No newline at end of file
@@ -0,0 +1,468 @@
+#include <core/log_format.h>
+
+#include <limits.h>
+#include <string.h>
+
+// Longest conversion specification that is rebuilt for formatting.
+#define LOG_SPEC_SIZE 32
+
+enum LengthModifier
+{
+    LENGTH_NONE,
+    LENGTH_HH,
+    LENGTH_H,
+    LENGTH_L,
+    LENGTH_LL,
+    LENGTH_J,
+    LENGTH_Z,
+    LENGTH_T,
+    LENGTH_LONG_DOUBLE
+};
+
+// One conversion of a printf format, from its '%' up to and including the
+// conversion character.
+struct FormatSpec
+{
+    const char *start;
+    const char *length_start;
+    const char *end;
+    bool star_width;
+    bool star_precision;
+    // -1 without a precision. A '*' precision is only known once its
+    // argument is read.
+    int precision;
+    enum LengthModifier length;
+    char conversion;
+};
+
+static const char* parse_spec(const char *format, struct FormatSpec *spec)
+{
+    const char *p = format + 1;
+    spec->start = format;
+    spec->star_width = false;
+    spec->star_precision = false;
+    spec->precision = -1;
+    spec->length = LENGTH_NONE;
+
+    while (*p != '\0' && strchr("-+ #0'", *p) != NULL)
+    {
+        p++;
+    }
+
+    if (*p == '*')
+    {
+        spec->star_width = true;
+        p++;
+    }
+
+    while (*p >= '0' && *p <= '9')
+    {
+        p++;
+    }
+
+    if (*p == '.')
+    {
+        p++;
+        spec->precision = 0;
+        if (*p == '*')
+        {
+            spec->star_precision = true;
+            p++;
+        }
+
+        while (*p >= '0' && *p <= '9')
+        {
+            int digit = *p - '0';
+            spec->precision = spec->precision <= (INT_MAX - digit) / 10 ? 10 * spec->precision + digit : INT_MAX;
+            p++;
+        }
+    }
+
+    spec->length_start = p;
+    switch (*p)
+    {
+    case 'h':
+        spec->length = p[1] == 'h' ? LENGTH_HH : LENGTH_H;
+        p += p[1] == 'h' ? 2 : 1;
+        break;
+
+    case 'l':
+        spec->length = p[1] == 'l' ? LENGTH_LL : LENGTH_L;
+        p += p[1] == 'l' ? 2 : 1;
+        break;
+
+    case 'j': spec->length = LENGTH_J; p++; break;
+    case 'z': spec->length = LENGTH_Z; p++; break;
+    case 't': spec->length = LENGTH_T; p++; break;
+    case 'L': spec->length = LENGTH_LONG_DOUBLE; p++; break;
+    default: break;
+    }
+
+    spec->conversion = *p;
+    spec->end = *p != '\0' ? p + 1 : p;
+
+    return spec->end;
+}
+
+struct ArgumentWriter
+{
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+};
+
+static bool put_argument(struct ArgumentWriter *writer, const void *value, size_t size)
+{
+    if (size > writer->capacity - writer->size)
+        return false;
+
+    memcpy(writer->data + writer->size, value, size);
+    writer->size += size;
+
+    return true;
+}
+
+static long long get_signed_argument(va_list *args, enum LengthModifier length)
+{
+    switch (length)
+    {
+    case LENGTH_L:  return va_arg(*args, long);
+    case LENGTH_LL: return va_arg(*args, long long);
+    case LENGTH_J:  return va_arg(*args, intmax_t);
+    case LENGTH_Z:  return va_arg(*args, ptrdiff_t);
+    case LENGTH_T:  return va_arg(*args, ptrdiff_t);
+    case LENGTH_HH: return (signed char)va_arg(*args, int);
+    case LENGTH_H:  return (short)va_arg(*args, int);
+    default:        return va_arg(*args, int);
+    }
+}
+
+static unsigned long long get_unsigned_argument(va_list *args, enum LengthModifier length)
+{
+    switch (length)
+    {
+    case LENGTH_L:  return va_arg(*args, unsigned long);
+    case LENGTH_LL: return va_arg(*args, unsigned long long);
+    case LENGTH_J:  return va_arg(*args, uintmax_t);
+    case LENGTH_Z:  return va_arg(*args, size_t);
+    case LENGTH_T:  return (unsigned long long)va_arg(*args, ptrdiff_t);
+    case LENGTH_HH: return (unsigned char)va_arg(*args, unsigned int);
+    case LENGTH_H:  return (unsigned short)va_arg(*args, unsigned int);
+    default:        return va_arg(*args, unsigned int);
+    }
+}
+
+bool pack_log_arguments(const char *format, va_list *args, uint8_t *data, size_t capacity, size_t *size)
+{
+    struct ArgumentWriter writer = { data, 0, capacity };
+
+    const char *p = format;
+    while ((p = strchr(p, '%')) != NULL)
+    {
+        struct FormatSpec spec;
+        p = parse_spec(p, &spec);
+
+        if (spec.conversion == '%')
+            continue;
+
+        if (spec.star_width)
+        {
+            int width = va_arg(*args, int);
+            if (!put_argument(&writer, &width, sizeof(width)))
+                return false;
+        }
+
+        if (spec.star_precision)
+        {
+            int precision = va_arg(*args, int);
+            if (!put_argument(&writer, &precision, sizeof(precision)))
+                return false;
+
+            // printf takes a negative precision as none.
+            spec.precision = precision >= 0 ? precision : -1;
+        }
+
+        bool packed;
+        switch (spec.conversion)
+        {
+        case 'd':
+        case 'i':
+        {
+            long long value = get_signed_argument(args, spec.length);
+            packed = put_argument(&writer, &value, sizeof(value));
+            break;
+        }
+
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        {
+            unsigned long long value = get_unsigned_argument(args, spec.length);
+            packed = put_argument(&writer, &value, sizeof(value));
+            break;
+        }
+
+        case 'c':
+        {
+            int value = va_arg(*args, int);
+            packed = spec.length == LENGTH_NONE && put_argument(&writer, &value, sizeof(value));
+            break;
+        }
+
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+        {
+            if (spec.length == LENGTH_LONG_DOUBLE)
+            {
+                long double value = va_arg(*args, long double);
+                packed = put_argument(&writer, &value, sizeof(value));
+            }
+
+            else
+            {
+                double value = va_arg(*args, double);
+                packed = put_argument(&writer, &value, sizeof(value));
+            }
+            break;
+        }
+
+        case 'p':
+        {
+            void *value = va_arg(*args, void*);
+            packed = put_argument(&writer, &value, sizeof(value));
+            break;
+        }
+
+        case 's':
+        {
+            if (spec.length != LENGTH_NONE)
+                return false;
+
+            // Only the characters the precision lets through are copied, so
+            // an unterminated buffer with a precision is read no further
+            // than printf would.
+            const char *value = va_arg(*args, const char*);
+            value = value != NULL ? value : "(null)";
+            size_t length = spec.precision >= 0 ? strnlen(value, (size_t)spec.precision) : strlen(value);
+            packed = put_argument(&writer, value, length) && put_argument(&writer, "", 1);
+            break;
+        }
+
+        default:
+            packed = false;
+            break;
+        }
+
+        if (!packed)
+            return false;
+    }
+
+    *size = writer.size;
+    return true;
+}
+
+struct ArgumentReader
+{
+    const uint8_t *data;
+    size_t size;
+    size_t offset;
+};
+
+static bool get_argument(struct ArgumentReader *reader, void *value, size_t size)
+{
+    if (size > reader->size - reader->offset)
+        return false;
+
+    memcpy(value, reader->data + reader->offset, size);
+    reader->offset += size;
+
+    return true;
+}
+
+// Rebuilds spec with the '*' fields filled in and the length modifier of
+// the packed type, e.g. "%-*zu" with a width of 8 becomes "%-8llu".
+static bool rebuild_spec(const struct FormatSpec *spec, struct ArgumentReader *reader, char *buffer)
+{
+    size_t size = 0;
+    for (const char *p = spec->start; p < spec->length_start; p++)
+    {
+        if (size >= LOG_SPEC_SIZE - 16)
+            return false;
+
+        if (*p != '*')
+        {
+            buffer[size++] = *p;
+            continue;
+        }
+
+        int value;
+        if (!get_argument(reader, &value, sizeof(value)))
+            return false;
+
+        // A negative precision counts as none, which is not ".".
+        bool precision = p > spec->start && p[-1] == '.';
+        if (precision && value < 0)
+        {
+            size--;
+            continue;
+        }
+
+        size += (size_t)snprintf(buffer + size, LOG_SPEC_SIZE - size, "%d", value);
+    }
+
+    const char *length = "";
+    switch (spec->conversion)
+    {
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+        length = "ll";
+        break;
+
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        length = spec->length == LENGTH_LONG_DOUBLE ? "L" : "";
+        break;
+
+    case 'c': case 'p': case 's':
+        break;
+
+    // Formats come from the log file, so anything pack_log_arguments would
+    // not have written, %n above all, never reaches fprintf.
+    default:
+        return false;
+    }
+
+    snprintf(buffer + size, LOG_SPEC_SIZE - size, "%s%c", length, spec->conversion);
+    return true;
+}
+
+static bool write_argument(FILE *stream, const struct FormatSpec *spec, const char *format, struct ArgumentReader *reader)
+{
+    switch (spec->conversion)
+    {
+    case 'd':
+    case 'i':
+    {
+        long long value;
+        if (!get_argument(reader, &value, sizeof(value)))
+            return false;
+
+        fprintf(stream, format, value);
+        return true;
+    }
+
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+    {
+        unsigned long long value;
+        if (!get_argument(reader, &value, sizeof(value)))
+            return false;
+
+        fprintf(stream, format, value);
+        return true;
+    }
+
+    case 'c':
+    {
+        int value;
+        if (!get_argument(reader, &value, sizeof(value)))
+            return false;
+
+        fprintf(stream, format, value);
+        return true;
+    }
+
+    case 'p':
+    {
+        void *value;
+        if (!get_argument(reader, &value, sizeof(value)))
+            return false;
+
+        fprintf(stream, format, value);
+        return true;
+    }
+
+    case 's':
+    {
+        const char *value = (const char*)reader->data + reader->offset;
+        const char *end = memchr(value, '\0', reader->size - reader->offset);
+        if (end == NULL)
+            return false;
+
+        reader->offset += (size_t)(end - value) + 1;
+        fprintf(stream, format, value);
+        return true;
+    }
+
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        break;
+
+    default:
+        return false;
+    }
+
+    if (spec->length == LENGTH_LONG_DOUBLE)
+    {
+        long double value;
+        if (!get_argument(reader, &value, sizeof(value)))
+            return false;
+
+        fprintf(stream, format, value);
+        return true;
+    }
+
+    double value;
+    if (!get_argument(reader, &value, sizeof(value)))
+        return false;
+
+    fprintf(stream, format, value);
+    return true;
+}
+
+bool write_log_arguments(FILE *stream, const char *format, const uint8_t *data, size_t size)
+{
+    struct ArgumentReader reader = { data, size, 0 };
+    char spec_buffer[LOG_SPEC_SIZE];
+
+    const char *p = format;
+    for (;;)
+    {
+        const char *percent = strchr(p, '%');
+        if (percent == NULL)
+        {
+            fputs(p, stream);
+            return true;
+        }
+
+        fwrite(p, 1, (size_t)(percent - p), stream);
+
+        struct FormatSpec spec;
+        p = parse_spec(percent, &spec);
+
+        if (spec.conversion == '%')
+        {
+            fputc('%', stream);
+            continue;
+        }
+
+        if (!rebuild_spec(&spec, &reader, spec_buffer) || !write_argument(stream, &spec, spec_buffer, &reader))
+        {
+            fwrite(spec.start, 1, (size_t)(spec.end - spec.start), stream);
+            return false;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,481 @@
+#define MEMORY_TAG MEMORY_TAG_PROFILE
+
+#include <common.h>
+#include <memory.h>
+#include <util.h>
+#include <core/log.h>
+#include <core/profile.h>
+
+#include <glad/glad.h>
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PROFILE_BLOCK_EVENTS 1024
+#define PROFILE_MAX_DEPTH 64
+#define PROFILE_THREAD_NAME_SIZE 32
+
+// One frame being recorded plus the frames waiting for their results.
+#define GPU_FRAME_RING_SIZE (PROFILE_GPU_LATENCY + 1)
+
+// A closed scope, in seconds since the profiler started.
+struct ProfileEvent
+{
+    const char *name;
+    double start;
+    double duration;
+};
+
+struct ProfileBlock
+{
+    struct ProfileBlock *next;
+    int count;
+    struct ProfileEvent events[PROFILE_BLOCK_EVENTS];
+};
+
+// Events of one thread, appended to by that thread only. The record is
+// owned by the profiler and outlives the thread, so the events of threads
+// that exit early are still written.
+struct ProfileThread
+{
+    struct ProfileThread *next;
+    int id;
+    char name[PROFILE_THREAD_NAME_SIZE];
+
+    struct ProfileBlock *first;
+    struct ProfileBlock *last;
+    size_t event_count;
+
+    // Scopes deeper than PROFILE_MAX_DEPTH are counted so their ends pair
+    // up, but not recorded.
+    const char *open_names[PROFILE_MAX_DEPTH];
+    double open_starts[PROFILE_MAX_DEPTH];
+    int depth;
+};
+
+struct GpuFrame
+{
+    unsigned int queries[PROFILE_GPU_SCOPES];
+    const char *names[PROFILE_GPU_SCOPES];
+    double starts[PROFILE_GPU_SCOPES];
+    int count;
+};
+
+static atomic_bool profiler_running;
+
+// Bumped by start_profiler and stop_profiler, so thread records of other
+// sessions are never used.
+static atomic_uint profiler_generation;
+
+static pthread_mutex_t profile_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct ProfileThread *profile_threads;
+static int profile_thread_count;
+static FILE *profile_file;
+static const char *profile_path;
+static double profile_start;
+
+static _Thread_local struct ProfileThread *current_thread;
+static _Thread_local unsigned int current_generation;
+static _Thread_local char current_thread_name[PROFILE_THREAD_NAME_SIZE];
+
+// GPU state is only touched from the GL thread.
+static struct GpuFrame gpu_frames[GPU_FRAME_RING_SIZE];
+static struct ProfileThread gpu_track;
+static bool gpu_queries_created;
+static int gpu_current;
+static int gpu_pending;
+static int gpu_depth;
+static bool gpu_recording;
+static size_t gpu_skipped;
+static size_t gpu_discarded;
+
+static double get_profile_time()
+{
+    return get_monotonic_time() - profile_start;
+}
+
+static void add_event(struct ProfileThread *thread, const char *name, double start, double duration)
+{
+    struct ProfileBlock *block = thread->last;
+    if (block == NULL || block->count == PROFILE_BLOCK_EVENTS)
+    {
+        block = ALLOC(struct ProfileBlock);
+        block->next = NULL;
+        block->count = 0;
+
+        if (thread->last != NULL)
+        {
+            thread->last->next = block;
+        }
+
+        else
+        {
+            thread->first = block;
+        }
+        thread->last = block;
+    }
+
+    block->events[block->count++] = (struct ProfileEvent){ name, start, duration };
+    thread->event_count++;
+}
+
+static void free_events(struct ProfileThread *thread)
+{
+    struct ProfileBlock *block = thread->first;
+    while (block != NULL)
+    {
+        struct ProfileBlock *next = block->next;
+        FREE(block, struct ProfileBlock);
+        block = next;
+    }
+
+    thread->first = NULL;
+    thread->last = NULL;
+    thread->event_count = 0;
+}
+
+// Returns the calling thread's record for the current session, registering
+// it on first use, or NULL if the profiler has stopped.
+static struct ProfileThread* get_profile_thread()
+{
+    unsigned int generation = atomic_load_explicit(&profiler_generation, memory_order_acquire);
+    if (current_thread != NULL && current_generation == generation)
+        return current_thread;
+
+    struct ProfileThread *thread = ALLOC(struct ProfileThread);
+    memset(thread, 0, sizeof(struct ProfileThread));
+
+    pthread_mutex_lock(&profile_mutex);
+    if (!atomic_load_explicit(&profiler_running, memory_order_relaxed))
+    {
+        pthread_mutex_unlock(&profile_mutex);
+        FREE(thread, struct ProfileThread);
+        return NULL;
+    }
+
+    thread->id = ++profile_thread_count;
+    if (current_thread_name[0] != '\0')
+    {
+        memcpy(thread->name, current_thread_name, PROFILE_THREAD_NAME_SIZE);
+    }
+
+    else
+    {
+        snprintf(thread->name, PROFILE_THREAD_NAME_SIZE, "thread %d", thread->id);
+    }
+
+    thread->next = profile_threads;
+    profile_threads = thread;
+    pthread_mutex_unlock(&profile_mutex);
+
+    current_thread = thread;
+    current_generation = generation;
+    return thread;
+}
+
+bool start_profiler(const char *path)
+{
+    if (atomic_load(&profiler_running))
+    {
+        LOG_WARN("The profiler is already running");
+        return false;
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        LOG_ERROR("Failed to create profile %s", path);
+        return false;
+    }
+
+    pthread_mutex_lock(&profile_mutex);
+    profile_file = file;
+    profile_path = path;
+    profile_start = get_monotonic_time();
+    profile_thread_count = 0;
+    pthread_mutex_unlock(&profile_mutex);
+
+    memset(&gpu_track, 0, sizeof(struct ProfileThread));
+    snprintf(gpu_track.name, PROFILE_THREAD_NAME_SIZE, "GPU");
+    gpu_skipped = 0;
+    gpu_discarded = 0;
+
+    atomic_fetch_add_explicit(&profiler_generation, 1, memory_order_release);
+    atomic_store_explicit(&profiler_running, true, memory_order_release);
+
+    LOG_TRACE("Profiling to %s", path);
+    return true;
+}
+
+void set_profile_thread_name(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vsnprintf(current_thread_name, PROFILE_THREAD_NAME_SIZE, format, args);
+    va_end(args);
+
+    if (current_thread != NULL &&
+        current_generation == atomic_load_explicit(&profiler_generation, memory_order_acquire))
+    {
+        memcpy(current_thread->name, current_thread_name, PROFILE_THREAD_NAME_SIZE);
+    }
+}
+
+void begin_profile_scope(const char *name)
+{
+    if (!atomic_load_explicit(&profiler_running, memory_order_acquire))
+        return;
+
+    struct ProfileThread *thread = get_profile_thread();
+    if (thread == NULL)
+        return;
+
+    if (thread->depth < PROFILE_MAX_DEPTH)
+    {
+        thread->open_names[thread->depth] = name;
+        thread->open_starts[thread->depth] = get_profile_time();
+    }
+    thread->depth++;
+}
+
+void end_profile_scope()
+{
+    if (!atomic_load_explicit(&profiler_running, memory_order_acquire))
+        return;
+
+    // Scopes opened before the profiler started have nothing to close.
+    struct ProfileThread *thread = current_thread;
+    if (thread == NULL ||
+        current_generation != atomic_load_explicit(&profiler_generation, memory_order_relaxed) ||
+        thread->depth == 0)
+        return;
+
+    thread->depth--;
+    if (thread->depth < PROFILE_MAX_DEPTH)
+    {
+        double start = thread->open_starts[thread->depth];
+        add_event(thread, thread->open_names[thread->depth], start, get_profile_time() - start);
+    }
+}
+
+void begin_gpu_profile_scope(const char *name)
+{
+    if (gpu_depth++ > 0 || !atomic_load_explicit(&profiler_running, memory_order_relaxed))
+        return;
+
+    if (!gpu_queries_created)
+    {
+        for (int i = 0; i < GPU_FRAME_RING_SIZE; i++)
+        {
+            glGenQueries(PROFILE_GPU_SCOPES, gpu_frames[i].queries);
+            gpu_frames[i].count = 0;
+        }
+        gpu_queries_created = true;
+    }
+
+    // Skipped rather than waited for when every frame is still in flight.
+    struct GpuFrame *frame = &gpu_frames[gpu_current];
+    if (gpu_pending == PROFILE_GPU_LATENCY || frame->count == PROFILE_GPU_SCOPES)
+    {
+        gpu_skipped++;
+        return;
+    }
+
+    // GL_TIME_ELAPSED gives durations only, so scopes are placed on the
+    // timeline at the time they were submitted.
+    frame->names[frame->count] = name;
+    frame->starts[frame->count] = get_profile_time();
+    glBeginQuery(GL_TIME_ELAPSED, frame->queries[frame->count]);
+    gpu_recording = true;
+}
+
+void end_gpu_profile_scope()
+{
+    if (gpu_depth == 0 || --gpu_depth > 0 || !gpu_recording)
+        return;
+
+    glEndQuery(GL_TIME_ELAPSED);
+    gpu_frames[gpu_current].count++;
+    gpu_recording = false;
+}
+
+// Moves a frame's results to the GPU track. Without wait, returns false if
+// they are not ready yet; queries complete in order, so the last one being
+// available means all of them are.
+static bool read_gpu_frame(struct GpuFrame *frame, bool wait)
+{
+    if (frame->count == 0)
+        return true;
+
+    if (!wait)
+    {
+        unsigned int available = 0;
+        glGetQueryObjectuiv(frame->queries[frame->count - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return false;
+    }
+
+    // Some drivers (llvmpipe among them) report the first query of a
+    // context as starting at zero. No scope can take longer than the time
+    // since it was submitted, so such results are dropped.
+    double now = get_profile_time();
+    for (int i = 0; i < frame->count; i++)
+    {
+        uint64_t elapsed = 0;
+        glGetQueryObjectui64v(frame->queries[i], GL_QUERY_RESULT, &elapsed);
+
+        double duration = 1e-9 * (double)elapsed;
+        if (duration > now - frame->starts[i])
+        {
+            gpu_discarded++;
+            continue;
+        }
+
+        add_event(&gpu_track, frame->names[i], frame->starts[i], duration);
+    }
+
+    frame->count = 0;
+    return true;
+}
+
+void collect_gpu_profile()
+{
+    if (!gpu_queries_created || gpu_recording)
+        return;
+
+    if (gpu_frames[gpu_current].count > 0)
+    {
+        gpu_current = (gpu_current + 1) % GPU_FRAME_RING_SIZE;
+        gpu_pending++;
+    }
+
+    while (gpu_pending > 0)
+    {
+        int oldest = (gpu_current - gpu_pending + GPU_FRAME_RING_SIZE) % GPU_FRAME_RING_SIZE;
+        if (!read_gpu_frame(&gpu_frames[oldest], false))
+            break;
+
+        gpu_pending--;
+    }
+}
+
+static void write_thread(FILE *file, const struct ProfileThread *thread, const char *category)
+{
+    fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", thread->id);
+    write_json_string(file, thread->name);
+    fprintf(file, "}}");
+
+    fprintf(
+        file,
+        ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}",
+        thread->id,
+        thread->id
+    );
+
+    for (const struct ProfileBlock *block = thread->first; block != NULL; block = block->next)
+    {
+        for (int i = 0; i < block->count; i++)
+        {
+            const struct ProfileEvent *event = &block->events[i];
+            fprintf(file, ",\n{\"name\":");
+            write_json_string(file, event->name);
+            fprintf(
+                file,
+                ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                category,
+                thread->id,
+                1e6 * event->start,
+                1e6 * event->duration
+            );
+        }
+    }
+}
+
+bool stop_profiler()
+{
+    if (!atomic_load(&profiler_running))
+        return false;
+
+    // Whatever the GPU still owes is waited for; the program is done
+    // rendering by now.
+    if (gpu_queries_created)
+    {
+        if (!gpu_recording && gpu_frames[gpu_current].count > 0)
+        {
+            gpu_current = (gpu_current + 1) % GPU_FRAME_RING_SIZE;
+            gpu_pending++;
+        }
+
+        for (; gpu_pending > 0; gpu_pending--)
+        {
+            int oldest = (gpu_current - gpu_pending + GPU_FRAME_RING_SIZE) % GPU_FRAME_RING_SIZE;
+            read_gpu_frame(&gpu_frames[oldest], true);
+        }
+
+        for (int i = 0; i < GPU_FRAME_RING_SIZE; i++)
+        {
+            glDeleteQueries(PROFILE_GPU_SCOPES, gpu_frames[i].queries);
+            gpu_frames[i].count = 0;
+        }
+
+        gpu_queries_created = false;
+        gpu_recording = false;
+        gpu_depth = 0;
+        gpu_current = 0;
+    }
+
+    // The records are freed below, so threads must not find them again.
+    pthread_mutex_lock(&profile_mutex);
+    atomic_store(&profiler_running, false);
+    atomic_fetch_add(&profiler_generation, 1);
+
+    FILE *file = profile_file;
+    size_t event_count = gpu_track.event_count;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"tessellation\"}}");
+
+    write_thread(file, &gpu_track, "gpu");
+    free_events(&gpu_track);
+
+    struct ProfileThread *thread = profile_threads;
+    while (thread != NULL)
+    {
+        struct ProfileThread *next = thread->next;
+        event_count += thread->event_count;
+        write_thread(file, thread, "cpu");
+        free_events(thread);
+        FREE(thread, struct ProfileThread);
+        thread = next;
+    }
+
+    fprintf(file, "\n]}\n");
+    bool success = !ferror(file);
+    success = fclose(file) == 0 && success;
+
+    profile_threads = NULL;
+    profile_file = NULL;
+    const char *path = profile_path;
+    pthread_mutex_unlock(&profile_mutex);
+
+    if (gpu_skipped > 0)
+    {
+        LOG_WARN("Skipped %zu GPU scopes while every query was in flight", gpu_skipped);
+    }
+
+    if (gpu_discarded > 0)
+    {
+        LOG_TRACE("Discarded %zu GPU timings longer than the time since they were submitted", gpu_discarded);
+    }
+
+    if (!success)
+    {
+        LOG_ERROR("Failed to write profile %s", path);
+        return false;
+    }
+
+    LOG_TRACE("Wrote %zu profile events to %s", event_count, path);
+    return true;
+}
\ No newline at end of file
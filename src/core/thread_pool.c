@@ -0,0 +1,291 @@
+#include <common.h>
+#include <memory.h>
+#include <core/log.h>
+#include <core/profile.h>
+#include <core/thread_pool.h>
+
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+
+struct WorkerStart
+{
+    struct ThreadPool *pool;
+    int index;
+};
+
+int get_hardware_thread_count()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
+
+static void push_task(struct WorkDeque *deque, size_t task)
+{
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    atomic_store_explicit(&deque->tasks[bottom & (deque->capacity - 1)], task, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+}
+
+static bool pop_task(struct WorkDeque *deque, size_t *task)
+{
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (top > bottom)
+    {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return false;
+    }
+
+    *task = atomic_load_explicit(&deque->tasks[bottom & (deque->capacity - 1)], memory_order_relaxed);
+    if (top < bottom)
+        return true;
+
+    // Last task: race any thief for it.
+    bool won = atomic_compare_exchange_strong_explicit(
+        &deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return won;
+}
+
+static bool steal_task(struct WorkDeque *deque, size_t *task)
+{
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+    if (top >= bottom)
+        return false;
+
+    *task = atomic_load_explicit(&deque->tasks[top & (deque->capacity - 1)], memory_order_relaxed);
+    return atomic_compare_exchange_strong_explicit(
+        &deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+}
+
+static void run_task(struct ThreadPool *pool, size_t task, int worker)
+{
+    pool->function(pool->data, task, worker);
+    atomic_fetch_sub_explicit(&pool->remaining_tasks, 1, memory_order_acq_rel);
+}
+
+static void execute_job(struct ThreadPool *pool, int worker)
+{
+    struct WorkDeque *own = &pool->deques[worker];
+
+    // Pushed in reverse so the owner pops its share in ascending order while
+    // thieves take from the far end.
+    size_t first = pool->task_count * (size_t)worker / (size_t)pool->worker_count;
+    size_t last = pool->task_count * (size_t)(worker + 1) / (size_t)pool->worker_count;
+    for (size_t task = last; task > first; task--)
+    {
+        push_task(own, task - 1);
+    }
+
+    size_t task;
+    while (atomic_load_explicit(&pool->remaining_tasks, memory_order_acquire) > 0)
+    {
+        if (pop_task(own, &task))
+        {
+            run_task(pool, task, worker);
+            continue;
+        }
+
+        bool stolen = false;
+        for (int i = 1; i < pool->worker_count && !stolen; i++)
+        {
+            int victim = (worker + i) % pool->worker_count;
+            stolen = steal_task(&pool->deques[victim], &task);
+        }
+
+        if (stolen)
+        {
+            run_task(pool, task, worker);
+        }
+
+        else
+        {
+            sched_yield();
+        }
+    }
+}
+
+static void* worker_main(void *argument)
+{
+    struct WorkerStart *start = (struct WorkerStart*)argument;
+    struct ThreadPool *pool = start->pool;
+    int index = start->index;
+    FREE(start, struct WorkerStart);
+    PROFILE_THREAD("worker %d", index);
+
+    uint64_t seen_generation = 0;
+    for (;;)
+    {
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->generation == seen_generation && !pool->shutting_down)
+        {
+            pthread_cond_wait(&pool->start_condition, &pool->mutex);
+        }
+
+        if (pool->shutting_down)
+        {
+            pthread_mutex_unlock(&pool->mutex);
+            break;
+        }
+
+        seen_generation = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        execute_job(pool, index);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->active_workers == 0)
+        {
+            pthread_cond_signal(&pool->done_condition);
+        }
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    return NULL;
+}
+
+bool init_thread_pool(struct ThreadPool *pool, int worker_count)
+{
+    memset(pool, 0, sizeof(struct ThreadPool));
+    pool->worker_count = worker_count > 0 ? worker_count : get_hardware_thread_count();
+    pool->capacity = pool->worker_count;
+
+    // Worker 0 is whichever thread calls run_thread_pool.
+    pool->deques = ALLOC_ARRAY(struct WorkDeque, pool->capacity);
+    pool->threads = ALLOC_ARRAY(pthread_t, pool->capacity);
+    if (pool->deques == NULL || pool->threads == NULL)
+    {
+        LOG_ERROR("Failed to allocate a pool of %d workers", pool->capacity);
+        FREE_ARRAY(pool->threads, pthread_t, pool->capacity);
+        FREE_ARRAY(pool->deques, struct WorkDeque, pool->capacity);
+        memset(pool, 0, sizeof(struct ThreadPool));
+        return false;
+    }
+    memset(pool->deques, 0, pool->capacity * sizeof(struct WorkDeque));
+
+    pthread_mutex_init(&pool->run_mutex, NULL);
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->start_condition, NULL);
+    pthread_cond_init(&pool->done_condition, NULL);
+
+    for (int i = 1; i < pool->worker_count; i++)
+    {
+        struct WorkerStart *start = ALLOC(struct WorkerStart);
+        if (start != NULL)
+        {
+            start->pool = pool;
+            start->index = i;
+        }
+
+        if (start == NULL || pthread_create(&pool->threads[i], NULL, worker_main, start) != 0)
+        {
+            LOG_WARN("Failed to start worker thread %d, continuing with %d workers", i, i);
+            FREE(start, struct WorkerStart);
+            pool->worker_count = i;
+            break;
+        }
+    }
+
+    return true;
+}
+
+void destroy_thread_pool(struct ThreadPool *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutting_down = true;
+    pthread_cond_broadcast(&pool->start_condition);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int i = 1; i < pool->worker_count; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    for (int i = 0; i < pool->worker_count; i++)
+    {
+        if (pool->deques[i].tasks != NULL)
+        {
+            FREE_ARRAY((void*)pool->deques[i].tasks, size_t, pool->deques[i].capacity);
+        }
+    }
+
+    pthread_cond_destroy(&pool->done_condition);
+    pthread_cond_destroy(&pool->start_condition);
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_mutex_destroy(&pool->run_mutex);
+
+    FREE_ARRAY(pool->threads, pthread_t, pool->capacity);
+    FREE_ARRAY(pool->deques, struct WorkDeque, pool->capacity);
+    memset(pool, 0, sizeof(struct ThreadPool));
+}
+
+void run_thread_pool(struct ThreadPool *pool, size_t task_count, ThreadTaskFunction function, void *data)
+{
+    if (task_count == 0)
+        return;
+
+    if (pool == NULL)
+    {
+        for (size_t i = 0; i < task_count; i++)
+        {
+            function(data, i, 0);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->run_mutex);
+
+    // Every worker is idle here, so the deques can be resized safely.
+    int64_t share = (int64_t)((task_count + pool->worker_count - 1) / pool->worker_count);
+    for (int i = 0; i < pool->worker_count; i++)
+    {
+        struct WorkDeque *deque = &pool->deques[i];
+        if (deque->capacity < share)
+        {
+            int64_t capacity = deque->capacity > 0 ? deque->capacity : 64;
+            while (capacity < share)
+            {
+                capacity *= 2;
+            }
+
+            deque->tasks = (_Atomic size_t*)reallocate(
+                (void*)deque->tasks,
+                (size_t)deque->capacity * sizeof(size_t),
+                (size_t)capacity * sizeof(size_t)
+            );
+            deque->capacity = capacity;
+        }
+
+        atomic_store_explicit(&deque->top, 0, memory_order_relaxed);
+        atomic_store_explicit(&deque->bottom, 0, memory_order_relaxed);
+    }
+
+    pool->function = function;
+    pool->data = data;
+    pool->task_count = task_count;
+    atomic_store_explicit(&pool->remaining_tasks, task_count, memory_order_relaxed);
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->generation++;
+    pool->active_workers = pool->worker_count - 1;
+    pthread_cond_broadcast(&pool->start_condition);
+    pthread_mutex_unlock(&pool->mutex);
+
+    execute_job(pool, 0);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->active_workers > 0)
+    {
+        pthread_cond_wait(&pool->done_condition, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    pthread_mutex_unlock(&pool->run_mutex);
+}
\ No newline at end of file
@@ -0,0 +1,243 @@
+#define MEMORY_TAG MEMORY_TAG_EXPORT
+
+#include <common.h>
+#include <memory.h>
+#include <util.h>
+#include <core/log.h>
+#include <core/profile.h>
+#include <graphics/capture.h>
+
+#include <glad/glad.h>
+
+#include <stdio.h>
+#include <string.h>
+
+static void* encoder_main(void *data)
+{
+    struct FrameCapture *capture = (struct FrameCapture*)data;
+    PROFILE_THREAD("capture encoder");
+
+    pthread_mutex_lock(&capture->mutex);
+    for (;;)
+    {
+        while (capture->job_count == 0 && !capture->stopping)
+        {
+            pthread_cond_wait(&capture->job_condition, &capture->mutex);
+        }
+
+        if (capture->job_count == 0)
+            break;
+
+        struct CaptureJob job = capture->jobs[capture->first_job];
+        capture->first_job = (capture->first_job + 1) % CAPTURE_QUEUE_SIZE;
+        capture->job_count--;
+        capture->encoding = true;
+        pthread_cond_broadcast(&capture->space_condition);
+        pthread_mutex_unlock(&capture->mutex);
+
+        PROFILE_BEGIN("encode_capture");
+        double start = get_monotonic_time();
+        bool saved = write_png(job.path, job.pixels, job.width, job.height, true, &capture->png, capture->pool);
+        PROFILE_END();
+
+        if (saved)
+        {
+            LOG_TRACE("Saved %s in %.1f ms", job.path, 1000.0 * (get_monotonic_time() - start));
+        }
+
+        else
+        {
+            LOG_ERROR("Failed to save capture to %s", job.path);
+        }
+        FREE_ARRAY(job.pixels, uint8_t, (size_t)4 * job.width * job.height);
+
+        pthread_mutex_lock(&capture->mutex);
+        capture->encoding = false;
+        pthread_cond_broadcast(&capture->space_condition);
+    }
+    pthread_mutex_unlock(&capture->mutex);
+
+    return NULL;
+}
+
+bool init_frame_capture(struct FrameCapture *capture, const struct PngOptions *png, struct ThreadPool *pool)
+{
+    memset(capture, 0, sizeof(struct FrameCapture));
+    capture->png = *png;
+    capture->pool = pool;
+
+    pthread_mutex_init(&capture->mutex, NULL);
+    pthread_cond_init(&capture->job_condition, NULL);
+    pthread_cond_init(&capture->space_condition, NULL);
+
+    if (pthread_create(&capture->thread, NULL, encoder_main, capture) != 0)
+    {
+        LOG_ERROR("Failed to start the capture encoder thread!");
+        pthread_cond_destroy(&capture->space_condition);
+        pthread_cond_destroy(&capture->job_condition);
+        pthread_mutex_destroy(&capture->mutex);
+        return false;
+    }
+
+    for (int i = 0; i < CAPTURE_RING_SIZE; i++)
+    {
+        glGenBuffers(1, &capture->slots[i].pbo);
+    }
+
+    return true;
+}
+
+void destroy_frame_capture(struct FrameCapture *capture)
+{
+    flush_frame_capture(capture);
+
+    pthread_mutex_lock(&capture->mutex);
+    capture->stopping = true;
+    pthread_cond_signal(&capture->job_condition);
+    pthread_mutex_unlock(&capture->mutex);
+    pthread_join(capture->thread, NULL);
+
+    for (int i = 0; i < CAPTURE_RING_SIZE; i++)
+    {
+        glDeleteBuffers(1, &capture->slots[i].pbo);
+    }
+
+    pthread_cond_destroy(&capture->space_condition);
+    pthread_cond_destroy(&capture->job_condition);
+    pthread_mutex_destroy(&capture->mutex);
+}
+
+// Copies the oldest read out of its buffer and queues it for encoding.
+// Waits for the GPU only when wait is set.
+static bool retire_oldest(struct FrameCapture *capture, bool wait)
+{
+    struct CaptureSlot *slot = &capture->slots[capture->oldest];
+    GLsync fence = (GLsync)slot->fence;
+
+    GLenum status = glClientWaitSync(fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, 0);
+    while (wait && status == GL_TIMEOUT_EXPIRED)
+    {
+        status = glClientWaitSync(fence, 0, 1000000000);
+    }
+
+    if (status == GL_TIMEOUT_EXPIRED)
+        return false;
+
+    PROFILE_BEGIN("retire_capture");
+    if (status == GL_WAIT_FAILED)
+    {
+        LOG_ERROR("Waiting for capture %s failed", slot->path);
+    }
+
+    glDeleteSync(fence);
+    slot->fence = NULL;
+    capture->oldest = (capture->oldest + 1) % CAPTURE_RING_SIZE;
+    capture->pending--;
+
+    if (status == GL_WAIT_FAILED)
+    {
+        PROFILE_END();
+        return true;
+    }
+
+    size_t size = (size_t)4 * slot->width * slot->height;
+    struct CaptureJob job;
+    job.pixels = ALLOC_ARRAY(uint8_t, size);
+    job.width = slot->width;
+    job.height = slot->height;
+    memcpy(job.path, slot->path, sizeof(job.path));
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    const void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)size, GL_MAP_READ_BIT);
+    if (mapped == NULL || job.pixels == NULL)
+    {
+        if (mapped == NULL)
+        {
+            LOG_ERROR("Failed to map capture buffer for %s", slot->path);
+        }
+
+        else
+        {
+            LOG_ERROR("Out of memory for the %dx%d capture %s, dropping it", job.width, job.height, slot->path);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        FREE_ARRAY(job.pixels, uint8_t, size);
+        PROFILE_END();
+        return true;
+    }
+
+    memcpy(job.pixels, mapped, size);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    pthread_mutex_lock(&capture->mutex);
+    while (capture->job_count == CAPTURE_QUEUE_SIZE)
+    {
+        pthread_cond_wait(&capture->space_condition, &capture->mutex);
+    }
+
+    capture->jobs[(capture->first_job + capture->job_count) % CAPTURE_QUEUE_SIZE] = job;
+    capture->job_count++;
+    pthread_cond_signal(&capture->job_condition);
+    pthread_mutex_unlock(&capture->mutex);
+
+    PROFILE_END();
+    return true;
+}
+
+void request_capture(struct FrameCapture *capture, int width, int height, const char *path)
+{
+    if (capture->pending == CAPTURE_RING_SIZE)
+    {
+        retire_oldest(capture, true);
+    }
+
+    PROFILE_BEGIN("request_capture");
+    int index = (capture->oldest + capture->pending) % CAPTURE_RING_SIZE;
+    struct CaptureSlot *slot = &capture->slots[index];
+
+    size_t size = (size_t)4 * width * height;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    if (size > slot->capacity)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)size, NULL, GL_STREAM_READ);
+        slot->capacity = size;
+    }
+
+    // With a pack buffer bound the read is queued like a draw call and the
+    // pointer is an offset into the buffer.
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot->width = width;
+    slot->height = height;
+    snprintf(slot->path, sizeof(slot->path), "%s", path);
+    capture->pending++;
+    PROFILE_END();
+}
+
+void poll_frame_capture(struct FrameCapture *capture)
+{
+    while (capture->pending > 0 && retire_oldest(capture, false))
+    {
+    }
+}
+
+void flush_frame_capture(struct FrameCapture *capture)
+{
+    while (capture->pending > 0)
+    {
+        retire_oldest(capture, true);
+    }
+
+    pthread_mutex_lock(&capture->mutex);
+    while (capture->job_count > 0 || capture->encoding)
+    {
+        pthread_cond_wait(&capture->space_condition, &capture->mutex);
+    }
+    pthread_mutex_unlock(&capture->mutex);
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include <common.h>
+#include <core/log.h>
+#include <graphics/framebuffer.h>
+
+#include <glad/glad.h>
+
+#include <string.h>
+
+bool create_framebuffer(struct Framebuffer *framebuffer, int width, int height)
+{
+    memset(framebuffer, 0, sizeof(struct Framebuffer));
+
+    int max_size = 0;
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_size);
+    if (width <= 0 || height <= 0 || width > max_size || height > max_size)
+    {
+        LOG_ERROR("Framebuffer size (%d, %d) is outside the supported range (1, %d)", width, height, max_size);
+        return false;
+    }
+
+    framebuffer->width = width;
+    framebuffer->height = height;
+
+    glGenRenderbuffers(1, &framebuffer->color_buffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, framebuffer->color_buffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->fbo);
+    glFramebufferRenderbuffer(
+        GL_FRAMEBUFFER,
+        GL_COLOR_ATTACHMENT0,
+        GL_RENDERBUFFER,
+        framebuffer->color_buffer
+    );
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        LOG_ERROR("Framebuffer is incomplete (0x%x)", status);
+        destroy_framebuffer(framebuffer);
+        return false;
+    }
+
+    return true;
+}
+
+void destroy_framebuffer(struct Framebuffer *framebuffer)
+{
+    glDeleteFramebuffers(1, &framebuffer->fbo);
+    glDeleteRenderbuffers(1, &framebuffer->color_buffer);
+    memset(framebuffer, 0, sizeof(struct Framebuffer));
+}
+
+void bind_framebuffer(const struct Framebuffer *framebuffer)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->fbo);
+    glViewport(0, 0, framebuffer->width, framebuffer->height);
+}
+
+void unbind_framebuffer()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
\ No newline at end of file
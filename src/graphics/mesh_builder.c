@@ -0,0 +1,376 @@
+#define MEMORY_TAG MEMORY_TAG_GEOMETRY
+
+#include <common.h>
+#include <memory.h>
+#include <core/log.h>
+#include <graphics/mesh_builder.h>
+#include <graphics/mesh_optimizer.h>
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+// Rounds to the nearest half float, ties to even. Values too large for a
+// half become infinity; tile coordinates never get there.
+static uint16_t float_to_half(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent >= 31)
+        return sign | 0x7c00;
+
+    uint32_t half;
+    uint32_t rest;
+    uint32_t halfway;
+    if (exponent <= 0)
+    {
+        // Subnormal: the implicit leading bit becomes part of the mantissa.
+        if (exponent < -10)
+            return sign;
+
+        int shift = 14 - exponent;
+        mantissa |= 0x800000;
+        half = mantissa >> shift;
+        rest = mantissa & ((1u << shift) - 1);
+        halfway = 1u << (shift - 1);
+    }
+
+    else
+    {
+        half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+        rest = mantissa & 0x1fff;
+        halfway = 0x1000;
+    }
+
+    // A carry out of the mantissa moves on to the next exponent, as it should.
+    if (rest > halfway || (rest == halfway && (half & 1)))
+    {
+        half++;
+    }
+
+    return sign | (uint16_t)half;
+}
+
+static uint8_t float_to_unorm8(float value)
+{
+    value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+    return (uint8_t)lroundf(value * 255.0f);
+}
+
+// Scale and offset that map the bounds of every vertex onto [-32767, 32767].
+static void get_snorm16_transform(const struct TileMesh *meshes, int mesh_count, float *scale, float *offset)
+{
+    float bounds[4] = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (int i = 0; i < mesh_count; i++)
+    {
+        for (size_t j = 0; j < meshes[i].vertex_count; j++)
+        {
+            const float *vertex = meshes[i].vertices + 6 * j;
+            bounds[0] = vertex[0] < bounds[0] ? vertex[0] : bounds[0];
+            bounds[1] = vertex[1] < bounds[1] ? vertex[1] : bounds[1];
+            bounds[2] = vertex[0] > bounds[2] ? vertex[0] : bounds[2];
+            bounds[3] = vertex[1] > bounds[3] ? vertex[1] : bounds[3];
+        }
+    }
+
+    for (int axis = 0; axis < 2; axis++)
+    {
+        float half_extent = 0.5f * (bounds[axis + 2] - bounds[axis]);
+        offset[axis] = 0.5f * (bounds[axis] + bounds[axis + 2]);
+        scale[axis] = half_extent > 0.0f ? half_extent / 32767.0f : 1.0f;
+    }
+}
+
+// Index of color in the palette, adding it when there is room. Returns -1
+// when the palette is full.
+static int find_palette_color(struct PackedMeshes *packed, const float *color)
+{
+    for (int i = 0; i < packed->palette_size; i++)
+    {
+        const float *entry = packed->palette[i];
+        if (entry[0] == color[0] && entry[1] == color[1] && entry[2] == color[2])
+            return i;
+    }
+
+    if (packed->palette_size == MESH_PALETTE_MAX_COLORS)
+        return -1;
+
+    float *entry = packed->palette[packed->palette_size];
+    entry[0] = color[0];
+    entry[1] = color[1];
+    entry[2] = color[2];
+    entry[3] = 1.0f;
+    return packed->palette_size++;
+}
+
+static bool build_palette(struct PackedMeshes *packed, const struct TileMesh *meshes, int mesh_count)
+{
+    for (int i = 0; i < mesh_count; i++)
+    {
+        for (size_t j = 0; j < meshes[i].vertex_count; j++)
+        {
+            if (find_palette_color(packed, meshes[i].vertices + 6 * j + 3) < 0)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static void encode_vertex(struct PackedMeshes *packed, const float *source, uint8_t *vertex)
+{
+    if (packed->format.position == VERTEX_POSITION_FLOAT)
+    {
+        memcpy(vertex, source, 2 * sizeof(float));
+    }
+
+    else
+    {
+        uint16_t position[2];
+        for (int axis = 0; axis < 2; axis++)
+        {
+            if (packed->format.position == VERTEX_POSITION_HALF)
+            {
+                position[axis] = float_to_half(source[axis]);
+            }
+
+            else
+            {
+                float value = (source[axis] - packed->position_offset[axis]) / packed->position_scale[axis];
+                value = value < -32767.0f ? -32767.0f : (value > 32767.0f ? 32767.0f : value);
+                int16_t snorm = (int16_t)lroundf(value);
+                memcpy(&position[axis], &snorm, sizeof(snorm));
+            }
+        }
+        memcpy(vertex, position, sizeof(position));
+    }
+
+    uint8_t *color = vertex + packed->position_size;
+    if (packed->format.color == VERTEX_COLOR_PALETTE)
+    {
+        uint16_t index = (uint16_t)find_palette_color(packed, source + 3);
+        memcpy(color, &index, sizeof(index));
+    }
+
+    else
+    {
+        color[0] = float_to_unorm8(source[3]);
+        color[1] = float_to_unorm8(source[4]);
+        color[2] = float_to_unorm8(source[5]);
+        color[3] = 255;
+    }
+}
+
+static uint32_t hash_vertex(const uint8_t *vertex, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= vertex[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+// Returns the index of vertex, appending it unless an identical one is
+// already stored. slots is an open-addressed table of stored indices plus
+// one, 0 when empty.
+static uint32_t add_vertex(struct PackedMeshes *packed, uint32_t *slots, size_t slot_mask, const uint8_t *vertex)
+{
+    size_t slot = hash_vertex(vertex, packed->vertex_size) & slot_mask;
+    while (slots[slot] != 0)
+    {
+        uint32_t index = slots[slot] - 1;
+        if (memcmp(packed->vertices + index * packed->vertex_size, vertex, packed->vertex_size) == 0)
+            return index;
+
+        slot = (slot + 1) & slot_mask;
+    }
+
+    uint32_t index = (uint32_t)packed->vertex_count++;
+    memcpy(packed->vertices + index * packed->vertex_size, vertex, packed->vertex_size);
+    slots[slot] = index + 1;
+    return index;
+}
+
+// An earlier mesh whose indices match the count starting at indices + first.
+static bool find_index_range(const struct PackedMeshes *packed, const uint32_t *indices, int mesh, size_t *first)
+{
+    size_t count = packed->mesh_index_count[mesh];
+    for (int i = 0; i < mesh; i++)
+    {
+        if (packed->mesh_index_count[i] == count &&
+            memcmp(indices + packed->first_index[i], indices + *first, count * sizeof(uint32_t)) == 0)
+        {
+            *first = packed->first_index[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool pack_tile_meshes(
+    struct PackedMeshes *packed,
+    const struct TileMesh *meshes,
+    int mesh_count,
+    const struct VertexFormat *format)
+{
+    memset(packed, 0, sizeof(struct PackedMeshes));
+    packed->format = *format;
+    packed->mesh_count = mesh_count;
+
+    size_t source_vertices = 0;
+    size_t source_indices = 0;
+    size_t largest_mesh = 0;
+    for (int i = 0; i < mesh_count; i++)
+    {
+        source_vertices += meshes[i].vertex_count;
+        source_indices += meshes[i].index_count;
+        largest_mesh = meshes[i].vertex_count > largest_mesh ? meshes[i].vertex_count : largest_mesh;
+    }
+
+    if (packed->format.color == VERTEX_COLOR_PALETTE && !build_palette(packed, meshes, mesh_count))
+    {
+        LOG_WARN("Tile meshes use more than %d colours, storing them as unorm8", MESH_PALETTE_MAX_COLORS);
+        packed->format.color = VERTEX_COLOR_UNORM8;
+        packed->palette_size = 0;
+    }
+
+    if (packed->format.position == VERTEX_POSITION_SNORM16)
+    {
+        get_snorm16_transform(meshes, mesh_count, packed->position_scale, packed->position_offset);
+    }
+
+    else
+    {
+        packed->position_scale[0] = packed->position_scale[1] = 1.0f;
+    }
+
+    packed->position_size = packed->format.position == VERTEX_POSITION_FLOAT ? 2 * sizeof(float) : 2 * sizeof(uint16_t);
+    packed->vertex_size = packed->position_size + (packed->format.color == VERTEX_COLOR_PALETTE ? 2 : 4);
+    packed->vertex_capacity = source_vertices;
+    packed->vertices = ALLOC_ARRAY(uint8_t, source_vertices * packed->vertex_size);
+
+    size_t slot_count = 16;
+    while (slot_count < 2 * source_vertices)
+    {
+        slot_count *= 2;
+    }
+
+    uint32_t *slots = ALLOC_ARRAY(uint32_t, slot_count);
+    uint32_t *remap = ALLOC_ARRAY(uint32_t, largest_mesh);
+    uint32_t *indices = ALLOC_ARRAY(uint32_t, source_indices);
+    if (packed->vertices == NULL || slots == NULL || remap == NULL || indices == NULL)
+    {
+        FREE_ARRAY(indices, uint32_t, source_indices);
+        FREE_ARRAY(remap, uint32_t, largest_mesh);
+        FREE_ARRAY(slots, uint32_t, slot_count);
+        destroy_packed_meshes(packed);
+        return false;
+    }
+    memset(slots, 0, slot_count * sizeof(uint32_t));
+
+    double misses_before = 0.0;
+    double misses_after = 0.0;
+    for (int i = 0; i < mesh_count; i++)
+    {
+        for (size_t j = 0; j < meshes[i].vertex_count; j++)
+        {
+            uint8_t vertex[12];
+            encode_vertex(packed, meshes[i].vertices + 6 * j, vertex);
+            remap[j] = add_vertex(packed, slots, slot_count - 1, vertex);
+        }
+
+        size_t first = packed->index_count;
+        for (size_t j = 0; j < meshes[i].index_count; j++)
+        {
+            indices[first + j] = remap[meshes[i].indices[j]];
+        }
+
+        // Reordering is deterministic, so meshes with the same indices still
+        // match afterwards.
+        double triangles = (double)(meshes[i].index_count / 3);
+        misses_before += get_vertex_cache_miss_ratio(indices + first, meshes[i].index_count, VERTEX_CACHE_SIZE) * triangles;
+        optimize_vertex_cache(indices + first, meshes[i].index_count, packed->vertex_count, VERTEX_CACHE_SIZE);
+        misses_after += get_vertex_cache_miss_ratio(indices + first, meshes[i].index_count, VERTEX_CACHE_SIZE) * triangles;
+        packed->overdraw += get_mesh_overdraw(&meshes[i], MESH_OVERDRAW_RESOLUTION) / mesh_count;
+
+        packed->mesh_index_count[i] = meshes[i].index_count;
+        if (!find_index_range(packed, indices, i, &first))
+        {
+            packed->index_count += meshes[i].index_count;
+        }
+        packed->first_index[i] = first;
+    }
+
+    FREE_ARRAY(remap, uint32_t, largest_mesh);
+    FREE_ARRAY(slots, uint32_t, slot_count);
+
+    if (source_indices >= 3)
+    {
+        packed->acmr_before = misses_before / (double)(source_indices / 3);
+        packed->acmr_after = misses_after / (double)(source_indices / 3);
+    }
+
+    packed->index_size = packed->vertex_count <= 65536 ? 2 : 4;
+    packed->index_capacity = packed->index_count;
+    packed->indices = ALLOC_ARRAY(uint8_t, packed->index_count * packed->index_size);
+    if (packed->indices == NULL && packed->index_count > 0)
+    {
+        FREE_ARRAY(indices, uint32_t, source_indices);
+        destroy_packed_meshes(packed);
+        return false;
+    }
+
+    for (size_t i = 0; i < packed->index_count; i++)
+    {
+        if (packed->index_size == 2)
+        {
+            uint16_t index = (uint16_t)indices[i];
+            memcpy(packed->indices + 2 * i, &index, sizeof(index));
+        }
+
+        else
+        {
+            memcpy(packed->indices + 4 * i, &indices[i], sizeof(uint32_t));
+        }
+    }
+    FREE_ARRAY(indices, uint32_t, source_indices);
+
+    LOG_TRACE(
+        "Packed %d tile meshes: %zu of %zu vertices and %zu of %zu indices kept, %zu bytes instead of %zu",
+        mesh_count,
+        packed->vertex_count, source_vertices,
+        packed->index_count, source_indices,
+        packed->vertex_count * packed->vertex_size + packed->index_count * packed->index_size,
+        source_vertices * 6 * sizeof(float) + source_indices * sizeof(unsigned int)
+    );
+    LOG_INFO(
+        "Tile meshes: ACMR %.3f reordered to %.3f for a %d vertex cache, overdraw %.3f",
+        packed->acmr_before, packed->acmr_after, VERTEX_CACHE_SIZE, packed->overdraw
+    );
+    return true;
+}
+
+void destroy_packed_meshes(struct PackedMeshes *packed)
+{
+    if (packed->vertices != NULL)
+    {
+        FREE_ARRAY(packed->vertices, uint8_t, packed->vertex_capacity * packed->vertex_size);
+    }
+
+    if (packed->indices != NULL)
+    {
+        FREE_ARRAY(packed->indices, uint8_t, packed->index_capacity * packed->index_size);
+    }
+
+    packed->vertices = NULL;
+    packed->indices = NULL;
+}
\ No newline at end of file
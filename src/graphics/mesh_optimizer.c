@@ -0,0 +1,276 @@
+#define MEMORY_TAG MEMORY_TAG_GEOMETRY
+
+#include <common.h>
+#include <memory.h>
+#include <graphics/mesh_optimizer.h>
+
+#include <float.h>
+#include <string.h>
+
+struct TipsifyState
+{
+    size_t vertex_count;
+    int cache_size;
+
+    // Triangles using each vertex: adjacency[adjacency_first[v]] onwards,
+    // live_counts[v] of them not yet emitted.
+    uint32_t *adjacency_first;
+    uint32_t *adjacency;
+    uint32_t *live_counts;
+
+    // When each vertex last entered the cache, against the running time.
+    uint32_t *cache_times;
+    uint32_t time;
+
+    // Vertices of the triangles emitted so far, latest on top.
+    uint32_t *dead_ends;
+    size_t dead_end_count;
+    size_t cursor;
+};
+
+// A vertex with triangles left: the latest dead end, or failing that the
+// next one in index order. -1 once every triangle has been emitted.
+static int64_t skip_dead_end(struct TipsifyState *state)
+{
+    while (state->dead_end_count > 0)
+    {
+        uint32_t vertex = state->dead_ends[--state->dead_end_count];
+        if (state->live_counts[vertex] > 0)
+            return vertex;
+    }
+
+    while (state->cursor < state->vertex_count)
+    {
+        if (state->live_counts[state->cursor] > 0)
+            return (int64_t)state->cursor;
+
+        state->cursor++;
+    }
+
+    return -1;
+}
+
+// Of the vertices just used, the one that has been in the cache longest but
+// will still be there after its remaining triangles are emitted. As in the
+// paper, a candidate that would fall out of the cache still beats a dead end
+// as long as it has triangles left.
+static int64_t get_next_vertex(struct TipsifyState *state, const uint32_t *candidates, size_t candidate_count)
+{
+    int64_t next = -1;
+    int64_t best = -1;
+    for (size_t i = 0; i < candidate_count; i++)
+    {
+        uint32_t vertex = candidates[i];
+        if (state->live_counts[vertex] == 0)
+            continue;
+
+        int64_t age = (int64_t)state->time - state->cache_times[vertex];
+        int64_t priority = age + 2 * (int64_t)state->live_counts[vertex] <= state->cache_size ? age : 0;
+        if (priority > best)
+        {
+            best = priority;
+            next = vertex;
+        }
+    }
+
+    return next >= 0 ? next : skip_dead_end(state);
+}
+
+bool optimize_vertex_cache(uint32_t *indices, size_t index_count, size_t vertex_count, int cache_size)
+{
+    size_t triangle_count = index_count / 3;
+    if (triangle_count == 0 || vertex_count == 0)
+        return true;
+
+    struct TipsifyState state = {
+        .vertex_count = vertex_count,
+        .cache_size = cache_size,
+        .adjacency_first = ALLOC_ARRAY(uint32_t, vertex_count + 1),
+        .adjacency = ALLOC_ARRAY(uint32_t, 3 * triangle_count),
+        .live_counts = ALLOC_ARRAY(uint32_t, vertex_count),
+        .cache_times = ALLOC_ARRAY(uint32_t, vertex_count),
+        .time = (uint32_t)cache_size + 1,
+        .dead_ends = ALLOC_ARRAY(uint32_t, 3 * triangle_count)
+    };
+    uint32_t *output = ALLOC_ARRAY(uint32_t, 3 * triangle_count);
+    bool *emitted = ALLOC_ARRAY(bool, triangle_count);
+
+    bool allocated = state.adjacency_first != NULL && state.adjacency != NULL && state.live_counts != NULL &&
+        state.cache_times != NULL && state.dead_ends != NULL && output != NULL && emitted != NULL;
+    if (allocated)
+    {
+        memset(state.live_counts, 0, vertex_count * sizeof(uint32_t));
+        memset(state.cache_times, 0, vertex_count * sizeof(uint32_t));
+        memset(emitted, 0, triangle_count * sizeof(bool));
+
+        for (size_t i = 0; i < 3 * triangle_count; i++)
+        {
+            state.live_counts[indices[i]]++;
+        }
+
+        state.adjacency_first[0] = 0;
+        for (size_t v = 0; v < vertex_count; v++)
+        {
+            state.adjacency_first[v + 1] = state.adjacency_first[v] + state.live_counts[v];
+        }
+
+        // cache_times doubles as the fill position while building adjacency.
+        for (size_t i = 0; i < 3 * triangle_count; i++)
+        {
+            uint32_t vertex = indices[i];
+            state.adjacency[state.adjacency_first[vertex] + state.cache_times[vertex]++] = (uint32_t)(i / 3);
+        }
+        memset(state.cache_times, 0, vertex_count * sizeof(uint32_t));
+
+        size_t written = 0;
+        int64_t fan = skip_dead_end(&state);
+        while (fan >= 0)
+        {
+            // The vertices of the triangles emitted around fan, read back
+            // from the output, are the candidates for the next one.
+            size_t first = written;
+
+            for (uint32_t i = state.adjacency_first[fan]; i < state.adjacency_first[fan + 1]; i++)
+            {
+                uint32_t triangle = state.adjacency[i];
+                if (emitted[triangle])
+                    continue;
+
+                for (int k = 0; k < 3; k++)
+                {
+                    uint32_t vertex = indices[3 * triangle + k];
+                    output[written++] = vertex;
+                    state.dead_ends[state.dead_end_count++] = vertex;
+                    state.live_counts[vertex]--;
+                    if (state.time - state.cache_times[vertex] > (uint32_t)cache_size)
+                    {
+                        state.cache_times[vertex] = state.time++;
+                    }
+                }
+                emitted[triangle] = true;
+            }
+
+            fan = get_next_vertex(&state, output + first, written - first);
+        }
+
+        memcpy(indices, output, 3 * triangle_count * sizeof(uint32_t));
+    }
+
+    FREE_ARRAY(emitted, bool, triangle_count);
+    FREE_ARRAY(output, uint32_t, 3 * triangle_count);
+    FREE_ARRAY(state.dead_ends, uint32_t, 3 * triangle_count);
+    FREE_ARRAY(state.cache_times, uint32_t, vertex_count);
+    FREE_ARRAY(state.live_counts, uint32_t, vertex_count);
+    FREE_ARRAY(state.adjacency, uint32_t, 3 * triangle_count);
+    FREE_ARRAY(state.adjacency_first, uint32_t, vertex_count + 1);
+    return allocated;
+}
+
+double get_vertex_cache_miss_ratio(const uint32_t *indices, size_t index_count, int cache_size)
+{
+    size_t triangle_count = index_count / 3;
+    if (triangle_count == 0)
+        return 0.0;
+
+    // Small enough to search; the oldest entry is replaced on a miss.
+    uint32_t cache[64];
+    int capacity = cache_size < 64 ? cache_size : 64;
+    int used = 0;
+    int oldest = 0;
+    size_t misses = 0;
+
+    for (size_t i = 0; i < 3 * triangle_count; i++)
+    {
+        bool hit = false;
+        for (int j = 0; j < used && !hit; j++)
+        {
+            hit = cache[j] == indices[i];
+        }
+
+        if (hit)
+            continue;
+
+        misses++;
+        if (used < capacity)
+        {
+            cache[used++] = indices[i];
+        }
+
+        else
+        {
+            cache[oldest] = indices[i];
+            oldest = (oldest + 1) % capacity;
+        }
+    }
+
+    return (double)misses / (double)triangle_count;
+}
+
+static float edge_function(const float *a, const float *b, float x, float y)
+{
+    return (b[0] - a[0]) * (y - a[1]) - (b[1] - a[1]) * (x - a[0]);
+}
+
+double get_mesh_overdraw(const struct TileMesh *mesh, int resolution)
+{
+    float bounds[4] = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (size_t i = 0; i < mesh->vertex_count; i++)
+    {
+        const float *vertex = mesh->vertices + 6 * i;
+        bounds[0] = vertex[0] < bounds[0] ? vertex[0] : bounds[0];
+        bounds[1] = vertex[1] < bounds[1] ? vertex[1] : bounds[1];
+        bounds[2] = vertex[0] > bounds[2] ? vertex[0] : bounds[2];
+        bounds[3] = vertex[1] > bounds[3] ? vertex[1] : bounds[3];
+    }
+
+    bool *drawn = ALLOC_ARRAY(bool, (size_t)resolution * resolution);
+    if (drawn == NULL || bounds[0] >= bounds[2] || bounds[1] >= bounds[3])
+    {
+        FREE_ARRAY(drawn, bool, (size_t)resolution * resolution);
+        return 0.0;
+    }
+    memset(drawn, 0, (size_t)resolution * resolution * sizeof(bool));
+
+    // Samples sit off the pixel centres so they never land exactly on the
+    // edges the meshes' round coordinates produce, where both neighbouring
+    // triangles would count them.
+    float step_x = (bounds[2] - bounds[0]) / resolution;
+    float step_y = (bounds[3] - bounds[1]) / resolution;
+    size_t fragments = 0;
+
+    for (size_t t = 0; t + 2 < mesh->index_count; t += 3)
+    {
+        const float *a = mesh->vertices + 6 * mesh->indices[t];
+        const float *b = mesh->vertices + 6 * mesh->indices[t + 1];
+        const float *c = mesh->vertices + 6 * mesh->indices[t + 2];
+        float area = edge_function(a, b, c[0], c[1]);
+        if (area == 0.0f)
+            continue;
+
+        for (int y = 0; y < resolution; y++)
+        {
+            float sample_y = bounds[1] + (y + 0.4142f) * step_y;
+            for (int x = 0; x < resolution; x++)
+            {
+                float sample_x = bounds[0] + (x + 0.3183f) * step_x;
+                float w0 = edge_function(b, c, sample_x, sample_y) * area;
+                float w1 = edge_function(c, a, sample_x, sample_y) * area;
+                float w2 = edge_function(a, b, sample_x, sample_y) * area;
+                if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f)
+                {
+                    drawn[(size_t)y * resolution + x] = true;
+                    fragments++;
+                }
+            }
+        }
+    }
+
+    size_t covered = 0;
+    for (size_t i = 0; i < (size_t)resolution * resolution; i++)
+    {
+        covered += drawn[i];
+    }
+
+    FREE_ARRAY(drawn, bool, (size_t)resolution * resolution);
+    return covered > 0 ? (double)fragments / (double)covered : 0.0;
+}
\ No newline at end of file
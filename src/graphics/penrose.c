@@ -0,0 +1,405 @@
+#define MEMORY_TAG MEMORY_TAG_GEOMETRY
+
+#include <common.h>
+#include <memory.h>
+#include <core/log.h>
+#include <graphics/penrose.h>
+
+#include <math.h>
+#include <string.h>
+
+#define GOLDEN_RATIO 1.6180339887498949
+
+// Width of the border along the rhombus edges, relative to the edge length.
+#define PENROSE_BORDER 0.06
+
+// Apex angle at A of the thin and thick halves.
+static const double apex_angles[2] = { M_PI / 5.0, 3.0 * M_PI / 5.0 };
+
+struct PenroseVisit
+{
+    struct PenroseTiling *tiling;
+    double view[4];
+    double retain[4];
+    int leaf_level;
+    struct PenroseStats stats;
+
+    // Thick halves, kept apart until the thin ones are all in
+    // tiling->instances.
+    struct Arena *scratch;
+    struct TileInstance *thick_instances;
+    size_t thick_capacity;
+};
+
+static void write_vertex(float *vertex, double x, double y, const float *color)
+{
+    vertex[0] = (float)x;
+    vertex[1] = (float)y;
+    vertex[2] = 0.0f;
+    vertex[3] = color[0];
+    vertex[4] = color[1];
+    vertex[5] = color[2];
+}
+
+static const unsigned int half_rhombus_indices[] = {
+    // Border.
+    0, 1, 4,
+    0, 4, 3,
+    0, 3, 5,
+    0, 5, 2,
+
+    // Fill.
+    6, 7, 8
+};
+
+// A unit half-rhombus with A at the origin, B at (1, 0) and C at the apex
+// angle. AB and AC get a border band; the fill runs up to the diagonal BC so
+// the two halves of a rhombus join without a seam.
+static void build_half_rhombus(float *vertices, double angle, const float *fill_color)
+{
+    static const float border_color[3] = { 1.0f, 1.0f, 1.0f };
+
+    double w = PENROSE_BORDER;
+    double c = cos(angle);
+    double s = sin(angle);
+
+    // Inset A sits where the offsets of AB and AC cross; inset B and C where
+    // they meet the diagonal.
+    double inset_a[2] = { w * (1.0 + c) / s, w };
+    double t_b = w / s;
+    double t_c = 1.0 - w / s;
+    double inset_b[2] = { 1.0 + t_b * (c - 1.0), t_b * s };
+    double inset_c[2] = { 1.0 + t_c * (c - 1.0), t_c * s };
+
+    write_vertex(vertices + 0,  0.0, 0.0, border_color);
+    write_vertex(vertices + 6,  1.0, 0.0, border_color);
+    write_vertex(vertices + 12, c, s, border_color);
+    write_vertex(vertices + 18, inset_a[0], inset_a[1], border_color);
+    write_vertex(vertices + 24, inset_b[0], inset_b[1], border_color);
+    write_vertex(vertices + 30, inset_c[0], inset_c[1], border_color);
+    write_vertex(vertices + 36, inset_a[0], inset_a[1], fill_color);
+    write_vertex(vertices + 42, inset_b[0], inset_b[1], fill_color);
+    write_vertex(vertices + 48, inset_c[0], inset_c[1], fill_color);
+}
+
+static void set_triangle(struct PenroseTriangle *triangle, bool thick, const double *a, const double *b, const double *c)
+{
+    triangle->thick = thick;
+    triangle->child_count = 0;
+    memcpy(triangle->vertices[0], a, 2 * sizeof(double));
+    memcpy(triangle->vertices[1], b, 2 * sizeof(double));
+    memcpy(triangle->vertices[2], c, 2 * sizeof(double));
+}
+
+bool init_penrose_tiling(struct PenroseTiling *tiling, int depth, float tile_size)
+{
+    memset(tiling, 0, sizeof(struct PenroseTiling));
+    if (depth < 0 || depth > PENROSE_MAX_DEPTH)
+    {
+        LOG_ERROR("Unsupported Penrose depth: %d", depth);
+        return false;
+    }
+
+    tiling->depth = depth;
+    tiling->min_tile_pixels = 6.0f;
+    tiling->edge_lengths[depth] = tile_size;
+    for (int level = depth - 1; level >= 0; level--)
+    {
+        tiling->edge_lengths[level] = tiling->edge_lengths[level + 1] * GOLDEN_RATIO;
+    }
+
+    tiling->descendant_counts[0][0] = 1;
+    tiling->descendant_counts[1][0] = 1;
+    for (int n = 1; n <= PENROSE_MAX_DEPTH; n++)
+    {
+        uint64_t thin = tiling->descendant_counts[0][n - 1];
+        uint64_t thick = tiling->descendant_counts[1][n - 1];
+        tiling->descendant_counts[0][n] = thin + thick;
+        tiling->descendant_counts[1][n] = thin + 2 * thick;
+    }
+
+    init_block_pool(&tiling->pool, sizeof(struct PenroseTriangle), 0, MEMORY_TAG_GEOMETRY);
+
+    // The sun: ten thin halves around the origin, alternately mirrored so
+    // neighbours share their edges.
+    double radius = tiling->edge_lengths[0];
+    double origin[2] = { 0.0, 0.0 };
+    for (int i = 0; i < 10; i++)
+    {
+        double b[2] = { radius * cos((2 * i - 1) * M_PI / 10.0), radius * sin((2 * i - 1) * M_PI / 10.0) };
+        double c[2] = { radius * cos((2 * i + 1) * M_PI / 10.0), radius * sin((2 * i + 1) * M_PI / 10.0) };
+        if (i % 2 == 0)
+        {
+            set_triangle(&tiling->roots[i], false, origin, c, b);
+        }
+
+        else
+        {
+            set_triangle(&tiling->roots[i], false, origin, b, c);
+        }
+    }
+
+    static const float fill_colors[PENROSE_MESH_COUNT][3] = {
+        { 0.9f, 0.9f, 0.2f },
+        { 0.2f, 0.5f, 0.8f }
+    };
+
+    for (int i = 0; i < PENROSE_MESH_COUNT; i++)
+    {
+        build_half_rhombus(tiling->vertex_data[i], apex_angles[i], fill_colors[i]);
+        tiling->meshes[i] = (struct TileMesh){
+            tiling->vertex_data[i], 9,
+            half_rhombus_indices, sizeof(half_rhombus_indices) / sizeof(unsigned int)
+        };
+    }
+
+    return true;
+}
+
+static void free_children(struct PenroseVisit *visit, struct PenroseTriangle *triangle)
+{
+    for (int i = 0; i < triangle->child_count; i++)
+    {
+        free_children(visit, triangle->children[i]);
+        POOL_FREE(&visit->tiling->pool, triangle->children[i]);
+        visit->stats.freed++;
+    }
+
+    triangle->child_count = 0;
+}
+
+void destroy_penrose_tiling(struct PenroseTiling *tiling)
+{
+    destroy_block_pool(&tiling->pool);
+    FREE_ARRAY(tiling->instances, struct TileInstance, tiling->instance_capacity);
+    memset(tiling, 0, sizeof(struct PenroseTiling));
+}
+
+// Robinson triangle substitution: a thin half splits into a thin and a
+// thick half, a thick half into two thick and one thin, each 1/phi the size.
+static bool subdivide(struct PenroseVisit *visit, struct PenroseTriangle *triangle)
+{
+    const double *a = triangle->vertices[0];
+    const double *b = triangle->vertices[1];
+    const double *c = triangle->vertices[2];
+    int count = triangle->thick ? 3 : 2;
+
+    for (int i = 0; i < count; i++)
+    {
+        triangle->children[i] = POOL_ALLOC(&visit->tiling->pool, struct PenroseTriangle);
+        if (triangle->children[i] == NULL)
+        {
+            triangle->child_count = i;
+            free_children(visit, triangle);
+            return false;
+        }
+    }
+
+    if (!triangle->thick)
+    {
+        double p[2] = { a[0] + (b[0] - a[0]) / GOLDEN_RATIO, a[1] + (b[1] - a[1]) / GOLDEN_RATIO };
+        set_triangle(triangle->children[0], false, c, p, b);
+        set_triangle(triangle->children[1], true, p, c, a);
+    }
+
+    else
+    {
+        double q[2] = { b[0] + (a[0] - b[0]) / GOLDEN_RATIO, b[1] + (a[1] - b[1]) / GOLDEN_RATIO };
+        double r[2] = { b[0] + (c[0] - b[0]) / GOLDEN_RATIO, b[1] + (c[1] - b[1]) / GOLDEN_RATIO };
+        set_triangle(triangle->children[0], true, r, c, a);
+        set_triangle(triangle->children[1], true, q, r, b);
+        set_triangle(triangle->children[2], false, r, q, a);
+    }
+
+    triangle->child_count = count;
+    visit->stats.created += count;
+    return true;
+}
+
+static bool overlaps(const struct PenroseTriangle *triangle, const double *region)
+{
+    const double (*v)[2] = triangle->vertices;
+    return fmax(fmax(v[0][0], v[1][0]), v[2][0]) >= region[0] &&
+           fmin(fmin(v[0][0], v[1][0]), v[2][0]) <= region[2] &&
+           fmax(fmax(v[0][1], v[1][1]), v[2][1]) >= region[1] &&
+           fmin(fmin(v[0][1], v[1][1]), v[2][1]) <= region[3];
+}
+
+static bool reserve_instances(struct TileInstance **instances, size_t *capacity, size_t count)
+{
+    if (count <= *capacity)
+        return true;
+
+    size_t new_capacity = *capacity > 0 ? 2 * *capacity : 1024;
+    new_capacity = new_capacity >= count ? new_capacity : count;
+
+    struct TileInstance *grown = (struct TileInstance*)reallocate(
+        *instances,
+        *capacity * sizeof(struct TileInstance),
+        new_capacity * sizeof(struct TileInstance)
+    );
+    if (grown == NULL)
+        return false;
+
+    *instances = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+// reserve_instances for the thick halves. Outgrown arrays stay in the
+// arena until the update rewinds it.
+static bool reserve_thick_instances(struct PenroseVisit *visit, size_t count)
+{
+    if (count <= visit->thick_capacity)
+        return true;
+
+    size_t new_capacity = visit->thick_capacity > 0 ? 2 * visit->thick_capacity : 1024;
+    new_capacity = new_capacity >= count ? new_capacity : count;
+
+    struct TileInstance *grown = ARENA_ALLOC_ARRAY(visit->scratch, struct TileInstance, new_capacity);
+    if (grown == NULL)
+        return false;
+
+    if (visit->thick_instances != NULL)
+    {
+        memcpy(grown, visit->thick_instances, visit->thick_capacity * sizeof(struct TileInstance));
+    }
+
+    visit->thick_instances = grown;
+    visit->thick_capacity = new_capacity;
+    return true;
+}
+
+// The similarity taking the unit half-rhombus onto the triangle.
+static void emit_triangle(struct PenroseVisit *visit, const struct PenroseTriangle *triangle)
+{
+    struct PenroseTiling *tiling = visit->tiling;
+    int mesh = triangle->thick ? 1 : 0;
+    bool reserved = triangle->thick
+        ? reserve_thick_instances(visit, tiling->counts[1] + 1)
+        : reserve_instances(&tiling->instances, &tiling->instance_capacity, tiling->counts[0] + 1);
+    if (!reserved)
+        return;
+
+    struct TileInstance *instances = triangle->thick ? visit->thick_instances : tiling->instances;
+
+    const double (*v)[2] = triangle->vertices;
+    double angle = apex_angles[mesh];
+    double ab[2] = { v[1][0] - v[0][0], v[1][1] - v[0][1] };
+    double ac[2] = { v[2][0] - v[0][0], v[2][1] - v[0][1] };
+    double cotangent = cos(angle) / sin(angle);
+    double cosecant = 1.0 / sin(angle);
+
+    instances[tiling->counts[mesh]++] = (struct TileInstance){
+        .linear = {
+            (float)ab[0], (float)ab[1],
+            (float)(ac[0] * cosecant - ab[0] * cotangent),
+            (float)(ac[1] * cosecant - ab[1] * cotangent)
+        },
+        .offset = { (float)v[0][0], (float)v[0][1] }
+    };
+}
+
+static void visit_triangle(struct PenroseVisit *visit, struct PenroseTriangle *triangle, int level)
+{
+    struct PenroseTiling *tiling = visit->tiling;
+    visit->stats.visited++;
+
+    if (!overlaps(triangle, visit->view))
+    {
+        visit->stats.culled += tiling->descendant_counts[triangle->thick][visit->leaf_level - level];
+        if (!overlaps(triangle, visit->retain))
+        {
+            free_children(visit, triangle);
+        }
+
+        return;
+    }
+
+    if (level == visit->leaf_level)
+    {
+        free_children(visit, triangle);
+        emit_triangle(visit, triangle);
+        return;
+    }
+
+    if (triangle->child_count == 0 && !subdivide(visit, triangle))
+    {
+        emit_triangle(visit, triangle);
+        return;
+    }
+
+    for (int i = 0; i < triangle->child_count; i++)
+    {
+        visit_triangle(visit, triangle->children[i], level + 1);
+    }
+}
+
+void update_penrose_tiling(
+    struct PenroseTiling *tiling,
+    const float *region,
+    float pixels_per_unit,
+    struct Arena *scratch,
+    struct PenroseStats *stats)
+{
+    struct PenroseVisit visit;
+    memset(&visit, 0, sizeof(struct PenroseVisit));
+    visit.tiling = tiling;
+    visit.scratch = scratch;
+
+    // Finer levels are dropped once they are too small to see.
+    while (visit.leaf_level < tiling->depth &&
+           tiling->edge_lengths[visit.leaf_level + 1] * pixels_per_unit >= tiling->min_tile_pixels)
+    {
+        visit.leaf_level++;
+    }
+
+    // Branches are kept within half a view of the visible region, so small
+    // pans back and forth don't rebuild them.
+    double margin_x = 0.5 * (region[2] - region[0]);
+    double margin_y = 0.5 * (region[3] - region[1]);
+    for (int i = 0; i < 4; i++)
+    {
+        visit.view[i] = region[i];
+    }
+    visit.retain[0] = region[0] - margin_x;
+    visit.retain[1] = region[1] - margin_y;
+    visit.retain[2] = region[2] + margin_x;
+    visit.retain[3] = region[3] + margin_y;
+
+    // Sized for as many thick halves as last time, which a small pan or
+    // zoom rarely changes.
+    struct ArenaMark mark = get_arena_mark(scratch);
+    reserve_thick_instances(&visit, tiling->counts[1]);
+
+    tiling->counts[0] = 0;
+    tiling->counts[1] = 0;
+    for (int i = 0; i < 10; i++)
+    {
+        visit_triangle(&visit, &tiling->roots[i], 0);
+    }
+
+    // Thick halves go after the thin ones in the same array.
+    size_t total = tiling->counts[0] + tiling->counts[1];
+    if (!reserve_instances(&tiling->instances, &tiling->instance_capacity, total))
+    {
+        tiling->counts[1] = 0;
+    }
+
+    else
+    {
+        memcpy(
+            tiling->instances + tiling->counts[0],
+            visit.thick_instances,
+            tiling->counts[1] * sizeof(struct TileInstance)
+        );
+    }
+    rewind_arena(scratch, mark);
+
+    if (stats != NULL)
+    {
+        *stats = visit.stats;
+        stats->live = tiling->pool.live_count;
+        stats->tiles = tiling->counts[0] + tiling->counts[1];
+    }
+}
\ No newline at end of file
@@ -0,0 +1,1347 @@
+#define MEMORY_TAG MEMORY_TAG_EXPORT
+
+#include <common.h>
+#include <memory.h>
+#include <core/log.h>
+#include <core/profile.h>
+#include <graphics/png.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PNG_BYTES_PER_PIXEL 4
+
+// Bands are sized so each holds about this much filtered data: large enough
+// that the per-band flush costs nothing measurable, small enough to keep
+// every worker busy on big exports.
+#define PNG_BAND_BYTES (1 << 20)
+
+#define WINDOW_SIZE  32768
+#define WINDOW_MASK  (WINDOW_SIZE - 1)
+#define HASH_BITS    15
+#define HASH_SIZE    (1 << HASH_BITS)
+#define MIN_MATCH    3
+#define MAX_MATCH    258
+
+// Length 3 matches further away than this cost more than three literals.
+#define TOO_FAR      4096
+
+#define BLOCK_TOKENS (1 << 15)
+#define MAX_STORED   65535
+
+#define LITERAL_CODES  286
+#define DISTANCE_CODES 30
+#define LENGTH_CODES   19
+#define MAX_CODE_BITS  15
+#define MAX_LENGTH_CODE_BITS 7
+
+#define ADLER_BASE 65521u
+
+// Tokens are literals, or matches with the high bit set.
+#define MATCH_FLAG 0x80000000u
+
+struct CompressionLevel
+{
+    // Chains are searched a quarter as deep once a match this long is known.
+    int good_length;
+    int max_chain;
+    int nice_length;
+    int lazy_limit;
+};
+
+// Same trade-offs as zlib's levels; lazy_limit 0 means greedy matching.
+static const struct CompressionLevel compression_levels[10] = {
+    {  0,    0,   0,   0 },
+    {  4,    4,   8,   0 },
+    {  4,    8,  16,   0 },
+    {  4,   32,  32,   0 },
+    {  4,   16,  16,   4 },
+    {  8,   32,  32,  16 },
+    {  8,  128, 128,  16 },
+    {  8,  256, 128,  32 },
+    { 32, 1024, 258, 128 },
+    { 32, 4096, 258, 258 }
+};
+
+static const uint16_t length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t distance_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t distance_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static const uint8_t length_code_order[LENGTH_CODES] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+static const char *png_filter_names[] = {
+    "none", "sub", "up", "average", "paeth", "adaptive"
+};
+
+// Lookup tables built once: the length code for every match length, the
+// distance code for every distance and the CRC-32 table.
+static uint8_t length_code_lookup[MAX_MATCH + 1];
+static uint8_t distance_code_lookup[WINDOW_SIZE + 1];
+static uint32_t crc_table[256];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void init_tables()
+{
+    for (int code = 0; code < 29; code++)
+    {
+        int last = code == 28 ? MAX_MATCH : length_base[code] + (1 << length_extra[code]) - 1;
+        for (int length = length_base[code]; length <= last; length++)
+        {
+            length_code_lookup[length] = (uint8_t)code;
+        }
+    }
+
+    // Length 258 has its own code even though code 27 could express it.
+    length_code_lookup[MAX_MATCH] = 28;
+
+    for (int code = 0; code < 30; code++)
+    {
+        int last = distance_base[code] + (1 << distance_extra[code]) - 1;
+        for (int distance = distance_base[code]; distance <= last && distance <= WINDOW_SIZE; distance++)
+        {
+            distance_code_lookup[distance] = (uint8_t)code;
+        }
+    }
+
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++)
+        {
+            crc = crc & 1 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+        }
+        crc_table[i] = crc;
+    }
+}
+
+void get_default_png_options(struct PngOptions *options)
+{
+    options->level = PNG_DEFAULT_LEVEL;
+    options->filter = PNG_FILTER_ADAPTIVE;
+}
+
+bool parse_png_filter(const char *name, enum PngFilter *filter)
+{
+    for (int i = 0; i <= PNG_FILTER_ADAPTIVE; i++)
+    {
+        if (strcmp(name, png_filter_names[i]) == 0)
+        {
+            *filter = (enum PngFilter)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static uint32_t update_crc(uint32_t crc, const uint8_t *data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+static uint32_t update_adler(uint32_t adler, const uint8_t *data, size_t size)
+{
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+
+    while (size > 0)
+    {
+        // The largest run that cannot overflow 32 bits before the modulo.
+        size_t run = size < 5552 ? size : 5552;
+        size -= run;
+
+        for (size_t i = 0; i < run; i++)
+        {
+            a += *data++;
+            b += a;
+        }
+
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+    }
+
+    return a | (b << 16);
+}
+
+// Adler-32 of the concatenation of two blocks, from the checksum of each
+// and the length of the second.
+static uint32_t combine_adler(uint32_t first, uint32_t second, size_t second_size)
+{
+    uint32_t remainder = (uint32_t)(second_size % ADLER_BASE);
+    uint32_t a = first & 0xFFFF;
+    uint32_t b = (uint32_t)(((uint64_t)remainder * a) % ADLER_BASE);
+
+    a += (second & 0xFFFF) + ADLER_BASE - 1;
+    b += (first >> 16) + (second >> 16) + ADLER_BASE - remainder;
+
+    if (a >= ADLER_BASE)
+        a -= ADLER_BASE;
+    if (a >= ADLER_BASE)
+        a -= ADLER_BASE;
+    if (b >= 2 * ADLER_BASE)
+        b -= 2 * ADLER_BASE;
+    if (b >= ADLER_BASE)
+        b -= ADLER_BASE;
+
+    return a | (b << 16);
+}
+
+static uint8_t paeth_predictor(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a);
+    int pb = abs(p - b);
+    int pc = abs(p - c);
+
+    if (pa <= pb && pa <= pc)
+        return (uint8_t)a;
+    if (pb <= pc)
+        return (uint8_t)b;
+    return (uint8_t)c;
+}
+
+// Filters one row into output, which receives size bytes. previous is NULL
+// for the first row of the image, which filters against zeros.
+static void filter_row(
+    enum PngFilter filter,
+    const uint8_t *row,
+    const uint8_t *previous,
+    uint8_t *output,
+    size_t size)
+{
+    const size_t bpp = PNG_BYTES_PER_PIXEL;
+
+    if (previous == NULL)
+    {
+        // Up is None and Paeth is Sub without a previous row.
+        filter = filter == PNG_FILTER_UP ? PNG_FILTER_NONE : filter == PNG_FILTER_PAETH ? PNG_FILTER_SUB : filter;
+        if (filter == PNG_FILTER_AVERAGE)
+        {
+            for (size_t i = 0; i < size; i++)
+            {
+                output[i] = (uint8_t)(row[i] - (i >= bpp ? row[i - bpp] >> 1 : 0));
+            }
+            return;
+        }
+    }
+
+    switch (filter)
+    {
+        case PNG_FILTER_SUB:
+            memcpy(output, row, bpp);
+            for (size_t i = bpp; i < size; i++)
+            {
+                output[i] = (uint8_t)(row[i] - row[i - bpp]);
+            }
+            break;
+
+        case PNG_FILTER_UP:
+            for (size_t i = 0; i < size; i++)
+            {
+                output[i] = (uint8_t)(row[i] - previous[i]);
+            }
+            break;
+
+        case PNG_FILTER_AVERAGE:
+            for (size_t i = 0; i < bpp; i++)
+            {
+                output[i] = (uint8_t)(row[i] - (previous[i] >> 1));
+            }
+            for (size_t i = bpp; i < size; i++)
+            {
+                output[i] = (uint8_t)(row[i] - ((row[i - bpp] + previous[i]) >> 1));
+            }
+            break;
+
+        case PNG_FILTER_PAETH:
+            for (size_t i = 0; i < bpp; i++)
+            {
+                output[i] = (uint8_t)(row[i] - previous[i]);
+            }
+            for (size_t i = bpp; i < size; i++)
+            {
+                output[i] = (uint8_t)(row[i] - paeth_predictor(row[i - bpp], previous[i], previous[i - bpp]));
+            }
+            break;
+
+        default:
+            memcpy(output, row, size);
+            break;
+    }
+}
+
+static size_t get_filter_cost(const uint8_t *filtered, size_t size)
+{
+    size_t cost = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        cost += (size_t)abs((int)(int8_t)filtered[i]);
+    }
+
+    return cost;
+}
+
+struct BitWriter
+{
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    uint64_t bits;
+    int bit_count;
+};
+
+static void reserve_bytes(struct BitWriter *writer, size_t count)
+{
+    if (writer->size + count <= writer->capacity)
+        return;
+
+    size_t capacity = writer->capacity < 4096 ? 4096 : writer->capacity;
+    while (capacity < writer->size + count)
+    {
+        capacity *= 2;
+    }
+
+    writer->data = (uint8_t*)reallocate(writer->data, writer->capacity, capacity);
+    writer->capacity = capacity;
+}
+
+static void write_bits(struct BitWriter *writer, uint32_t value, int count)
+{
+    writer->bits |= (uint64_t)value << writer->bit_count;
+    writer->bit_count += count;
+
+    if (writer->bit_count >= 32)
+    {
+        reserve_bytes(writer, 4);
+        for (int i = 0; i < 4; i++)
+        {
+            writer->data[writer->size++] = (uint8_t)(writer->bits >> (8 * i));
+        }
+        writer->bits >>= 32;
+        writer->bit_count -= 32;
+    }
+}
+
+// Pads with zero bits up to the next byte boundary.
+static void align_bits(struct BitWriter *writer)
+{
+    reserve_bytes(writer, 8);
+    while (writer->bit_count > 0)
+    {
+        writer->data[writer->size++] = (uint8_t)writer->bits;
+        writer->bits >>= 8;
+        writer->bit_count = writer->bit_count > 8 ? writer->bit_count - 8 : 0;
+    }
+    writer->bits = 0;
+}
+
+static void write_bytes(struct BitWriter *writer, const uint8_t *data, size_t size)
+{
+    reserve_bytes(writer, size);
+    memcpy(writer->data + writer->size, data, size);
+    writer->size += size;
+}
+
+// Moffat and Katajainen's in-place minimum redundancy code: frequencies
+// sorted in ascending order go in, code lengths come out.
+static void compute_minimum_redundancy(int *a, int n)
+{
+    int root = 0;
+    int leaf = 2;
+
+    a[0] += a[1];
+    for (int next = 1; next < n - 1; next++)
+    {
+        if (leaf >= n || a[root] < a[leaf])
+        {
+            a[next] = a[root];
+            a[root++] = next;
+        }
+
+        else
+        {
+            a[next] = a[leaf++];
+        }
+
+        if (leaf >= n || (root < next && a[root] < a[leaf]))
+        {
+            a[next] += a[root];
+            a[root++] = next;
+        }
+
+        else
+        {
+            a[next] += a[leaf++];
+        }
+    }
+
+    a[n - 2] = 0;
+    for (int next = n - 3; next >= 0; next--)
+    {
+        a[next] = a[a[next]] + 1;
+    }
+
+    int available = 1;
+    int used = 0;
+    int depth = 0;
+    root = n - 2;
+    int next = n - 1;
+    while (available > 0)
+    {
+        while (root >= 0 && a[root] == depth)
+        {
+            used++;
+            root--;
+        }
+
+        while (available > used)
+        {
+            a[next--] = depth;
+            available--;
+        }
+
+        available = 2 * used;
+        depth++;
+        used = 0;
+    }
+}
+
+struct SymbolFrequency
+{
+    int frequency;
+    int symbol;
+};
+
+static int compare_frequencies(const void *a, const void *b)
+{
+    const struct SymbolFrequency *x = (const struct SymbolFrequency*)a;
+    const struct SymbolFrequency *y = (const struct SymbolFrequency*)b;
+
+    if (x->frequency != y->frequency)
+        return x->frequency < y->frequency ? -1 : 1;
+    return x->symbol - y->symbol;
+}
+
+// Builds code lengths of at most max_bits for count symbols. Unused
+// symbols get length 0.
+static void build_code_lengths(const int *frequencies, int count, int max_bits, uint8_t *lengths)
+{
+    struct SymbolFrequency symbols[LITERAL_CODES];
+    int used = 0;
+
+    memset(lengths, 0, (size_t)count);
+    for (int i = 0; i < count; i++)
+    {
+        if (frequencies[i] > 0)
+        {
+            symbols[used++] = (struct SymbolFrequency){ frequencies[i], i };
+        }
+    }
+
+    if (used == 0)
+        return;
+
+    // Decoders reject incomplete codes, so a lone symbol gets a partner.
+    if (used == 1)
+    {
+        lengths[symbols[0].symbol] = 1;
+        lengths[symbols[0].symbol == 0 ? 1 : 0] = 1;
+        return;
+    }
+
+    qsort(symbols, (size_t)used, sizeof(struct SymbolFrequency), compare_frequencies);
+
+    int depths[LITERAL_CODES];
+    for (int i = 0; i < used; i++)
+    {
+        depths[i] = symbols[i].frequency;
+    }
+    compute_minimum_redundancy(depths, used);
+
+    // Clamp to max_bits, then lengthen the deepest shorter codes until the
+    // code is complete again.
+    int length_counts[32] = { 0 };
+    for (int i = 0; i < used; i++)
+    {
+        length_counts[depths[i] < max_bits ? depths[i] : max_bits]++;
+    }
+
+    uint32_t total = 0;
+    for (int i = max_bits; i > 0; i--)
+    {
+        total += (uint32_t)length_counts[i] << (max_bits - i);
+    }
+
+    while (total != 1u << max_bits)
+    {
+        length_counts[max_bits]--;
+        for (int i = max_bits - 1; i > 0; i--)
+        {
+            if (length_counts[i] > 0)
+            {
+                length_counts[i]--;
+                length_counts[i + 1] += 2;
+                break;
+            }
+        }
+        total--;
+    }
+
+    // Least frequent symbols come first and get the longest codes.
+    int next = 0;
+    for (int length = max_bits; length > 0; length--)
+    {
+        for (int i = 0; i < length_counts[length]; i++)
+        {
+            lengths[symbols[next++].symbol] = (uint8_t)length;
+        }
+    }
+}
+
+// Canonical Huffman codes, bit-reversed because deflate writes codes
+// starting from their most significant bit into an LSB-first stream.
+static void build_codes(const uint8_t *lengths, int count, uint16_t *codes)
+{
+    int length_counts[MAX_CODE_BITS + 1] = { 0 };
+    for (int i = 0; i < count; i++)
+    {
+        length_counts[lengths[i]]++;
+    }
+    length_counts[0] = 0;
+
+    uint32_t next_code[MAX_CODE_BITS + 2];
+    uint32_t code = 0;
+    for (int bits = 1; bits <= MAX_CODE_BITS; bits++)
+    {
+        code = (code + (uint32_t)length_counts[bits - 1]) << 1;
+        next_code[bits] = code;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        int length = lengths[i];
+        if (length == 0)
+        {
+            codes[i] = 0;
+            continue;
+        }
+
+        uint32_t value = next_code[length]++;
+        uint32_t reversed = 0;
+        for (int bit = 0; bit < length; bit++)
+        {
+            reversed = (reversed << 1) | ((value >> bit) & 1);
+        }
+        codes[i] = (uint16_t)reversed;
+    }
+}
+
+// Run-length codes the literal and distance code lengths with codes 16-18.
+// Each entry holds the code in the low byte and its extra bits above it.
+static int encode_code_lengths(const uint8_t *lengths, int count, uint16_t *output, int *frequencies)
+{
+    int size = 0;
+    int i = 0;
+    while (i < count)
+    {
+        uint8_t length = lengths[i];
+        int run = 1;
+        while (i + run < count && lengths[i + run] == length)
+        {
+            run++;
+        }
+        i += run;
+
+        if (length == 0)
+        {
+            while (run >= 11)
+            {
+                int part = run < 138 ? run : 138;
+                output[size++] = (uint16_t)(18 | ((part - 11) << 8));
+                frequencies[18]++;
+                run -= part;
+            }
+
+            if (run >= 3)
+            {
+                output[size++] = (uint16_t)(17 | ((run - 3) << 8));
+                frequencies[17]++;
+                run = 0;
+            }
+        }
+
+        else
+        {
+            output[size++] = length;
+            frequencies[length]++;
+            run--;
+
+            while (run >= 3)
+            {
+                int part = run < 6 ? run : 6;
+                output[size++] = (uint16_t)(16 | ((part - 3) << 8));
+                frequencies[16]++;
+                run -= part;
+            }
+        }
+
+        while (run-- > 0)
+        {
+            output[size++] = length;
+            frequencies[length]++;
+        }
+    }
+
+    return size;
+}
+
+static void write_stored_blocks(struct BitWriter *writer, const uint8_t *data, size_t size, bool final)
+{
+    do
+    {
+        size_t part = size < MAX_STORED ? size : MAX_STORED;
+        size -= part;
+
+        write_bits(writer, final && size == 0 ? 1 : 0, 3);
+        align_bits(writer);
+
+        uint8_t header[4] = {
+            (uint8_t)part, (uint8_t)(part >> 8),
+            (uint8_t)~part, (uint8_t)(~part >> 8)
+        };
+        write_bytes(writer, header, 4);
+        write_bytes(writer, data, part);
+        data += part;
+    } while (size > 0);
+}
+
+// Writes tokens as one dynamic Huffman block, or as stored blocks when
+// that is smaller. raw holds the bytes the tokens encode.
+static void write_block(
+    struct BitWriter *writer,
+    const uint32_t *tokens,
+    size_t token_count,
+    const uint8_t *raw,
+    size_t raw_size,
+    bool final)
+{
+    int literal_frequencies[LITERAL_CODES] = { 0 };
+    int distance_frequencies[DISTANCE_CODES] = { 0 };
+
+    for (size_t i = 0; i < token_count; i++)
+    {
+        uint32_t token = tokens[i];
+        if (token & MATCH_FLAG)
+        {
+            literal_frequencies[257 + length_code_lookup[((token >> 16) & 0xFF) + MIN_MATCH]]++;
+            distance_frequencies[distance_code_lookup[(token & 0xFFFF) + 1]]++;
+        }
+
+        else
+        {
+            literal_frequencies[token]++;
+        }
+    }
+    literal_frequencies[256] = 1;
+
+    uint8_t lengths[LITERAL_CODES + DISTANCE_CODES];
+    uint8_t *literal_lengths = lengths;
+    uint8_t distance_lengths[DISTANCE_CODES];
+    build_code_lengths(literal_frequencies, LITERAL_CODES, MAX_CODE_BITS, literal_lengths);
+    build_code_lengths(distance_frequencies, DISTANCE_CODES, MAX_CODE_BITS, distance_lengths);
+
+    // A block without matches still needs a distance code.
+    if (distance_lengths[0] == 0 && distance_lengths[1] == 0)
+    {
+        bool has_distance = false;
+        for (int i = 2; i < DISTANCE_CODES; i++)
+        {
+            has_distance |= distance_lengths[i] != 0;
+        }
+
+        if (!has_distance)
+        {
+            distance_lengths[0] = 1;
+            distance_lengths[1] = 1;
+        }
+    }
+
+    int literal_count = LITERAL_CODES;
+    while (literal_count > 257 && literal_lengths[literal_count - 1] == 0)
+    {
+        literal_count--;
+    }
+
+    int distance_count = DISTANCE_CODES;
+    while (distance_count > 1 && distance_lengths[distance_count - 1] == 0)
+    {
+        distance_count--;
+    }
+
+    // Literal and distance lengths are run-length coded as one sequence.
+    memmove(lengths + literal_count, distance_lengths, (size_t)distance_count);
+
+    uint16_t code_length_symbols[LITERAL_CODES + DISTANCE_CODES];
+    int code_length_frequencies[LENGTH_CODES] = { 0 };
+    int symbol_count = encode_code_lengths(
+        lengths, literal_count + distance_count, code_length_symbols, code_length_frequencies);
+
+    uint8_t code_length_lengths[LENGTH_CODES];
+    uint16_t code_length_codes[LENGTH_CODES];
+    build_code_lengths(code_length_frequencies, LENGTH_CODES, MAX_LENGTH_CODE_BITS, code_length_lengths);
+    build_codes(code_length_lengths, LENGTH_CODES, code_length_codes);
+
+    int length_code_count = LENGTH_CODES;
+    while (length_code_count > 4 && code_length_lengths[length_code_order[length_code_count - 1]] == 0)
+    {
+        length_code_count--;
+    }
+
+    uint16_t literal_codes[LITERAL_CODES];
+    uint16_t distance_codes[DISTANCE_CODES];
+    build_codes(literal_lengths, literal_count, literal_codes);
+    build_codes(distance_lengths, distance_count, distance_codes);
+
+    // Size of the dynamic block in bits, to compare against storing.
+    size_t bits = 3 + 14 + 3 * (size_t)length_code_count;
+    static const int repeat_extra[3] = { 2, 3, 7 };
+    for (int i = 0; i < LENGTH_CODES; i++)
+    {
+        bits += (size_t)code_length_frequencies[i] * (code_length_lengths[i] + (i >= 16 ? repeat_extra[i - 16] : 0));
+    }
+    for (int i = 0; i < literal_count; i++)
+    {
+        bits += (size_t)literal_frequencies[i] * (literal_lengths[i] + (i > 256 ? length_extra[i - 257] : 0));
+    }
+    for (int i = 0; i < distance_count; i++)
+    {
+        bits += (size_t)distance_frequencies[i] * (distance_lengths[i] + distance_extra[i]);
+    }
+
+    size_t stored_bits = 8 * (raw_size + 5 * (raw_size / MAX_STORED + 1)) + 7;
+    if (stored_bits < bits)
+    {
+        write_stored_blocks(writer, raw, raw_size, final);
+        return;
+    }
+
+    write_bits(writer, final ? 1 : 0, 1);
+    write_bits(writer, 2, 2);
+    write_bits(writer, (uint32_t)(literal_count - 257), 5);
+    write_bits(writer, (uint32_t)(distance_count - 1), 5);
+    write_bits(writer, (uint32_t)(length_code_count - 4), 4);
+
+    for (int i = 0; i < length_code_count; i++)
+    {
+        write_bits(writer, code_length_lengths[length_code_order[i]], 3);
+    }
+
+    for (int i = 0; i < symbol_count; i++)
+    {
+        int symbol = code_length_symbols[i] & 0xFF;
+        int extra = code_length_symbols[i] >> 8;
+        write_bits(writer, code_length_codes[symbol], code_length_lengths[symbol]);
+        if (symbol >= 16)
+        {
+            write_bits(writer, (uint32_t)extra, repeat_extra[symbol - 16]);
+        }
+    }
+
+    for (size_t i = 0; i < token_count; i++)
+    {
+        uint32_t token = tokens[i];
+        if (!(token & MATCH_FLAG))
+        {
+            write_bits(writer, literal_codes[token], literal_lengths[token]);
+            continue;
+        }
+
+        int length = (int)((token >> 16) & 0xFF) + MIN_MATCH;
+        int distance = (int)(token & 0xFFFF) + 1;
+
+        int length_code = length_code_lookup[length];
+        write_bits(writer, literal_codes[257 + length_code], literal_lengths[257 + length_code]);
+        write_bits(writer, (uint32_t)(length - length_base[length_code]), length_extra[length_code]);
+
+        int distance_code = distance_code_lookup[distance];
+        write_bits(writer, distance_codes[distance_code], distance_lengths[distance_code]);
+        write_bits(writer, (uint32_t)(distance - distance_base[distance_code]), distance_extra[distance_code]);
+    }
+
+    write_bits(writer, literal_codes[256], literal_lengths[256]);
+}
+
+struct Matcher
+{
+    const uint8_t *data;
+    size_t size;
+    size_t inserted;
+    int32_t head[HASH_SIZE];
+    int32_t previous[WINDOW_SIZE];
+};
+
+static uint32_t hash_bytes(const uint8_t *data)
+{
+    uint32_t value = (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16);
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Adds every position before position to the hash chains.
+static void insert_positions(struct Matcher *matcher, size_t position)
+{
+    for (size_t i = matcher->inserted; i < position && i + MIN_MATCH <= matcher->size; i++)
+    {
+        uint32_t hash = hash_bytes(matcher->data + i);
+        matcher->previous[i & WINDOW_MASK] = matcher->head[hash];
+        matcher->head[hash] = (int32_t)i;
+    }
+
+    matcher->inserted = position > matcher->inserted ? position : matcher->inserted;
+}
+
+static int get_match_length(const uint8_t *a, const uint8_t *b, int max_length)
+{
+    int length = 0;
+    while (length + 8 <= max_length)
+    {
+        uint64_t x, y;
+        memcpy(&x, a + length, 8);
+        memcpy(&y, b + length, 8);
+        if (x != y)
+            return length + __builtin_ctzll(x ^ y) / 8;
+        length += 8;
+    }
+
+    while (length < max_length && a[length] == b[length])
+    {
+        length++;
+    }
+
+    return length;
+}
+
+// Returns the longest match for position that beats previous_length, or 0.
+static int find_match(
+    const struct Matcher *matcher,
+    const struct CompressionLevel *level,
+    size_t position,
+    size_t end,
+    int previous_length,
+    int *distance)
+{
+    size_t available = end - position;
+    int max_length = available < MAX_MATCH ? (int)available : MAX_MATCH;
+    if (max_length < MIN_MATCH)
+        return 0;
+
+    const uint8_t *current = matcher->data + position;
+    int best = previous_length > MIN_MATCH - 1 ? previous_length : MIN_MATCH - 1;
+    int chain = previous_length >= level->good_length ? level->max_chain >> 2 : level->max_chain;
+    if (best >= max_length)
+        return 0;
+
+    int32_t candidate = matcher->head[hash_bytes(current)];
+    while (candidate >= 0 && chain-- > 0)
+    {
+        size_t offset = position - (size_t)candidate;
+        if (offset > WINDOW_SIZE)
+            break;
+
+        const uint8_t *match = matcher->data + candidate;
+        if (match[best] == current[best] && match[0] == current[0])
+        {
+            int length = get_match_length(match, current, max_length);
+
+            if (length > best && !(length == MIN_MATCH && offset > TOO_FAR))
+            {
+                best = length;
+                *distance = (int)offset;
+                if (length >= level->nice_length || length == max_length)
+                    break;
+            }
+        }
+
+        int32_t next = matcher->previous[candidate & WINDOW_MASK];
+        if (next >= candidate)
+            break;
+        candidate = next;
+    }
+
+    return best > previous_length && best >= MIN_MATCH ? best : 0;
+}
+
+// Deflates data[start, end) into writer as complete blocks, using up to a
+// window of the bytes before start as the dictionary.
+static void deflate_range(
+    struct BitWriter *writer,
+    const uint8_t *data,
+    size_t data_size,
+    size_t start,
+    size_t end,
+    int level_index,
+    bool final)
+{
+    if (level_index == 0)
+    {
+        write_stored_blocks(writer, data + start, end - start, final);
+        return;
+    }
+
+    const struct CompressionLevel *level = &compression_levels[level_index];
+    struct Matcher *matcher = ALLOC(struct Matcher);
+    uint32_t *tokens = ALLOC_ARRAY(uint32_t, BLOCK_TOKENS);
+
+    // Positions are relative to the start of the dictionary so they fit the
+    // 32-bit chain entries.
+    size_t base = start > WINDOW_SIZE ? start - WINDOW_SIZE : 0;
+    matcher->data = data + base;
+    matcher->size = data_size - base;
+    matcher->inserted = 0;
+    memset(matcher->head, 0xFF, sizeof(matcher->head));
+    insert_positions(matcher, start - base);
+
+    size_t position = start - base;
+    size_t limit = end - base;
+    size_t block_start = position;
+    size_t token_count = 0;
+
+    while (position < limit)
+    {
+        // Lazy matching emits at most one literal per longer match, so this
+        // leaves room for a whole step.
+        if (token_count + MAX_MATCH >= BLOCK_TOKENS)
+        {
+            write_block(writer, tokens, token_count, matcher->data + block_start,
+                position - block_start, false);
+            block_start = position;
+            token_count = 0;
+        }
+
+        insert_positions(matcher, position);
+
+        int distance = 0;
+        int length = find_match(matcher, level, position, limit, 0, &distance);
+
+        // Lazy matching: emit a literal instead when the next position
+        // starts a longer match.
+        while (length > 0 && length < level->lazy_limit && position + 1 < limit)
+        {
+            insert_positions(matcher, position + 1);
+
+            int next_distance = 0;
+            int next_length = find_match(matcher, level, position + 1, limit, length, &next_distance);
+            if (next_length == 0)
+                break;
+
+            tokens[token_count++] = matcher->data[position++];
+            length = next_length;
+            distance = next_distance;
+        }
+
+        if (length > 0)
+        {
+            tokens[token_count++] = MATCH_FLAG | ((uint32_t)(length - MIN_MATCH) << 16) | (uint32_t)(distance - 1);
+            position += (size_t)length;
+        }
+
+        else
+        {
+            tokens[token_count++] = matcher->data[position++];
+        }
+    }
+
+    if (token_count > 0 || final)
+    {
+        write_block(writer, tokens, token_count, matcher->data + block_start,
+            position - block_start, final);
+    }
+
+    FREE_ARRAY(tokens, uint32_t, BLOCK_TOKENS);
+    FREE(matcher, struct Matcher);
+}
+
+struct PngBand
+{
+    int first_row;
+    int row_count;
+    uint32_t adler;
+    uint32_t crc;
+    struct BitWriter output;
+};
+
+// One call to write_png_rows. filtered starts with the writer's window so
+// the first band can match against the rows written before.
+struct PngBatch
+{
+    const struct PngWriter *writer;
+    const uint8_t *pixels;
+    int row_count;
+    bool bottom_up;
+    bool first;
+    bool last;
+
+    uint8_t *filtered;
+    size_t filtered_size;
+    size_t dictionary_size;
+
+    struct PngBand *bands;
+    int band_count;
+};
+
+// Row 0 is the top row of the batch; row -1 is the last row written before
+// it, or NULL at the top of the image.
+static const uint8_t* get_batch_row(const struct PngBatch *batch, int row)
+{
+    if (row < 0)
+        return batch->first ? NULL : batch->writer->previous_row;
+
+    int source = batch->bottom_up ? batch->row_count - 1 - row : row;
+    return batch->pixels + (size_t)source * batch->writer->width * PNG_BYTES_PER_PIXEL;
+}
+
+static void filter_band(void *data, size_t task, int worker)
+{
+    PROFILE_BEGIN("filter_band");
+    struct PngBatch *batch = (struct PngBatch*)data;
+    struct PngBand *band = &batch->bands[task];
+    const struct PngWriter *writer = batch->writer;
+
+    size_t size = writer->row_size - 1;
+    uint8_t *scratch = NULL;
+    if (writer->options.filter == PNG_FILTER_ADAPTIVE)
+    {
+        scratch = ALLOC_ARRAY(uint8_t, size);
+    }
+
+    for (int y = band->first_row; y < band->first_row + band->row_count; y++)
+    {
+        const uint8_t *row = get_batch_row(batch, y);
+        const uint8_t *previous = get_batch_row(batch, y - 1);
+        uint8_t *output = batch->filtered + batch->dictionary_size + (size_t)y * writer->row_size;
+
+        enum PngFilter filter = writer->options.filter;
+        if (filter == PNG_FILTER_ADAPTIVE)
+        {
+            size_t best_cost = SIZE_MAX;
+            for (int i = PNG_FILTER_NONE; i <= PNG_FILTER_PAETH; i++)
+            {
+                filter_row((enum PngFilter)i, row, previous, scratch, size);
+                size_t cost = get_filter_cost(scratch, size);
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    filter = (enum PngFilter)i;
+                }
+            }
+        }
+
+        output[0] = (uint8_t)filter;
+        filter_row(filter, row, previous, output + 1, size);
+    }
+
+    if (scratch != NULL)
+    {
+        FREE_ARRAY(scratch, uint8_t, size);
+    }
+    PROFILE_END();
+}
+
+static void deflate_band(void *data, size_t task, int worker)
+{
+    PROFILE_BEGIN("deflate_band");
+    struct PngBatch *batch = (struct PngBatch*)data;
+    struct PngBand *band = &batch->bands[task];
+    const struct PngWriter *writer = batch->writer;
+
+    size_t start = batch->dictionary_size + (size_t)band->first_row * writer->row_size;
+    size_t end = start + (size_t)band->row_count * writer->row_size;
+    bool last = batch->last && (int)task == batch->band_count - 1;
+
+    band->adler = update_adler(1, batch->filtered + start, end - start);
+
+    if (batch->first && task == 0)
+    {
+        // zlib header: 32K window, deflate, and the level hint.
+        int level = writer->options.level;
+        uint32_t flags = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+        uint32_t header = (0x78u << 8) | (flags << 6);
+        header += 31 - header % 31;
+        write_bytes(&band->output, (uint8_t[]){ (uint8_t)(header >> 8), (uint8_t)header }, 2);
+    }
+
+    deflate_range(&band->output, batch->filtered, batch->filtered_size,
+        start, end, writer->options.level, last);
+
+    // An empty stored block brings the band to a byte boundary, so the
+    // next band's blocks can follow it directly.
+    if (!last)
+    {
+        write_bits(&band->output, 0, 3);
+        align_bits(&band->output);
+        write_bytes(&band->output, (uint8_t[]){ 0x00, 0x00, 0xFF, 0xFF }, 4);
+    }
+
+    else
+    {
+        align_bits(&band->output);
+    }
+
+    band->crc = update_crc(update_crc(0xFFFFFFFFu, (const uint8_t*)"IDAT", 4),
+        band->output.data, band->output.size);
+    PROFILE_END();
+}
+
+static void write_u32(uint8_t *output, uint32_t value)
+{
+    output[0] = (uint8_t)(value >> 24);
+    output[1] = (uint8_t)(value >> 16);
+    output[2] = (uint8_t)(value >> 8);
+    output[3] = (uint8_t)value;
+}
+
+static bool write_chunk_header(FILE *file, const char *type, size_t size)
+{
+    uint8_t header[8];
+    write_u32(header, (uint32_t)size);
+    memcpy(header + 4, type, 4);
+    return fwrite(header, 1, 8, file) == 8;
+}
+
+static bool write_chunk_footer(FILE *file, uint32_t crc)
+{
+    uint8_t footer[4];
+    write_u32(footer, crc ^ 0xFFFFFFFFu);
+    return fwrite(footer, 1, 4, file) == 4;
+}
+
+static bool write_chunk(FILE *file, const char *type, const uint8_t *data, size_t size)
+{
+    uint32_t crc = update_crc(0xFFFFFFFFu, (const uint8_t*)type, 4);
+    if (size > 0)
+    {
+        crc = update_crc(crc, data, size);
+    }
+
+    return write_chunk_header(file, type, size) &&
+        (size == 0 || fwrite(data, 1, size, file) == size) &&
+        write_chunk_footer(file, crc);
+}
+
+bool open_png_writer(
+    struct PngWriter *writer,
+    const char *path,
+    int width,
+    int height,
+    const struct PngOptions *options,
+    struct ThreadPool *pool)
+{
+    memset(writer, 0, sizeof(struct PngWriter));
+    if (width <= 0 || height <= 0)
+    {
+        LOG_ERROR("Invalid PNG size: %dx%d", width, height);
+        return false;
+    }
+
+    pthread_once(&tables_once, init_tables);
+
+    writer->file = fopen(path, "wb");
+    if (writer->file == NULL)
+    {
+        LOG_ERROR("Failed to open %s for writing", path);
+        return false;
+    }
+
+    writer->width = width;
+    writer->height = height;
+    writer->options = *options;
+    writer->options.level = options->level < 0 ? 0 : options->level > 9 ? 9 : options->level;
+    writer->pool = pool;
+
+    // Every row starts with its filter type.
+    writer->row_size = 1 + (size_t)width * PNG_BYTES_PER_PIXEL;
+    writer->previous_row = ALLOC_ARRAY(uint8_t, writer->row_size - 1);
+    writer->window = ALLOC_ARRAY(uint8_t, WINDOW_SIZE);
+    writer->adler = 1;
+    init_arena(&writer->scratch, 0, MEMORY_TAG_EXPORT);
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+    // 8-bit RGBA, deflate, adaptive filtering, no interlacing.
+    uint8_t header[13];
+    write_u32(header, (uint32_t)width);
+    write_u32(header + 4, (uint32_t)height);
+    header[8] = 8;
+    header[9] = 6;
+    header[10] = 0;
+    header[11] = 0;
+    header[12] = 0;
+
+    writer->failed = fwrite(signature, 1, sizeof(signature), writer->file) != sizeof(signature) ||
+        !write_chunk(writer->file, "IHDR", header, sizeof(header));
+
+    return true;
+}
+
+bool write_png_rows(struct PngWriter *writer, const uint8_t *pixels, int row_count, bool bottom_up)
+{
+    if (writer->failed)
+        return false;
+
+    if (row_count <= 0 || writer->rows_written + row_count > writer->height)
+    {
+        LOG_ERROR("PNG rows %d to %d are outside the image", writer->rows_written, writer->rows_written + row_count);
+        writer->failed = true;
+        return false;
+    }
+
+    PROFILE_BEGIN("write_png_rows");
+    struct PngBatch batch;
+    batch.writer = writer;
+    batch.pixels = pixels;
+    batch.row_count = row_count;
+    batch.bottom_up = bottom_up;
+    batch.first = writer->rows_written == 0;
+    batch.last = writer->rows_written + row_count == writer->height;
+
+    batch.dictionary_size = writer->window_size;
+    batch.filtered_size = batch.dictionary_size + writer->row_size * (size_t)row_count;
+    reset_arena(&writer->scratch);
+    batch.filtered = ARENA_ALLOC_ARRAY(&writer->scratch, uint8_t, batch.filtered_size);
+    memcpy(batch.filtered, writer->window, writer->window_size);
+
+    int band_rows = (int)(PNG_BAND_BYTES / writer->row_size);
+    band_rows = band_rows > 0 ? band_rows : 1;
+    batch.band_count = (row_count + band_rows - 1) / band_rows;
+    batch.bands = ARENA_ALLOC_ARRAY(&writer->scratch, struct PngBand, batch.band_count);
+    memset(batch.bands, 0, (size_t)batch.band_count * sizeof(struct PngBand));
+
+    for (int i = 0; i < batch.band_count; i++)
+    {
+        struct PngBand *band = &batch.bands[i];
+        band->first_row = i * band_rows;
+        band->row_count = row_count - band->first_row < band_rows ? row_count - band->first_row : band_rows;
+    }
+
+    // Deflating a band reads up to a window of the previous band's filtered
+    // rows, so all filtering finishes first.
+    run_thread_pool(writer->pool, (size_t)batch.band_count, filter_band, &batch);
+    run_thread_pool(writer->pool, (size_t)batch.band_count, deflate_band, &batch);
+
+    for (int i = 0; i < batch.band_count; i++)
+    {
+        const struct PngBand *band = &batch.bands[i];
+        writer->adler = combine_adler(writer->adler, band->adler, (size_t)band->row_count * writer->row_size);
+    }
+
+    if (batch.last)
+    {
+        struct PngBand *last = &batch.bands[batch.band_count - 1];
+        uint8_t trailer[4];
+        write_u32(trailer, writer->adler);
+        write_bytes(&last->output, trailer, 4);
+        last->crc = update_crc(last->crc, trailer, 4);
+    }
+
+    for (int i = 0; i < batch.band_count && !writer->failed; i++)
+    {
+        const struct PngBand *band = &batch.bands[i];
+        writer->failed = !write_chunk_header(writer->file, "IDAT", band->output.size) ||
+            fwrite(band->output.data, 1, band->output.size, writer->file) != band->output.size ||
+            !write_chunk_footer(writer->file, band->crc);
+    }
+
+    // Carry the context the next batch needs: the end of the filtered data
+    // as its dictionary and the last row for its filters.
+    writer->window_size = batch.filtered_size < WINDOW_SIZE ? batch.filtered_size : WINDOW_SIZE;
+    memcpy(writer->window, batch.filtered + batch.filtered_size - writer->window_size, writer->window_size);
+    memcpy(writer->previous_row, get_batch_row(&batch, row_count - 1), writer->row_size - 1);
+    writer->rows_written += row_count;
+
+    for (int i = 0; i < batch.band_count; i++)
+    {
+        struct BitWriter *output = &batch.bands[i].output;
+        if (output->data != NULL)
+        {
+            FREE_ARRAY(output->data, uint8_t, output->capacity);
+        }
+    }
+
+    if (writer->failed)
+    {
+        LOG_ERROR("Failed to write PNG data");
+    }
+
+    PROFILE_END();
+    return !writer->failed;
+}
+
+bool close_png_writer(struct PngWriter *writer)
+{
+    if (writer->file == NULL)
+        return false;
+
+    if (!writer->failed && writer->rows_written != writer->height)
+    {
+        LOG_ERROR("PNG closed after %d of %d rows", writer->rows_written, writer->height);
+        writer->failed = true;
+    }
+
+    bool success = !writer->failed && write_chunk(writer->file, "IEND", NULL, 0);
+    success = fclose(writer->file) == 0 && success;
+
+    FREE_ARRAY(writer->window, uint8_t, WINDOW_SIZE);
+    FREE_ARRAY(writer->previous_row, uint8_t, writer->row_size - 1);
+    destroy_arena(&writer->scratch);
+    memset(writer, 0, sizeof(struct PngWriter));
+
+    return success;
+}
+
+bool write_png(
+    const char *path,
+    const uint8_t *pixels,
+    int width,
+    int height,
+    bool bottom_up,
+    const struct PngOptions *options,
+    struct ThreadPool *pool)
+{
+    struct PngWriter writer;
+    if (!open_png_writer(&writer, path, width, height, options, pool))
+        return false;
+
+    bool success = write_png_rows(&writer, pixels, height, bottom_up);
+    success = close_png_writer(&writer) && success;
+
+    if (!success)
+    {
+        LOG_ERROR("Failed to write %s", path);
+    }
+
+    return success;
+}
\ No newline at end of file
@@ -0,0 +1,711 @@
+#define MEMORY_TAG MEMORY_TAG_GEOMETRY
+
+#include <common.h>
+#include <memory.h>
+#include <core/log.h>
+#include <core/profile.h>
+#include <util.h>
+#include <graphics/raster.h>
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define RASTER_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define RASTER_SIMD_SSE2
+#endif
+
+#define FIXED_ONE (1 << RASTER_SUBPIXEL_BITS)
+
+// Partially covered blocks only evaluate edges that cross them, and those
+// stay within 7 * (|step_x| + |step_y|) of zero. Keep that below 2^31.
+#define SMALL_EDGE_LIMIT (1 << 20)
+
+bool create_raster_target(struct RasterTarget *target, int width, int height)
+{
+    if (width <= 0 || height <= 0)
+    {
+        LOG_ERROR("Invalid raster target size (%d, %d)", width, height);
+        return false;
+    }
+
+    target->width = width;
+    target->height = height;
+    target->pixels = ALLOC_ARRAY(uint8_t, 4 * (size_t)width * (size_t)height);
+    return target->pixels != NULL;
+}
+
+void destroy_raster_target(struct RasterTarget *target)
+{
+    FREE_ARRAY(target->pixels, uint8_t, 4 * (size_t)target->width * (size_t)target->height);
+    target->pixels = NULL;
+}
+
+static uint8_t to_unorm8(float value)
+{
+    if (value <= 0.0f)
+        return 0;
+    if (value >= 1.0f)
+        return 255;
+
+    return (uint8_t)(value * 255.0f + 0.5f);
+}
+
+static uint32_t pack_color(const float *color)
+{
+    return (uint32_t)to_unorm8(color[0])
+        | (uint32_t)to_unorm8(color[1]) << 8
+        | (uint32_t)to_unorm8(color[2]) << 16
+        | 0xFF000000u;
+}
+
+void clear_raster_target(struct RasterTarget *target, const float *color)
+{
+    const float rgb[3] = { color[0], color[1], color[2] };
+    uint32_t value = (pack_color(rgb) & 0x00FFFFFFu) | (uint32_t)to_unorm8(color[3]) << 24;
+
+    uint32_t *pixels = (uint32_t*)target->pixels;
+    size_t count = (size_t)target->width * (size_t)target->height;
+    for (size_t i = 0; i < count; i++)
+    {
+        pixels[i] = value;
+    }
+}
+
+void init_rasterizer(struct Rasterizer *rasterizer, struct ThreadPool *pool)
+{
+    memset(rasterizer, 0, sizeof(struct Rasterizer));
+    rasterizer->pool = pool;
+}
+
+static void destroy_chunk(struct RasterChunk *chunk, int bin_count)
+{
+    for (int i = 0; i < bin_count; i++)
+    {
+        struct RasterBin *bin = &chunk->bins[i];
+        if (bin->triangles != NULL)
+        {
+            FREE_ARRAY(bin->triangles, uint32_t, bin->capacity);
+        }
+    }
+
+    if (chunk->bins != NULL)
+    {
+        FREE_ARRAY(chunk->bins, struct RasterBin, bin_count);
+    }
+
+    if (chunk->triangles != NULL)
+    {
+        FREE_ARRAY(chunk->triangles, struct RasterTriangle, chunk->triangle_capacity);
+    }
+
+    memset(chunk, 0, sizeof(struct RasterChunk));
+}
+
+void destroy_rasterizer(struct Rasterizer *rasterizer)
+{
+    for (int i = 0; i < rasterizer->chunk_count; i++)
+    {
+        destroy_chunk(&rasterizer->chunks[i], rasterizer->bin_count);
+    }
+
+    if (rasterizer->chunks != NULL)
+    {
+        FREE_ARRAY(rasterizer->chunks, struct RasterChunk, rasterizer->chunk_count);
+    }
+
+    if (rasterizer->submissions != NULL)
+    {
+        FREE_ARRAY(rasterizer->submissions, struct RasterSubmission, rasterizer->submission_capacity);
+    }
+
+    memset(rasterizer, 0, sizeof(struct Rasterizer));
+}
+
+void begin_raster_frame(struct Rasterizer *rasterizer, struct RasterTarget *target)
+{
+    int tiles_x = (target->width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    int tiles_y = (target->height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    int chunk_count = rasterizer->pool != NULL ? rasterizer->pool->worker_count : 1;
+
+    if (tiles_x * tiles_y != rasterizer->bin_count || chunk_count != rasterizer->chunk_count)
+    {
+        for (int i = 0; i < rasterizer->chunk_count; i++)
+        {
+            destroy_chunk(&rasterizer->chunks[i], rasterizer->bin_count);
+        }
+
+        rasterizer->chunks = (struct RasterChunk*)reallocate(
+            rasterizer->chunks,
+            (size_t)rasterizer->chunk_count * sizeof(struct RasterChunk),
+            (size_t)chunk_count * sizeof(struct RasterChunk)
+        );
+        rasterizer->chunk_count = chunk_count;
+        rasterizer->bin_count = tiles_x * tiles_y;
+
+        for (int i = 0; i < chunk_count; i++)
+        {
+            struct RasterChunk *chunk = &rasterizer->chunks[i];
+            memset(chunk, 0, sizeof(struct RasterChunk));
+            chunk->bins = ALLOC_ARRAY(struct RasterBin, rasterizer->bin_count);
+            memset(chunk->bins, 0, (size_t)rasterizer->bin_count * sizeof(struct RasterBin));
+        }
+    }
+
+    for (int i = 0; i < rasterizer->chunk_count; i++)
+    {
+        struct RasterChunk *chunk = &rasterizer->chunks[i];
+        chunk->triangle_count = 0;
+        for (int j = 0; j < rasterizer->bin_count; j++)
+        {
+            chunk->bins[j].count = 0;
+        }
+    }
+
+    rasterizer->target = target;
+    rasterizer->tiles_x = tiles_x;
+    rasterizer->tiles_y = tiles_y;
+    rasterizer->submission_count = 0;
+    rasterizer->instance_count = 0;
+}
+
+static void push_bin(struct RasterBin *bin, uint32_t triangle)
+{
+    if (bin->count == bin->capacity)
+    {
+        size_t capacity = bin->capacity < 64 ? 64 : 2 * bin->capacity;
+        bin->triangles = (uint32_t*)reallocate(
+            bin->triangles,
+            bin->capacity * sizeof(uint32_t),
+            capacity * sizeof(uint32_t)
+        );
+        bin->capacity = capacity;
+    }
+
+    bin->triangles[bin->count++] = triangle;
+}
+
+static struct RasterTriangle* push_triangle(struct RasterChunk *chunk)
+{
+    if (chunk->triangle_count == chunk->triangle_capacity)
+    {
+        size_t capacity = chunk->triangle_capacity < 1024 ? 1024 : 2 * chunk->triangle_capacity;
+        chunk->triangles = (struct RasterTriangle*)reallocate(
+            chunk->triangles,
+            chunk->triangle_capacity * sizeof(struct RasterTriangle),
+            capacity * sizeof(struct RasterTriangle)
+        );
+        chunk->triangle_capacity = capacity;
+    }
+
+    return &chunk->triangles[chunk->triangle_count++];
+}
+
+static int64_t floor_div(int64_t value, int64_t divisor)
+{
+    int64_t quotient = value / divisor;
+    return quotient - (value % divisor != 0 && value < 0);
+}
+
+// Snaps window coordinates to the subpixel grid with pixel centers on whole
+// fixed-point values, computes the edge functions and bins the triangle.
+// Follows the GL rasterization rules as llvmpipe implements them so both
+// backends produce the same pixels.
+static void setup_triangle(
+    const struct Rasterizer *rasterizer,
+    struct RasterChunk *chunk,
+    const float (*window)[2],
+    const float *const *colors)
+{
+    int64_t x[3], y[3];
+    for (int i = 0; i < 3; i++)
+    {
+        x[i] = (int64_t)lrintf((window[i][0] - 0.5f) * (float)FIXED_ONE);
+        y[i] = (int64_t)lrintf((window[i][1] - 0.5f) * (float)FIXED_ONE);
+    }
+
+    int order[3] = { 0, 1, 2 };
+    int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0)
+        return;
+
+    // Wind every triangle counter-clockwise; nothing is culled.
+    if (area < 0)
+    {
+        area = -area;
+        order[1] = 2;
+        order[2] = 1;
+    }
+
+    int64_t min_x = x[0], max_x = x[0], min_y = y[0], max_y = y[0];
+    for (int i = 1; i < 3; i++)
+    {
+        min_x = x[i] < min_x ? x[i] : min_x;
+        max_x = x[i] > max_x ? x[i] : max_x;
+        min_y = y[i] < min_y ? y[i] : min_y;
+        max_y = y[i] > max_y ? y[i] : max_y;
+    }
+
+    const struct RasterTarget *target = rasterizer->target;
+    int64_t pixel_min_x = -floor_div(-min_x, FIXED_ONE);
+    int64_t pixel_min_y = -floor_div(-min_y, FIXED_ONE);
+    int64_t pixel_max_x = floor_div(max_x, FIXED_ONE);
+    int64_t pixel_max_y = floor_div(max_y, FIXED_ONE);
+
+    pixel_min_x = pixel_min_x < 0 ? 0 : pixel_min_x;
+    pixel_min_y = pixel_min_y < 0 ? 0 : pixel_min_y;
+    pixel_max_x = pixel_max_x >= target->width ? target->width - 1 : pixel_max_x;
+    pixel_max_y = pixel_max_y >= target->height ? target->height - 1 : pixel_max_y;
+
+    if (pixel_min_x > pixel_max_x || pixel_min_y > pixel_max_y)
+        return;
+
+    struct RasterTriangle *triangle = push_triangle(chunk);
+    triangle->min_x = (int)pixel_min_x;
+    triangle->min_y = (int)pixel_min_y;
+    triangle->max_x = (int)pixel_max_x;
+    triangle->max_y = (int)pixel_max_y;
+    triangle->small = true;
+
+    for (int i = 0; i < 3; i++)
+    {
+        int from = order[i];
+        int to = order[(i + 1) % 3];
+
+        int64_t a = y[from] - y[to];
+        int64_t b = x[to] - x[from];
+        int64_t c = -(a * x[from] + b * y[from]);
+
+        // Pixels exactly on an edge belong to the triangle only if the
+        // edge is a left edge or a horizontal edge below the interior.
+        bool left = a > 0;
+        bool bottom = a == 0 && b > 0;
+        if (!left && !bottom)
+        {
+            c -= 1;
+        }
+
+        triangle->step_x[i] = a * FIXED_ONE;
+        triangle->step_y[i] = b * FIXED_ONE;
+        triangle->c[i] = c;
+
+        if ((a < 0 ? -a : a) + (b < 0 ? -b : b) >= SMALL_EDGE_LIMIT)
+        {
+            triangle->small = false;
+        }
+    }
+
+    triangle->flat =
+        memcmp(colors[0], colors[1], 3 * sizeof(float)) == 0 &&
+        memcmp(colors[0], colors[2], 3 * sizeof(float)) == 0;
+    triangle->color = pack_color(colors[0]);
+
+    // Edge i is opposite vertex order[i + 2], so its value weighs that
+    // vertex's color.
+    for (int i = 0; i < 3; i++)
+    {
+        memcpy(triangle->colors[i], colors[order[(i + 2) % 3]], 3 * sizeof(float));
+    }
+    triangle->inverse_area = 1.0 / (double)area;
+
+    uint32_t index = (uint32_t)(chunk->triangle_count - 1);
+    int tile_min_x = triangle->min_x / RASTER_TILE_SIZE;
+    int tile_max_x = triangle->max_x / RASTER_TILE_SIZE;
+    int tile_min_y = triangle->min_y / RASTER_TILE_SIZE;
+    int tile_max_y = triangle->max_y / RASTER_TILE_SIZE;
+    for (int tile_y = tile_min_y; tile_y <= tile_max_y; tile_y++)
+    {
+        for (int tile_x = tile_min_x; tile_x <= tile_max_x; tile_x++)
+        {
+            push_bin(&chunk->bins[tile_y * rasterizer->tiles_x + tile_x], index);
+        }
+    }
+}
+
+void submit_raster_instances(
+    struct Rasterizer *rasterizer,
+    const float *view_projection,
+    const struct TileMesh *mesh,
+    const struct TileInstance *instances,
+    size_t instance_count)
+{
+    if (rasterizer->submission_count == rasterizer->submission_capacity)
+    {
+        size_t capacity = rasterizer->submission_capacity < 4 ? 4 : 2 * rasterizer->submission_capacity;
+        rasterizer->submissions = (struct RasterSubmission*)reallocate(
+            rasterizer->submissions,
+            rasterizer->submission_capacity * sizeof(struct RasterSubmission),
+            capacity * sizeof(struct RasterSubmission)
+        );
+        rasterizer->submission_capacity = capacity;
+    }
+
+    struct RasterSubmission *submission = &rasterizer->submissions[rasterizer->submission_count++];
+    memcpy(submission->view_projection, view_projection, sizeof(submission->view_projection));
+    submission->mesh = mesh;
+    submission->instances = instances;
+    submission->instance_count = instance_count;
+
+    rasterizer->instance_count += instance_count;
+}
+
+static void setup_instances(
+    const struct Rasterizer *rasterizer,
+    struct RasterChunk *chunk,
+    const struct RasterSubmission *submission,
+    size_t first,
+    size_t last)
+{
+    const float (*m)[4] = (const float (*)[4])submission->view_projection;
+    const struct TileMesh *mesh = submission->mesh;
+    const float half_width = 0.5f * (float)rasterizer->target->width;
+    const float half_height = 0.5f * (float)rasterizer->target->height;
+
+    float window[3][2];
+    const float *colors[3];
+
+    for (size_t i = first; i < last; i++)
+    {
+        const struct TileInstance *instance = &submission->instances[i];
+        for (size_t j = 0; j + 2 < mesh->index_count; j += 3)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                const float *vertex = mesh->vertices + 6 * mesh->indices[j + k];
+
+                // Same operation order as the instanced vertex shader.
+                float px = instance->linear[0] * vertex[0] + instance->linear[2] * vertex[1] + instance->offset[0];
+                float py = instance->linear[1] * vertex[0] + instance->linear[3] * vertex[1] + instance->offset[1];
+
+                float clip_x = m[0][0] * px + m[1][0] * py + m[2][0] * 0.0f + m[3][0];
+                float clip_y = m[0][1] * px + m[1][1] * py + m[2][1] * 0.0f + m[3][1];
+                float clip_w = m[0][3] * px + m[1][3] * py + m[2][3] * 0.0f + m[3][3];
+
+                window[k][0] = clip_x / clip_w * half_width + half_width;
+                window[k][1] = clip_y / clip_w * half_height + half_height;
+                colors[k] = vertex + 3;
+            }
+
+            setup_triangle(rasterizer, chunk, (const float (*)[2])window, colors);
+        }
+    }
+}
+
+// Binning task: chunk `task` covers one contiguous share of all instances
+// queued this frame, across submission boundaries.
+static void bin_chunk(void *data, size_t task, int worker)
+{
+    PROFILE_BEGIN("bin_chunk");
+    struct Rasterizer *rasterizer = (struct Rasterizer*)data;
+    struct RasterChunk *chunk = &rasterizer->chunks[task];
+
+    size_t first = rasterizer->instance_count * task / (size_t)rasterizer->chunk_count;
+    size_t last = rasterizer->instance_count * (task + 1) / (size_t)rasterizer->chunk_count;
+
+    size_t base = 0;
+    for (size_t i = 0; i < rasterizer->submission_count && base < last; i++)
+    {
+        const struct RasterSubmission *submission = &rasterizer->submissions[i];
+        size_t begin = first > base ? first - base : 0;
+        size_t end = last - base < submission->instance_count ? last - base : submission->instance_count;
+        if (begin < end)
+        {
+            setup_instances(rasterizer, chunk, submission, begin, end);
+        }
+
+        base += submission->instance_count;
+    }
+    PROFILE_END();
+}
+
+static void fill_span(uint32_t *row, int x0, int x1, uint32_t color)
+{
+    for (int x = x0; x <= x1; x++)
+    {
+        row[x] = color;
+    }
+}
+
+static void shade_pixel(uint32_t *pixel, const struct RasterTriangle *triangle, const int64_t *edges)
+{
+    if (triangle->flat)
+    {
+        *pixel = triangle->color;
+        return;
+    }
+
+    float color[3];
+    for (int i = 0; i < 3; i++)
+    {
+        // The fill rule bias is at most one unit of twice the area, which
+        // is well below the precision of the result.
+        double value = 0.0;
+        for (int j = 0; j < 3; j++)
+        {
+            value += (double)edges[j] * triangle->colors[j][i];
+        }
+
+        color[i] = (float)(value * triangle->inverse_area);
+    }
+
+    *pixel = pack_color(color);
+}
+
+static void raster_block_scalar(
+    const struct RasterTriangle *triangle,
+    uint32_t *pixels,
+    int stride,
+    int x0, int y0, int x1, int y1,
+    const int64_t *block_edges,
+    int block_x, int block_y)
+{
+    for (int y = y0; y <= y1; y++)
+    {
+        uint32_t *row = pixels + (size_t)y * stride;
+        int64_t edges[3];
+        for (int i = 0; i < 3; i++)
+        {
+            edges[i] = block_edges[i]
+                + triangle->step_y[i] * (y - block_y)
+                + triangle->step_x[i] * (x0 - block_x);
+        }
+
+        for (int x = x0; x <= x1; x++)
+        {
+            if ((edges[0] | edges[1] | edges[2]) >= 0)
+            {
+                shade_pixel(&row[x], triangle, edges);
+            }
+
+            edges[0] += triangle->step_x[0];
+            edges[1] += triangle->step_x[1];
+            edges[2] += triangle->step_x[2];
+        }
+    }
+}
+
+#if defined(RASTER_SIMD_AVX2) || defined(RASTER_SIMD_SSE2)
+// Evaluates the edges that cross a full-width block eight pixels at a time.
+// Edges that do not cross the block are left out; they pass everywhere.
+static void raster_block_simd(
+    const struct RasterTriangle *triangle,
+    uint32_t *pixels,
+    int stride,
+    int x0, int y0, int x1, int y1,
+    const int64_t *block_edges,
+    const bool *crossing,
+    int block_x, int block_y)
+{
+    int32_t step_x[3] = { 0, 0, 0 };
+    int32_t step_y[3] = { 0, 0, 0 };
+    int32_t base[3] = { 0, 0, 0 };
+    for (int i = 0; i < 3; i++)
+    {
+        if (!crossing[i])
+            continue;
+
+        step_x[i] = (int32_t)triangle->step_x[i];
+        step_y[i] = (int32_t)triangle->step_y[i];
+        base[i] = (int32_t)(block_edges[i] + triangle->step_y[i] * (y0 - block_y));
+    }
+
+    // Lanes outside [x0, x1] must be rejected as well.
+    int32_t clip[8];
+    for (int i = 0; i < 8; i++)
+    {
+        clip[i] = block_x + i < x0 || block_x + i > x1 ? -1 : 0;
+    }
+
+#if defined(RASTER_SIMD_AVX2)
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i clip_mask = _mm256_loadu_si256((const __m256i*)clip);
+    const __m256i color = _mm256_set1_epi32((int)triangle->color);
+
+    __m256i offsets[3];
+    for (int i = 0; i < 3; i++)
+    {
+        offsets[i] = _mm256_mullo_epi32(lanes, _mm256_set1_epi32(step_x[i]));
+    }
+
+    for (int y = y0; y <= y1; y++)
+    {
+        __m256i rejected = clip_mask;
+        for (int i = 0; i < 3; i++)
+        {
+            __m256i edge = _mm256_add_epi32(_mm256_set1_epi32(base[i]), offsets[i]);
+            rejected = _mm256_or_si256(rejected, edge);
+            base[i] += step_y[i];
+        }
+
+        // Covered lanes are the ones with the sign bit clear everywhere.
+        __m256i covered = _mm256_xor_si256(rejected, _mm256_set1_epi32(-1));
+        _mm256_maskstore_epi32((int*)(pixels + (size_t)y * stride + block_x), covered, color);
+    }
+#else
+    const __m128i color = _mm_set1_epi32((int)triangle->color);
+    const __m128i clip_low = _mm_loadu_si128((const __m128i*)clip);
+    const __m128i clip_high = _mm_loadu_si128((const __m128i*)(clip + 4));
+
+    // SSE2 has no 32-bit multiply, so the lane offsets are built up scalar.
+    __m128i offsets_low[3], offsets_high[3];
+    for (int i = 0; i < 3; i++)
+    {
+        offsets_low[i] = _mm_setr_epi32(0, step_x[i], 2 * step_x[i], 3 * step_x[i]);
+        offsets_high[i] = _mm_add_epi32(offsets_low[i], _mm_set1_epi32(4 * step_x[i]));
+    }
+
+    for (int y = y0; y <= y1; y++)
+    {
+        __m128i rejected_low = clip_low;
+        __m128i rejected_high = clip_high;
+        for (int i = 0; i < 3; i++)
+        {
+            __m128i row = _mm_set1_epi32(base[i]);
+            rejected_low = _mm_or_si128(rejected_low, _mm_add_epi32(row, offsets_low[i]));
+            rejected_high = _mm_or_si128(rejected_high, _mm_add_epi32(row, offsets_high[i]));
+            base[i] += step_y[i];
+        }
+
+        rejected_low = _mm_srai_epi32(rejected_low, 31);
+        rejected_high = _mm_srai_epi32(rejected_high, 31);
+
+        __m128i *destination = (__m128i*)(pixels + (size_t)y * stride + block_x);
+        __m128i low = _mm_loadu_si128(destination);
+        __m128i high = _mm_loadu_si128(destination + 1);
+        low = _mm_or_si128(_mm_and_si128(rejected_low, low), _mm_andnot_si128(rejected_low, color));
+        high = _mm_or_si128(_mm_and_si128(rejected_high, high), _mm_andnot_si128(rejected_high, color));
+        _mm_storeu_si128(destination, low);
+        _mm_storeu_si128(destination + 1, high);
+    }
+#endif
+}
+#endif
+
+static void raster_triangle_in_tile(
+    const struct RasterTriangle *triangle,
+    struct RasterTarget *target,
+    int tile_x0, int tile_y0, int tile_x1, int tile_y1)
+{
+    int x0 = triangle->min_x > tile_x0 ? triangle->min_x : tile_x0;
+    int y0 = triangle->min_y > tile_y0 ? triangle->min_y : tile_y0;
+    int x1 = triangle->max_x < tile_x1 ? triangle->max_x : tile_x1;
+    int y1 = triangle->max_y < tile_y1 ? triangle->max_y : tile_y1;
+    if (x0 > x1 || y0 > y1)
+        return;
+
+    uint32_t *pixels = (uint32_t*)target->pixels;
+    const int stride = target->width;
+    const int block_last = RASTER_BLOCK_SIZE - 1;
+
+    for (int block_y = y0 & ~block_last; block_y <= y1; block_y += RASTER_BLOCK_SIZE)
+    {
+        int by0 = block_y > y0 ? block_y : y0;
+        int by1 = block_y + block_last < y1 ? block_y + block_last : y1;
+
+        for (int block_x = x0 & ~block_last; block_x <= x1; block_x += RASTER_BLOCK_SIZE)
+        {
+            int bx0 = block_x > x0 ? block_x : x0;
+            int bx1 = block_x + block_last < x1 ? block_x + block_last : x1;
+
+            int64_t edges[3];
+            bool crossing[3];
+            bool rejected = false;
+            bool accepted = true;
+            for (int i = 0; i < 3; i++)
+            {
+                edges[i] = triangle->step_x[i] * block_x + triangle->step_y[i] * block_y + triangle->c[i];
+
+                int64_t dx = triangle->step_x[i] * block_last;
+                int64_t dy = triangle->step_y[i] * block_last;
+                int64_t max = edges[i] + (dx > 0 ? dx : 0) + (dy > 0 ? dy : 0);
+                int64_t min = edges[i] + (dx < 0 ? dx : 0) + (dy < 0 ? dy : 0);
+
+                rejected |= max < 0;
+                accepted &= min >= 0;
+                crossing[i] = min < 0;
+            }
+
+            if (rejected)
+                continue;
+
+            if (accepted && triangle->flat)
+            {
+                for (int y = by0; y <= by1; y++)
+                {
+                    fill_span(pixels + (size_t)y * stride, bx0, bx1, triangle->color);
+                }
+                continue;
+            }
+
+#if defined(RASTER_SIMD_AVX2) || defined(RASTER_SIMD_SSE2)
+            if (triangle->small && triangle->flat && block_x + RASTER_BLOCK_SIZE <= target->width)
+            {
+                raster_block_simd(triangle, pixels, stride, bx0, by0, bx1, by1,
+                    edges, crossing, block_x, block_y);
+                continue;
+            }
+#endif
+
+            raster_block_scalar(triangle, pixels, stride, bx0, by0, bx1, by1,
+                edges, block_x, block_y);
+        }
+    }
+}
+
+// Rasterization task: one screen tile, drawing every chunk's triangles for
+// it in order.
+static void raster_tile(void *data, size_t task, int worker)
+{
+    PROFILE_BEGIN("raster_tile");
+    struct Rasterizer *rasterizer = (struct Rasterizer*)data;
+    struct RasterTarget *target = rasterizer->target;
+
+    int tile_x = (int)(task % (size_t)rasterizer->tiles_x);
+    int tile_y = (int)(task / (size_t)rasterizer->tiles_x);
+
+    int x0 = tile_x * RASTER_TILE_SIZE;
+    int y0 = tile_y * RASTER_TILE_SIZE;
+    int x1 = x0 + RASTER_TILE_SIZE - 1 < target->width ? x0 + RASTER_TILE_SIZE - 1 : target->width - 1;
+    int y1 = y0 + RASTER_TILE_SIZE - 1 < target->height ? y0 + RASTER_TILE_SIZE - 1 : target->height - 1;
+
+    for (int i = 0; i < rasterizer->chunk_count; i++)
+    {
+        const struct RasterChunk *chunk = &rasterizer->chunks[i];
+        const struct RasterBin *bin = &chunk->bins[task];
+        for (size_t j = 0; j < bin->count; j++)
+        {
+            raster_triangle_in_tile(&chunk->triangles[bin->triangles[j]], target, x0, y0, x1, y1);
+        }
+    }
+    PROFILE_END();
+}
+
+void end_raster_frame(struct Rasterizer *rasterizer)
+{
+    double start = get_monotonic_time();
+    run_thread_pool(rasterizer->pool, (size_t)rasterizer->chunk_count, bin_chunk, rasterizer);
+
+    double binned = get_monotonic_time();
+    run_thread_pool(rasterizer->pool, (size_t)rasterizer->bin_count, raster_tile, rasterizer);
+
+    double finished = get_monotonic_time();
+
+    size_t triangle_count = 0;
+    for (int i = 0; i < rasterizer->chunk_count; i++)
+    {
+        triangle_count += rasterizer->chunks[i].triangle_count;
+    }
+
+    LOG_INFO(
+        "CPU raster: %zu instances, %zu triangles | setup+bin %.2f ms | raster %.2f ms | %d threads, %d tiles",
+        rasterizer->instance_count,
+        triangle_count,
+        1000.0 * (binned - start),
+        1000.0 * (finished - binned),
+        rasterizer->pool != NULL ? rasterizer->pool->worker_count : 1,
+        rasterizer->bin_count
+    );
+}
\ No newline at end of file
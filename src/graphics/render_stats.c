@@ -0,0 +1,324 @@
+#include <common.h>
+#include <util.h>
+#include <core/log.h>
+#include <graphics/render_stats.h>
+
+#include <glad/glad.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+struct RenderCounters render_counters;
+
+void init_render_stats(struct RenderStats *stats, bool gpu_timing)
+{
+    memset(stats, 0, sizeof(struct RenderStats));
+    memset(&render_counters, 0, sizeof(struct RenderCounters));
+
+    stats->gpu_timing = gpu_timing;
+    if (gpu_timing)
+    {
+        glGenQueries(2 * RENDER_STATS_GPU_LATENCY, &stats->queries[0][0]);
+    }
+}
+
+void begin_render_stats_frame(struct RenderStats *stats)
+{
+    stats->frame_start = get_monotonic_time();
+
+    // Timestamps don't nest like GL_TIME_ELAPSED does, so they work inside
+    // profiler scopes.
+    stats->frame_timed = stats->gpu_timing && stats->pending_queries < RENDER_STATS_GPU_LATENCY;
+    if (stats->frame_timed)
+    {
+        int slot = (stats->first_query + stats->pending_queries) % RENDER_STATS_GPU_LATENCY;
+        glQueryCounter(stats->queries[slot][0], GL_TIMESTAMP);
+    }
+}
+
+static bool is_in_history(const struct RenderStats *stats, uint64_t frame)
+{
+    return frame < stats->frame_count && stats->frame_count - frame <= RENDER_STATS_HISTORY;
+}
+
+// Reads the GPU times of frames whose queries have completed, oldest first,
+// or of every frame with wait.
+static void resolve_gpu_times(struct RenderStats *stats, bool wait)
+{
+    while (stats->pending_queries > 0)
+    {
+        unsigned int *queries = stats->queries[stats->first_query];
+
+        unsigned int available = 0;
+        if (!wait)
+        {
+            glGetQueryObjectuiv(queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        }
+
+        if (!wait && !available)
+            break;
+
+        uint64_t begin = 0;
+        uint64_t end = 0;
+        glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &end);
+
+        uint64_t frame = stats->query_frames[stats->first_query];
+        if (is_in_history(stats, frame) && end >= begin)
+        {
+            stats->history[frame % RENDER_STATS_HISTORY].gpu_time = 1e-9 * (double)(end - begin);
+        }
+
+        stats->first_query = (stats->first_query + 1) % RENDER_STATS_GPU_LATENCY;
+        stats->pending_queries--;
+    }
+}
+
+static void add_counters(struct RenderCounters *sum, const struct RenderCounters *counters)
+{
+    sum->draw_calls += counters->draw_calls;
+    sum->triangles += counters->triangles;
+    sum->uniform_uploads += counters->uniform_uploads;
+    sum->buffer_bytes += counters->buffer_bytes;
+    sum->state_changes += counters->state_changes;
+    sum->tiles_culled += counters->tiles_culled;
+}
+
+static void write_dump_row(struct RenderStats *stats)
+{
+    struct FrameTimePercentiles cpu, gpu;
+    get_frame_time_percentiles(stats, false, &cpu);
+    get_frame_time_percentiles(stats, true, &gpu);
+
+    double frames = (double)stats->dump_frames;
+    const struct RenderCounters *sum = &stats->dump_counters;
+    uint64_t frame = stats->frame_count - 1;
+
+    if (stats->dump_format == RENDER_STATS_JSON)
+    {
+        fprintf(
+            stats->dump,
+            "{\"frame\":%llu,\"frames\":%u,\"draw_calls\":%.1f,\"triangles\":%.1f,"
+            "\"uniform_uploads\":%.1f,\"buffer_bytes\":%.1f,\"state_changes\":%.1f,"
+            "\"tiles_culled\":%.1f,\"cpu_ms\":{\"p50\":%.3f,\"p95\":%.3f,\"p99\":%.3f}",
+            (unsigned long long)frame, stats->dump_frames,
+            sum->draw_calls / frames, sum->triangles / frames,
+            sum->uniform_uploads / frames, sum->buffer_bytes / frames, sum->state_changes / frames,
+            sum->tiles_culled / frames,
+            1000.0 * cpu.p50, 1000.0 * cpu.p95, 1000.0 * cpu.p99
+        );
+
+        if (gpu.sample_count > 0)
+        {
+            fprintf(
+                stats->dump,
+                ",\"gpu_ms\":{\"p50\":%.3f,\"p95\":%.3f,\"p99\":%.3f}}\n",
+                1000.0 * gpu.p50, 1000.0 * gpu.p95, 1000.0 * gpu.p99
+            );
+        }
+
+        else
+        {
+            fprintf(stats->dump, ",\"gpu_ms\":null}\n");
+        }
+    }
+
+    else
+    {
+        fprintf(
+            stats->dump,
+            "%llu,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.3f,%.3f,%.3f",
+            (unsigned long long)frame, stats->dump_frames,
+            sum->draw_calls / frames, sum->triangles / frames,
+            sum->uniform_uploads / frames, sum->buffer_bytes / frames, sum->state_changes / frames,
+            sum->tiles_culled / frames,
+            1000.0 * cpu.p50, 1000.0 * cpu.p95, 1000.0 * cpu.p99
+        );
+
+        if (gpu.sample_count > 0)
+        {
+            fprintf(stats->dump, ",%.3f,%.3f,%.3f\n", 1000.0 * gpu.p50, 1000.0 * gpu.p95, 1000.0 * gpu.p99);
+        }
+
+        else
+        {
+            fprintf(stats->dump, ",,,\n");
+        }
+    }
+
+    // Flushed so monitoring can follow the file while the program runs.
+    fflush(stats->dump);
+    memset(&stats->dump_counters, 0, sizeof(struct RenderCounters));
+    stats->dump_frames = 0;
+}
+
+void end_render_stats_frame(struct RenderStats *stats)
+{
+    if (stats->frame_timed)
+    {
+        int slot = (stats->first_query + stats->pending_queries) % RENDER_STATS_GPU_LATENCY;
+        glQueryCounter(stats->queries[slot][1], GL_TIMESTAMP);
+        stats->query_frames[slot] = stats->frame_count;
+        stats->pending_queries++;
+    }
+
+    struct FrameStats *entry = &stats->history[stats->frame_count % RENDER_STATS_HISTORY];
+    entry->frame = stats->frame_count;
+    entry->counters = render_counters;
+    entry->cpu_time = get_monotonic_time() - stats->frame_start;
+    entry->gpu_time = -1.0;
+    stats->frame_count++;
+
+    memset(&render_counters, 0, sizeof(struct RenderCounters));
+
+    if (stats->gpu_timing)
+    {
+        resolve_gpu_times(stats, false);
+    }
+
+    if (stats->dump != NULL)
+    {
+        add_counters(&stats->dump_counters, &entry->counters);
+        if (++stats->dump_frames == stats->dump_interval)
+        {
+            write_dump_row(stats);
+        }
+    }
+}
+
+void destroy_render_stats(struct RenderStats *stats)
+{
+    // The last frames' GPU times are waited for, so the final row has them.
+    if (stats->gpu_timing)
+    {
+        resolve_gpu_times(stats, true);
+        glDeleteQueries(2 * RENDER_STATS_GPU_LATENCY, &stats->queries[0][0]);
+    }
+
+    if (stats->dump != NULL)
+    {
+        if (stats->dump_frames > 0)
+        {
+            write_dump_row(stats);
+        }
+        fclose(stats->dump);
+    }
+
+    memset(stats, 0, sizeof(struct RenderStats));
+}
+
+const struct FrameStats* get_frame_stats(const struct RenderStats *stats, uint64_t frame)
+{
+    return is_in_history(stats, frame) ? &stats->history[frame % RENDER_STATS_HISTORY] : NULL;
+}
+
+const struct FrameStats* get_latest_frame_stats(const struct RenderStats *stats)
+{
+    return stats->frame_count > 0 ? get_frame_stats(stats, stats->frame_count - 1) : NULL;
+}
+
+static int compare_times(const void *a, const void *b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank, so every percentile is a frame time that occurred.
+static double get_percentile(const double *sorted, int count, int percent)
+{
+    int rank = (percent * count + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+void get_frame_time_percentiles(const struct RenderStats *stats, bool gpu, struct FrameTimePercentiles *percentiles)
+{
+    double times[RENDER_STATS_HISTORY];
+    int count = 0;
+
+    uint64_t first = stats->frame_count > RENDER_STATS_HISTORY ? stats->frame_count - RENDER_STATS_HISTORY : 0;
+    for (uint64_t frame = first; frame < stats->frame_count; frame++)
+    {
+        const struct FrameStats *entry = &stats->history[frame % RENDER_STATS_HISTORY];
+        double time = gpu ? entry->gpu_time : entry->cpu_time;
+        if (time >= 0.0)
+        {
+            times[count++] = time;
+        }
+    }
+
+    memset(percentiles, 0, sizeof(struct FrameTimePercentiles));
+    percentiles->sample_count = count;
+    if (count == 0)
+        return;
+
+    qsort(times, (size_t)count, sizeof(double), compare_times);
+    percentiles->p50 = get_percentile(times, count, 50);
+    percentiles->p95 = get_percentile(times, count, 95);
+    percentiles->p99 = get_percentile(times, count, 99);
+}
+
+bool open_render_stats_dump(struct RenderStats *stats, const char *path, unsigned int interval)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        LOG_ERROR("Failed to create render stats file %s", path);
+        return false;
+    }
+
+    size_t length = strlen(path);
+    stats->dump = file;
+    stats->dump_format = length >= 5 && strcmp(path + length - 5, ".json") == 0
+        ? RENDER_STATS_JSON
+        : RENDER_STATS_CSV;
+    stats->dump_interval = interval > 0 ? interval : 1;
+    stats->dump_frames = 0;
+    memset(&stats->dump_counters, 0, sizeof(struct RenderCounters));
+
+    if (stats->dump_format == RENDER_STATS_CSV)
+    {
+        fprintf(
+            file,
+            "frame,frames,draw_calls,triangles,uniform_uploads,buffer_bytes,state_changes,tiles_culled,"
+            "cpu_p50_ms,cpu_p95_ms,cpu_p99_ms,gpu_p50_ms,gpu_p95_ms,gpu_p99_ms\n"
+        );
+    }
+
+    return true;
+}
+
+void log_render_stats(const struct RenderStats *stats)
+{
+    const struct FrameStats *latest = get_latest_frame_stats(stats);
+    if (latest == NULL)
+        return;
+
+    struct FrameTimePercentiles cpu, gpu;
+    get_frame_time_percentiles(stats, false, &cpu);
+    get_frame_time_percentiles(stats, true, &gpu);
+
+    LOG_INFO(
+        "Last frame: %llu draws, %llu triangles, %llu uniform uploads, %llu buffer bytes, %llu state changes, "
+        "%llu tiles culled",
+        (unsigned long long)latest->counters.draw_calls,
+        (unsigned long long)latest->counters.triangles,
+        (unsigned long long)latest->counters.uniform_uploads,
+        (unsigned long long)latest->counters.buffer_bytes,
+        (unsigned long long)latest->counters.state_changes,
+        (unsigned long long)latest->counters.tiles_culled
+    );
+
+    LOG_INFO(
+        "CPU frame time over %d frames: p50 %.2f ms | p95 %.2f ms | p99 %.2f ms",
+        cpu.sample_count, 1000.0 * cpu.p50, 1000.0 * cpu.p95, 1000.0 * cpu.p99
+    );
+
+    if (gpu.sample_count > 0)
+    {
+        LOG_INFO(
+            "GPU frame time over %d frames: p50 %.2f ms | p95 %.2f ms | p99 %.2f ms",
+            gpu.sample_count, 1000.0 * gpu.p50, 1000.0 * gpu.p95, 1000.0 * gpu.p99
+        );
+    }
+}
\ No newline at end of file
@@ -1,11 +1,161 @@
+#define MEMORY_TAG MEMORY_TAG_SHADER
+
 #include <common.h>
 #include <memory.h>
+#include <util.h>
 #include <core/log.h>
+#include <core/profile.h>
+#include <graphics/render_stats.h>
 #include <graphics/shader.h>
 
 #include <glad/glad.h>
 
-unsigned int create_shader(const char *vertex_source, const char *fragment_source)
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+#endif
+
+#define SHADER_CACHE_MAGIC   0x50534c54u
+#define SHADER_CACHE_VERSION 1
+#define SHADER_CACHE_PATH_SIZE 512
+
+// Precedes the driver's binary in each cache file.
+struct ShaderCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+};
+
+static const char *shader_cache_directory = NULL;
+static struct ShaderCacheStats shader_cache_stats;
+
+static uint32_t hash_name(const char *name)
+{
+    // FNV-1a.
+    uint32_t hash = 2166136261u;
+    for (; *name != '\0'; name++)
+    {
+        hash ^= (uint8_t)*name;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static struct ShaderVariable* find_variable(
+    struct ShaderVariable *table,
+    int capacity,
+    const char *name,
+    uint32_t hash)
+{
+    if (capacity == 0)
+        return NULL;
+
+    int mask = capacity - 1;
+    for (int i = (int)(hash & (uint32_t)mask); ; i = (i + 1) & mask)
+    {
+        struct ShaderVariable *variable = &table[i];
+        if (variable->location == -1)
+            return NULL;
+
+        if (variable->hash == hash && strcmp(variable->name, name) == 0)
+            return variable;
+    }
+}
+
+static void insert_variable(struct ShaderVariable *table, int capacity, const struct ShaderVariable *variable)
+{
+    int mask = capacity - 1;
+    int i = (int)(variable->hash & (uint32_t)mask);
+    while (table[i].location != -1)
+    {
+        i = (i + 1) & mask;
+    }
+
+    table[i] = *variable;
+}
+
+static int get_table_capacity(int count)
+{
+    // Keep the load factor at or below one half so probes stay short.
+    int capacity = 8;
+    while (capacity < 2 * count)
+    {
+        capacity *= 2;
+    }
+
+    return capacity;
+}
+
+static struct ShaderVariable* reflect_variables(
+    unsigned int program,
+    bool uniforms,
+    int *capacity,
+    int *count)
+{
+    int active_count = 0;
+    glGetProgramiv(program, uniforms ? GL_ACTIVE_UNIFORMS : GL_ACTIVE_ATTRIBUTES, &active_count);
+
+    *capacity = get_table_capacity(active_count);
+    *count = 0;
+
+    struct ShaderVariable *table = ALLOC_ARRAY(struct ShaderVariable, *capacity);
+    for (int i = 0; i < *capacity; i++)
+    {
+        table[i].location = -1;
+    }
+
+    for (int i = 0; i < active_count; i++)
+    {
+        struct ShaderVariable variable;
+        memset(&variable, 0, sizeof(struct ShaderVariable));
+
+        int length = 0;
+        GLenum type;
+        if (uniforms)
+        {
+            glGetActiveUniform(program, (unsigned int)i, SHADER_NAME_MAX_LENGTH, &length,
+                &variable.size, &type, variable.name);
+        }
+
+        else
+        {
+            glGetActiveAttrib(program, (unsigned int)i, SHADER_NAME_MAX_LENGTH, &length,
+                &variable.size, &type, variable.name);
+        }
+        variable.type = type;
+
+        // Arrays are reported as "name[0]"; store them under the plain name.
+        char *bracket = strchr(variable.name, '[');
+        if (bracket != NULL)
+        {
+            *bracket = '\0';
+        }
+
+        variable.location = uniforms
+            ? glGetUniformLocation(program, variable.name)
+            : glGetAttribLocation(program, variable.name);
+
+        // Uniform block members and built-ins have no location of their own.
+        if (variable.location < 0)
+            continue;
+
+        variable.hash = hash_name(variable.name);
+        insert_variable(table, *capacity, &variable);
+        (*count)++;
+    }
+
+    return table;
+}
+
+// retrievable asks the driver to keep the binary for glGetProgramBinary.
+static unsigned int create_program(const char *vertex_source, const char *fragment_source, bool retrievable)
 {
     unsigned int shader_program = glCreateProgram();
     
@@ -53,6 +203,10 @@ unsigned int create_shader(const char *vertex_source, const char *fragment_sourc
 
     glAttachShader(shader_program, shaders[0]);
     glAttachShader(shader_program, shaders[1]);
+    if (retrievable)
+    {
+        glProgramParameteri(shader_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glLinkProgram(shader_program);
 
     glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
@@ -77,5 +231,357 @@ unsigned int create_shader(const char *vertex_source, const char *fragment_sourc
     glDetachShader(shader_program, shaders[0]);
     glDeleteShader(shaders[0]);
 
+    if (!success)
+    {
+        glDeleteProgram(shader_program);
+        return 0;
+    }
+
     return shader_program;
+}
+
+void set_shader_cache_directory(const char *directory)
+{
+    shader_cache_directory = directory;
+}
+
+const struct ShaderCacheStats* get_shader_cache_stats()
+{
+    return &shader_cache_stats;
+}
+
+static bool is_shader_cache_enabled()
+{
+    if (shader_cache_directory == NULL || !GLAD_GL_ARB_get_program_binary)
+        return false;
+
+    int format_count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+    return format_count > 0;
+}
+
+// glProgramBinary raises an error for formats the driver does not list, so
+// those are turned away before reaching it.
+static bool is_binary_format_supported(uint32_t format)
+{
+    int format_count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+
+    int *formats = ALLOC_ARRAY(int, format_count);
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats);
+
+    bool supported = false;
+    for (int i = 0; i < format_count; i++)
+    {
+        supported = supported || (uint32_t)formats[i] == format;
+    }
+
+    FREE_ARRAY(formats, int, format_count);
+    return supported;
+}
+
+static uint64_t hash_string(uint64_t hash, const char *text)
+{
+    // FNV-1a, including the terminator so adjacent strings can't run
+    // together.
+    text = text != NULL ? text : "";
+    do
+    {
+        hash ^= (uint8_t)*text;
+        hash *= 1099511628211ull;
+    } while (*text++ != '\0');
+
+    return hash;
+}
+
+// A driver update changes the version string, so its binaries are never
+// offered to the new driver.
+static uint64_t get_program_key(const char *vertex_source, const char *fragment_source)
+{
+    uint64_t hash = 14695981039346656037ull;
+    hash = hash_string(hash, (const char*)glGetString(GL_VENDOR));
+    hash = hash_string(hash, (const char*)glGetString(GL_RENDERER));
+    hash = hash_string(hash, (const char*)glGetString(GL_VERSION));
+    hash = hash_string(hash, vertex_source);
+    hash = hash_string(hash, fragment_source);
+    return hash;
+}
+
+// Returns 0 when there is no usable entry at path.
+static unsigned int load_cached_program(const char *path, uint64_t key)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return 0;
+
+    struct ShaderCacheHeader header;
+    bool valid = fread(&header, sizeof(struct ShaderCacheHeader), 1, file) == 1 &&
+        header.magic == SHADER_CACHE_MAGIC &&
+        header.version == SHADER_CACHE_VERSION &&
+        header.key == key &&
+        header.length > 0;
+
+    uint8_t *binary = NULL;
+    if (valid)
+    {
+        binary = ALLOC_ARRAY(uint8_t, header.length);
+        valid = fread(binary, header.length, 1, file) == 1 && is_binary_format_supported(header.format);
+    }
+    fclose(file);
+
+    unsigned int program = 0;
+    if (valid)
+    {
+        program = glCreateProgram();
+        glProgramBinary(program, header.format, binary, (int)header.length);
+
+        int success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+
+    if (binary != NULL)
+    {
+        FREE_ARRAY(binary, uint8_t, header.length);
+    }
+
+    if (program == 0)
+    {
+        LOG_WARN("Shader cache entry %s is stale or invalid, compiling from source", path);
+        shader_cache_stats.rejected++;
+    }
+
+    return program;
+}
+
+static void make_directory(const char *path)
+{
+#ifdef _WIN32
+    _mkdir(path);
+#else
+    mkdir(path, 0755);
+#endif
+}
+
+static void store_program_binary(unsigned int program, const char *path, uint64_t key)
+{
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    uint8_t *binary = ALLOC_ARRAY(uint8_t, length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, NULL, &format, binary);
+
+    struct ShaderCacheHeader header = {
+        SHADER_CACHE_MAGIC, SHADER_CACHE_VERSION, key, format, (uint32_t)length
+    };
+
+    // Written under another name and renamed into place, so a run that
+    // starts meanwhile never reads half an entry.
+    char temporary_path[SHADER_CACHE_PATH_SIZE + 4];
+    snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", path);
+    make_directory(shader_cache_directory);
+
+    FILE *file = fopen(temporary_path, "wb");
+    bool written = file != NULL &&
+        fwrite(&header, sizeof(struct ShaderCacheHeader), 1, file) == 1 &&
+        fwrite(binary, (size_t)length, 1, file) == 1;
+    if (file != NULL)
+    {
+        written = fclose(file) == 0 && written;
+    }
+
+#ifdef _WIN32
+    remove(path);
+#endif
+    if (!written || rename(temporary_path, path) != 0)
+    {
+        LOG_WARN("Failed to write shader cache entry %s", path);
+        remove(temporary_path);
+    }
+
+    FREE_ARRAY(binary, uint8_t, length);
+}
+
+bool set_shader_block_binding(struct Shader *shader, const char *name, unsigned int binding)
+{
+    unsigned int index = glGetUniformBlockIndex(shader->program, name);
+    if (index == GL_INVALID_INDEX)
+        return false;
+
+    glUniformBlockBinding(shader->program, index, binding);
+    return true;
+}
+
+bool create_shader(struct Shader *shader, const char *vertex_source, const char *fragment_source)
+{
+    PROFILE_BEGIN("create_shader");
+    memset(shader, 0, sizeof(struct Shader));
+    double start = get_monotonic_time();
+
+    bool cached = is_shader_cache_enabled();
+    uint64_t key = 0;
+    char path[SHADER_CACHE_PATH_SIZE];
+    if (cached)
+    {
+        key = get_program_key(vertex_source, fragment_source);
+        snprintf(path, sizeof(path), "%s/%016llx.bin", shader_cache_directory, (unsigned long long)key);
+        shader->program = load_cached_program(path, key);
+    }
+
+    if (shader->program != 0)
+    {
+        LOG_TRACE("Loaded program %016llx from the shader cache", (unsigned long long)key);
+        shader_cache_stats.loaded++;
+        shader_cache_stats.load_time += get_monotonic_time() - start;
+    }
+
+    else
+    {
+        shader->program = create_program(vertex_source, fragment_source, cached);
+        if (shader->program == 0)
+        {
+            PROFILE_END();
+            return false;
+        }
+
+        if (cached)
+        {
+            store_program_binary(shader->program, path, key);
+        }
+
+        shader_cache_stats.compiled++;
+        shader_cache_stats.compile_time += get_monotonic_time() - start;
+    }
+
+    // Bindings set after linking are not part of a program binary, so a
+    // program from the cache needs them as much as a new one.
+    set_shader_block_binding(shader, "View", SHADER_VIEW_BINDING);
+    set_shader_block_binding(shader, "Material", SHADER_MATERIAL_BINDING);
+
+    shader->uniforms = reflect_variables(
+        shader->program,
+        true,
+        &shader->uniform_capacity,
+        &shader->uniform_count
+    );
+
+    shader->attributes = reflect_variables(
+        shader->program,
+        false,
+        &shader->attribute_capacity,
+        &shader->attribute_count
+    );
+
+    PROFILE_END();
+    return true;
+}
+
+void destroy_shader(struct Shader *shader)
+{
+    if (shader->uniforms != NULL)
+    {
+        FREE_ARRAY(shader->uniforms, struct ShaderVariable, shader->uniform_capacity);
+    }
+
+    if (shader->attributes != NULL)
+    {
+        FREE_ARRAY(shader->attributes, struct ShaderVariable, shader->attribute_capacity);
+    }
+
+    glDeleteProgram(shader->program);
+    memset(shader, 0, sizeof(struct Shader));
+}
+
+void bind_shader(const struct Shader *shader)
+{
+    glUseProgram(shader->program);
+    render_counters.state_changes++;
+}
+
+struct ShaderVariable* get_shader_uniform(struct Shader *shader, const char *name)
+{
+    return find_variable(shader->uniforms, shader->uniform_capacity, name, hash_name(name));
+}
+
+struct ShaderVariable* get_shader_attribute(struct Shader *shader, const char *name)
+{
+    return find_variable(shader->attributes, shader->attribute_capacity, name, hash_name(name));
+}
+
+// Returns true when the value differs from the last upload and has been
+// stored as the new cached value, which the caller then uploads.
+static bool update_cached_value(struct ShaderVariable *uniform, const void *value, size_t size)
+{
+    if (uniform->cached && memcmp(&uniform->value, value, size) == 0)
+        return false;
+
+    memcpy(&uniform->value, value, size);
+    uniform->cached = true;
+    render_counters.uniform_uploads++;
+    return true;
+}
+
+void set_shader_int(struct ShaderVariable *uniform, int value)
+{
+    if (uniform != NULL && update_cached_value(uniform, &value, sizeof(int)))
+    {
+        glUniform1i(uniform->location, value);
+    }
+}
+
+void set_shader_float(struct ShaderVariable *uniform, float value)
+{
+    if (uniform != NULL && update_cached_value(uniform, &value, sizeof(float)))
+    {
+        glUniform1f(uniform->location, value);
+    }
+}
+
+void set_shader_vec2(struct ShaderVariable *uniform, const float *value)
+{
+    if (uniform != NULL && update_cached_value(uniform, value, 2 * sizeof(float)))
+    {
+        glUniform2fv(uniform->location, 1, value);
+    }
+}
+
+void set_shader_vec3(struct ShaderVariable *uniform, const float *value)
+{
+    if (uniform != NULL && update_cached_value(uniform, value, 3 * sizeof(float)))
+    {
+        glUniform3fv(uniform->location, 1, value);
+    }
+}
+
+void set_shader_vec4(struct ShaderVariable *uniform, const float *value)
+{
+    if (uniform != NULL && update_cached_value(uniform, value, 4 * sizeof(float)))
+    {
+        glUniform4fv(uniform->location, 1, value);
+    }
+}
+
+void set_shader_mat4(struct ShaderVariable *uniform, const float *value)
+{
+    if (uniform != NULL && update_cached_value(uniform, value, 16 * sizeof(float)))
+    {
+        glUniformMatrix4fv(uniform->location, 1, GL_FALSE, value);
+    }
+}
+
+void set_shader_vec4_array(struct ShaderVariable *uniform, const float *values, int count)
+{
+    if (uniform != NULL)
+    {
+        uniform->cached = false;
+        render_counters.uniform_uploads++;
+        glUniform4fv(uniform->location, count, values);
+    }
 }
\ No newline at end of file
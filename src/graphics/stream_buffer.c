@@ -0,0 +1,214 @@
+#include <common.h>
+#include <core/log.h>
+#include <core/profile.h>
+#include <graphics/render_stats.h>
+#include <graphics/stream_buffer.h>
+
+#include <glad/glad.h>
+
+#include <string.h>
+
+// Regions start on this boundary, which suits every attribute type.
+#define STREAM_BUFFER_ALIGNMENT 256
+
+static size_t align_region_size(size_t size)
+{
+    size = size > 0 ? size : 1;
+    return (size + STREAM_BUFFER_ALIGNMENT - 1) / STREAM_BUFFER_ALIGNMENT * STREAM_BUFFER_ALIGNMENT;
+}
+
+static bool create_storage(struct StreamBuffer *stream)
+{
+    size_t size = STREAM_BUFFER_REGIONS * stream->region_size;
+    glGenBuffers(1, &stream->buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+
+    stream->persistent = GLAD_GL_ARB_buffer_storage != 0;
+    if (!stream->persistent)
+    {
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)size, NULL, GL_STREAM_DRAW);
+        return true;
+    }
+
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_ARRAY_BUFFER, (GLsizeiptr)size, NULL, flags);
+    stream->mapping = (uint8_t*)glMapBufferRange(GL_ARRAY_BUFFER, 0, (GLsizeiptr)size, flags);
+    if (stream->mapping == NULL)
+    {
+        LOG_ERROR("Failed to map a %zu byte stream buffer", size);
+        return false;
+    }
+
+    return true;
+}
+
+// GL keeps the storage alive until draws already submitted are done with
+// it, so nothing needs to wait here.
+static void release_storage(struct StreamBuffer *stream)
+{
+    for (int i = 0; i < STREAM_BUFFER_REGIONS; i++)
+    {
+        if (stream->fences[i] != NULL)
+        {
+            glDeleteSync((GLsync)stream->fences[i]);
+            stream->fences[i] = NULL;
+        }
+    }
+
+    if (stream->mapping != NULL)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        stream->mapping = NULL;
+    }
+
+    glDeleteBuffers(1, &stream->buffer);
+    stream->buffer = 0;
+}
+
+bool init_stream_buffer(struct StreamBuffer *stream, size_t region_size)
+{
+    memset(stream, 0, sizeof(struct StreamBuffer));
+    stream->region_size = align_region_size(region_size);
+
+    // The first map moves on to region 0.
+    stream->region = STREAM_BUFFER_REGIONS - 1;
+
+    if (!create_storage(stream))
+    {
+        release_storage(stream);
+        return false;
+    }
+
+    LOG_TRACE(
+        "Stream buffer of %d x %zu bytes, %s",
+        STREAM_BUFFER_REGIONS, stream->region_size,
+        stream->persistent ? "persistently mapped" : "mapped per region"
+    );
+    return true;
+}
+
+void destroy_stream_buffer(struct StreamBuffer *stream)
+{
+    if (stream->buffer == 0)
+        return;
+
+    LOG_TRACE(
+        "Stream buffer: %zu regions written, %zu waited for the GPU",
+        stream->write_count, stream->stall_count
+    );
+    release_storage(stream);
+    memset(stream, 0, sizeof(struct StreamBuffer));
+}
+
+static void wait_for_region(struct StreamBuffer *stream, int region)
+{
+    GLsync fence = (GLsync)stream->fences[region];
+    if (fence == NULL)
+        return;
+
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+    {
+        PROFILE_BEGIN("wait_for_stream_region");
+        stream->stall_count++;
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        while (status == GL_TIMEOUT_EXPIRED)
+        {
+            status = glClientWaitSync(fence, 0, 1000000000);
+        }
+        PROFILE_END();
+    }
+
+    if (status == GL_WAIT_FAILED)
+    {
+        LOG_ERROR("Waiting for stream region %d failed", region);
+    }
+
+    glDeleteSync(fence);
+    stream->fences[region] = NULL;
+}
+
+// The contents are not kept; every region is rewritten before it is drawn
+// from again.
+static bool grow_stream_buffer(struct StreamBuffer *stream, size_t size)
+{
+    size_t region_size = align_region_size(size);
+    region_size = region_size > 2 * stream->region_size ? region_size : 2 * stream->region_size;
+
+    LOG_TRACE("Growing stream buffer regions from %zu to %zu bytes", stream->region_size, region_size);
+    release_storage(stream);
+    stream->region_size = region_size;
+    stream->region = STREAM_BUFFER_REGIONS - 1;
+    if (create_storage(stream))
+        return true;
+
+    // Without storage the next map grows again rather than handing out
+    // memory that is not there.
+    release_storage(stream);
+    stream->region_size = 0;
+    stream->persistent = false;
+    return false;
+}
+
+void* map_stream_region(struct StreamBuffer *stream, size_t size)
+{
+    if (size > stream->region_size && !grow_stream_buffer(stream, size))
+        return NULL;
+
+    if (stream->buffer == 0)
+        return NULL;
+
+    stream->region = (stream->region + 1) % STREAM_BUFFER_REGIONS;
+    wait_for_region(stream, stream->region);
+    stream->write_count++;
+    render_counters.buffer_bytes += size;
+
+    size_t offset = get_stream_region_offset(stream);
+    if (stream->persistent)
+        return stream->mapping + offset;
+
+    // The region's own fence has already been waited on, so GL does not
+    // need to synchronise the mapping.
+    glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+    void *memory = glMapBufferRange(
+        GL_ARRAY_BUFFER,
+        (GLintptr)offset,
+        (GLsizeiptr)stream->region_size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+    );
+
+    if (memory == NULL)
+    {
+        LOG_ERROR("Failed to map stream region %d", stream->region);
+    }
+
+    return memory;
+}
+
+void unmap_stream_region(struct StreamBuffer *stream)
+{
+    if (stream->persistent)
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+    if (!glUnmapBuffer(GL_ARRAY_BUFFER))
+    {
+        LOG_WARN("Stream region %d was lost while mapped", stream->region);
+    }
+}
+
+size_t get_stream_region_offset(const struct StreamBuffer *stream)
+{
+    return (size_t)stream->region * stream->region_size;
+}
+
+void fence_stream_region(struct StreamBuffer *stream)
+{
+    if (stream->fences[stream->region] != NULL)
+    {
+        glDeleteSync((GLsync)stream->fences[stream->region]);
+    }
+
+    stream->fences[stream->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
\ No newline at end of file
@@ -0,0 +1,752 @@
+#define MEMORY_TAG MEMORY_TAG_GEOMETRY
+
+#include <common.h>
+#include <memory.h>
+#include <core/assert.h>
+#include <core/log.h>
+#include <core/profile.h>
+#include <graphics/render_stats.h>
+#include <graphics/shader.h>
+#include <graphics/tile_renderer.h>
+
+#include <cglm/call.h>
+#include <glad/glad.h>
+
+#include <float.h>
+#include <string.h>
+
+#define STRINGIFY(x) #x
+#define TO_STRING(x) STRINGIFY(x)
+
+// Positions and colours arrive in a PackedMeshes format: position_transform
+// holds the scale and offset that decode positions, and with palette_colors
+// set the colour attribute's first component is an index into palette.
+// These only change with the meshes, so every program reads them from one
+// Material block.
+#define TILE_VERTEX_INPUTS \
+    "layout(location = 0) in vec2 a_Pos;\n" \
+    "layout(location = 1) in vec4 a_Color;\n" \
+    SHADER_VIEW_BLOCK \
+    "layout(std140) uniform Material {\n" \
+    "  vec4 position_transform;\n" \
+    "  vec4 palette[" TO_STRING(MESH_PALETTE_MAX_COLORS) "];\n" \
+    "  bool palette_colors;\n" \
+    "};\n" \
+    "vec2 get_position() {\n" \
+    "  return a_Pos * position_transform.xy + position_transform.zw;\n" \
+    "}\n" \
+    "vec4 get_color() {\n" \
+    "  return palette_colors ? palette[int(a_Color.x)] : a_Color;\n" \
+    "}\n"
+
+static const char *instanced_vertex_source =
+    "#version 330 core\n"
+    TILE_VERTEX_INPUTS
+    "layout(location = 2) in vec4 a_Linear;\n"
+    "layout(location = 3) in vec2 a_Offset;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "  vec2 position = mat2(a_Linear.xy, a_Linear.zw) * get_position() + a_Offset;\n"
+    "  color = get_color();\n"
+    "  gl_Position = projection * view * vec4(position, 0.0, 1.0);\n"
+    "}";
+
+static const char *per_tile_vertex_source =
+    "#version 330 core\n"
+    TILE_VERTEX_INPUTS
+    "out vec4 color;\n"
+    "uniform mat4 model;\n"
+    "void main() {\n"
+    "  color = get_color();\n"
+    "  gl_Position = projection * view * model * vec4(get_position(), 0.0, 1.0);\n"
+    "}";
+
+// Places tiles from gl_InstanceID and the TileLattice block; see
+// LatticeDraw. Tiles outside lattice_region get all their vertices moved
+// outside the clip volume, so they make no fragments.
+static const char *procedural_vertex_source =
+    "#version 330 core\n"
+    TILE_VERTEX_INPUTS
+    "layout(std140) uniform TileLattice {\n"
+    "  vec4 lattice_linear;\n"
+    "  vec4 lattice_steps;\n"
+    "  vec4 lattice_offset;\n"
+    "  vec4 lattice_bounds;\n"
+    "  vec4 lattice_region;\n"
+    "  ivec4 lattice_cells;\n"
+    "};\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "  int column = lattice_cells.x + gl_InstanceID % lattice_cells.z;\n"
+    "  int row = lattice_cells.y + gl_InstanceID / lattice_cells.z;\n"
+    "  vec2 cell = float(column) * lattice_steps.xy + float(row) * lattice_steps.zw;\n"
+    "  vec2 center = cell + lattice_bounds.xy;\n"
+    "  float radius = lattice_bounds.z;\n"
+    "  color = get_color();\n"
+    "  if (center.x + radius < lattice_region.x || center.x - radius > lattice_region.z ||\n"
+    "      center.y + radius < lattice_region.y || center.y - radius > lattice_region.w) {\n"
+    "    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);\n"
+    "    return;\n"
+    "  }\n"
+    "  vec2 position = mat2(lattice_linear.xy, lattice_linear.zw) * get_position() + (cell + lattice_offset.xy);\n"
+    "  gl_Position = projection * view * vec4(position, 0.0, 1.0);\n"
+    "}";
+
+// The TileLattice block as std140 lays it out.
+struct LatticeBlock
+{
+    float linear[4];
+    float steps[4];
+    float offset[4];
+    float bounds[4];
+    float region[4];
+    int32_t cells[4];
+};
+
+// The View and Material blocks as std140 lays them out, block sizes
+// rounded up to a whole vec4 as std140 rounds them.
+struct ViewBlock
+{
+    float view[16];
+    float projection[16];
+};
+
+struct MaterialBlock
+{
+    float position_transform[4];
+    float palette[MESH_PALETTE_MAX_COLORS][4];
+    int32_t palette_colors;
+    int32_t padding[3];
+};
+
+static const char *fragment_source =
+    "#version 330 core\n"
+    "in vec4 color;\n"
+    "out vec4 pixel;\n"
+    "void main() {\n"
+    "  pixel = color;\n"
+    "}";
+
+// Instances start at base bytes into buffer.
+static void set_instance_attributes(struct TileRenderer *renderer, int mesh, unsigned int buffer, size_t base)
+{
+    glBindVertexArray(renderer->vao[mesh]);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    // There is no base instance in GL 3.3, so each mesh's attributes
+    // point straight at the start of its own range in the shared buffer.
+    size_t first = base + renderer->instance_first[mesh] * sizeof(struct TileInstance);
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(
+        2,
+        4,
+        GL_FLOAT,
+        GL_FALSE,
+        sizeof(struct TileInstance),
+        (void*)(first + offsetof(struct TileInstance, linear))
+    );
+    glVertexAttribDivisor(2, 1);
+
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(
+        3,
+        2,
+        GL_FLOAT,
+        GL_FALSE,
+        sizeof(struct TileInstance),
+        (void*)(first + offsetof(struct TileInstance, offset))
+    );
+    glVertexAttribDivisor(3, 1);
+}
+
+// Every shader decodes the vertices the same way.
+static void upload_material(struct TileRenderer *renderer, const struct PackedMeshes *packed)
+{
+    struct MaterialBlock block = {
+        .position_transform = {
+            packed->position_scale[0], packed->position_scale[1],
+            packed->position_offset[0], packed->position_offset[1]
+        },
+        .palette_colors = packed->format.color == VERTEX_COLOR_PALETTE
+    };
+    memcpy(block.palette, packed->palette, sizeof(block.palette));
+
+    glGenBuffers(1, &renderer->material_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, renderer->material_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(block), &block, GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    render_counters.buffer_bytes += sizeof(block);
+}
+
+// All meshes share one vertex and one index buffer; each has its own vertex
+// array only because the instance attributes point at its own range.
+static bool upload_tile_meshes(
+    struct TileRenderer *renderer,
+    const struct TileMesh *meshes,
+    int mesh_count,
+    const struct VertexFormat *format)
+{
+    struct PackedMeshes packed;
+    if (!pack_tile_meshes(&packed, meshes, mesh_count, format))
+    {
+        LOG_ERROR("Failed to pack tile meshes!");
+        return false;
+    }
+
+    glGenVertexArrays(mesh_count, renderer->vao);
+    glGenBuffers(1, &renderer->vertex_buffer);
+    glGenBuffers(1, &renderer->index_buffer);
+
+    glBindBuffer(GL_ARRAY_BUFFER, renderer->vertex_buffer);
+    glBufferData(
+        GL_ARRAY_BUFFER,
+        packed.vertex_count * packed.vertex_size,
+        packed.vertices,
+        GL_STATIC_DRAW
+    );
+    render_counters.buffer_bytes += packed.vertex_count * packed.vertex_size;
+
+    // The element buffer binding belongs to the vertex array, so the data
+    // goes in through the first one.
+    renderer->index_type = packed.index_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    for (int i = 0; i < mesh_count; i++)
+    {
+        glBindVertexArray(renderer->vao[i]);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, renderer->index_buffer);
+        if (i == 0)
+        {
+            glBufferData(
+                GL_ELEMENT_ARRAY_BUFFER,
+                packed.index_count * packed.index_size,
+                packed.indices,
+                GL_STATIC_DRAW
+            );
+            render_counters.buffer_bytes += packed.index_count * packed.index_size;
+        }
+
+        // snorm16 positions are read as plain integers and scaled in the
+        // shader, which avoids the two conventions for normalising them.
+        static const GLenum position_types[] = { GL_FLOAT, GL_SHORT, GL_HALF_FLOAT };
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(
+            0,
+            2,
+            position_types[packed.format.position],
+            GL_FALSE,
+            (int)packed.vertex_size,
+            (void*)0
+        );
+
+        void *color = (void*)packed.position_size;
+        glEnableVertexAttribArray(1);
+        if (packed.format.color == VERTEX_COLOR_PALETTE)
+        {
+            glVertexAttribPointer(1, 1, GL_UNSIGNED_SHORT, GL_FALSE, (int)packed.vertex_size, color);
+        }
+
+        else
+        {
+            glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, (int)packed.vertex_size, color);
+        }
+
+        renderer->index_offset[i] = packed.first_index[i] * packed.index_size;
+        renderer->index_count[i] = packed.mesh_index_count[i];
+    }
+
+    glBindVertexArray(0);
+
+    upload_material(renderer, &packed);
+
+    destroy_packed_meshes(&packed);
+    return true;
+}
+
+bool init_tile_renderer(
+    struct TileRenderer *renderer,
+    enum RenderBackend backend,
+    const struct TileMesh *meshes,
+    int mesh_count,
+    const struct VertexFormat *format,
+    struct ThreadPool *pool)
+{
+    if (mesh_count <= 0 || mesh_count > TILE_MESH_MAX_COUNT)
+    {
+        LOG_ERROR("Unsupported tile mesh count: %d", mesh_count);
+        return false;
+    }
+
+    memset(renderer, 0, sizeof(struct TileRenderer));
+    renderer->backend = backend;
+    renderer->mesh_count = mesh_count;
+
+    if (backend == RENDER_BACKEND_CPU)
+    {
+        memcpy(renderer->meshes, meshes, mesh_count * sizeof(struct TileMesh));
+        init_rasterizer(&renderer->rasterizer, pool);
+        return true;
+    }
+
+    if (!create_shader(&renderer->instanced_shader, instanced_vertex_source, fragment_source) ||
+        !create_shader(&renderer->per_tile_shader, per_tile_vertex_source, fragment_source) ||
+        !create_shader(&renderer->procedural_shader, procedural_vertex_source, fragment_source))
+    {
+        LOG_ERROR("Failed to create tile shaders!");
+        destroy_shader(&renderer->procedural_shader);
+        destroy_shader(&renderer->per_tile_shader);
+        destroy_shader(&renderer->instanced_shader);
+        return false;
+    }
+
+    renderer->per_tile_model = get_shader_uniform(&renderer->per_tile_shader, "model");
+    set_shader_block_binding(&renderer->procedural_shader, "TileLattice", TILE_LATTICE_BINDING);
+
+    int alignment;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    alignment = alignment > 0 ? alignment : 1;
+    renderer->lattice_stride = (sizeof(struct LatticeBlock) + alignment - 1) / alignment * alignment;
+
+    struct VertexFormat default_format = { 0 };
+    if (!upload_tile_meshes(renderer, meshes, mesh_count, format != NULL ? format : &default_format))
+    {
+        destroy_shader(&renderer->procedural_shader);
+        destroy_shader(&renderer->per_tile_shader);
+        destroy_shader(&renderer->instanced_shader);
+        return false;
+    }
+
+    glGenBuffers(1, &renderer->view_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, renderer->view_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(struct ViewBlock), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glGenBuffers(1, &renderer->lattice_buffer);
+    glGenBuffers(1, &renderer->instance_buffer);
+    return true;
+}
+
+void destroy_tile_renderer(struct TileRenderer *renderer)
+{
+    if (renderer->instances != NULL)
+    {
+        FREE_ARRAY(renderer->instances, struct TileInstance, renderer->instance_capacity);
+        renderer->instances = NULL;
+    }
+
+    if (renderer->backend == RENDER_BACKEND_CPU)
+    {
+        destroy_rasterizer(&renderer->rasterizer);
+        return;
+    }
+
+    destroy_stream_buffer(&renderer->instance_stream);
+    glDeleteBuffers(1, &renderer->lattice_buffer);
+    glDeleteBuffers(1, &renderer->material_buffer);
+    glDeleteBuffers(1, &renderer->view_buffer);
+    glDeleteBuffers(1, &renderer->instance_buffer);
+    glDeleteBuffers(1, &renderer->index_buffer);
+    glDeleteBuffers(1, &renderer->vertex_buffer);
+    glDeleteVertexArrays(renderer->mesh_count, renderer->vao);
+
+    destroy_shader(&renderer->procedural_shader);
+    destroy_shader(&renderer->per_tile_shader);
+    destroy_shader(&renderer->instanced_shader);
+}
+
+static size_t set_instance_ranges(struct TileRenderer *renderer, const size_t *counts)
+{
+    size_t total = 0;
+    for (int i = 0; i < renderer->mesh_count; i++)
+    {
+        renderer->instance_first[i] = total;
+        renderer->instance_count[i] = counts[i];
+        total += counts[i];
+    }
+
+    return total;
+}
+
+static void reserve_instance_copy(struct TileRenderer *renderer, size_t total)
+{
+    if (total > renderer->instance_capacity)
+    {
+        renderer->instances = (struct TileInstance*)reallocate(
+            renderer->instances,
+            renderer->instance_capacity * sizeof(struct TileInstance),
+            total * sizeof(struct TileInstance)
+        );
+        renderer->instance_capacity = total;
+    }
+}
+
+void set_tile_instances(
+    struct TileRenderer *renderer,
+    const struct TileInstance *instances,
+    const size_t *counts)
+{
+    size_t total = set_instance_ranges(renderer, counts);
+
+    // A CPU copy is kept for the per-tile path, which needs one model
+    // matrix per draw, and for the CPU backend.
+    reserve_instance_copy(renderer, total);
+    memcpy(renderer->instances, instances, total * sizeof(struct TileInstance));
+
+    if (renderer->backend == RENDER_BACKEND_CPU)
+        return;
+
+    renderer->streaming = false;
+    glBindBuffer(GL_ARRAY_BUFFER, renderer->instance_buffer);
+    glBufferData(
+        GL_ARRAY_BUFFER,
+        total * sizeof(struct TileInstance),
+        instances,
+        GL_STATIC_DRAW
+    );
+    render_counters.buffer_bytes += total * sizeof(struct TileInstance);
+
+    for (int i = 0; i < renderer->mesh_count; i++)
+    {
+        set_instance_attributes(renderer, i, renderer->instance_buffer, 0);
+    }
+
+    glBindVertexArray(0);
+}
+
+struct TileInstance* map_tile_instances(struct TileRenderer *renderer, size_t total)
+{
+    // The rasterizer reads the CPU copy directly.
+    if (renderer->backend == RENDER_BACKEND_CPU)
+    {
+        reserve_instance_copy(renderer, total);
+        return renderer->instances;
+    }
+
+    size_t size = total * sizeof(struct TileInstance);
+    if (renderer->instance_stream.buffer == 0 && !init_stream_buffer(&renderer->instance_stream, size))
+        return NULL;
+
+    void *instances = map_stream_region(&renderer->instance_stream, size);
+    renderer->stream_mapped = instances != NULL;
+    return (struct TileInstance*)instances;
+}
+
+void commit_tile_instances(struct TileRenderer *renderer, const size_t *counts)
+{
+    set_instance_ranges(renderer, counts);
+    if (renderer->backend == RENDER_BACKEND_CPU)
+        return;
+
+    // Nothing was written, and the attributes still point at the last
+    // instances that were.
+    if (!renderer->stream_mapped)
+    {
+        memset(renderer->instance_count, 0, sizeof(renderer->instance_count));
+        return;
+    }
+
+    unmap_stream_region(&renderer->instance_stream);
+    renderer->stream_mapped = false;
+    renderer->streaming = true;
+
+    size_t base = get_stream_region_offset(&renderer->instance_stream);
+    for (int i = 0; i < renderer->mesh_count; i++)
+    {
+        set_instance_attributes(renderer, i, renderer->instance_stream.buffer, base);
+    }
+
+    glBindVertexArray(0);
+}
+
+bool set_tile_lattice(
+    struct TileRenderer *renderer,
+    const struct LatticeDraw *draws,
+    int draw_count,
+    const float *region)
+{
+    ASSERT(renderer->backend == RENDER_BACKEND_GL, "Lattice draws need the GL backend");
+    if (draw_count < 0 || draw_count > TILE_LATTICE_MAX_DRAWS)
+    {
+        LOG_ERROR("Cannot draw %d lattice draws, at most %d fit", draw_count, TILE_LATTICE_MAX_DRAWS);
+        renderer->lattice_draw_count = 0;
+        return false;
+    }
+
+    memcpy(renderer->lattice_draws, draws, draw_count * sizeof(struct LatticeDraw));
+    renderer->lattice_draw_count = draw_count;
+
+    static const float everywhere[4] = { -FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX };
+    region = region != NULL ? region : everywhere;
+
+    // One block per draw, each where glBindBufferRange can start.
+    glBindBuffer(GL_UNIFORM_BUFFER, renderer->lattice_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, draw_count * renderer->lattice_stride, NULL, GL_DYNAMIC_DRAW);
+    for (int i = 0; i < draw_count; i++)
+    {
+        const struct LatticeDraw *draw = &draws[i];
+        struct LatticeBlock block = {
+            .linear = { draw->linear[0], draw->linear[1], draw->linear[2], draw->linear[3] },
+            .steps = { draw->column_step[0], draw->column_step[1], draw->row_step[0], draw->row_step[1] },
+            .offset = { draw->offset[0], draw->offset[1], 0.0f, 0.0f },
+            .bounds = { draw->bounds[0], draw->bounds[1], draw->bounds[2], 0.0f },
+            .region = { region[0], region[1], region[2], region[3] },
+            .cells = { draw->first_column, draw->first_row, (int32_t)draw->columns, 0 }
+        };
+        glBufferSubData(GL_UNIFORM_BUFFER, (GLintptr)(i * renderer->lattice_stride), sizeof(block), &block);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    render_counters.buffer_bytes += draw_count * sizeof(struct LatticeBlock);
+    return true;
+}
+
+void set_tile_render_target(struct TileRenderer *renderer, struct RasterTarget *target)
+{
+    renderer->target = target;
+}
+
+size_t get_tile_instance_count(const struct TileRenderer *renderer)
+{
+    size_t total = 0;
+    for (int i = 0; i < renderer->mesh_count; i++)
+    {
+        total += renderer->instance_count[i];
+    }
+
+    return total;
+}
+
+static void draw_tiles_instanced(struct TileRenderer *renderer)
+{
+    for (int i = 0; i < renderer->mesh_count; i++)
+    {
+        if (renderer->instance_count[i] == 0)
+            continue;
+
+        glBindVertexArray(renderer->vao[i]);
+        glDrawElementsInstanced(
+            GL_TRIANGLES,
+            (int)renderer->index_count[i],
+            renderer->index_type,
+            (void*)renderer->index_offset[i],
+            (int)renderer->instance_count[i]
+        );
+
+        render_counters.state_changes++;
+        render_counters.draw_calls++;
+        render_counters.triangles += renderer->index_count[i] / 3 * renderer->instance_count[i];
+    }
+}
+
+static void draw_tiles_procedural(struct TileRenderer *renderer)
+{
+    for (int i = 0; i < renderer->lattice_draw_count; i++)
+    {
+        const struct LatticeDraw *draw = &renderer->lattice_draws[i];
+        if (draw->count == 0)
+            continue;
+
+        glBindBufferRange(
+            GL_UNIFORM_BUFFER,
+            TILE_LATTICE_BINDING,
+            renderer->lattice_buffer,
+            (GLintptr)(i * renderer->lattice_stride),
+            sizeof(struct LatticeBlock)
+        );
+        glBindVertexArray(renderer->vao[draw->mesh]);
+        glDrawElementsInstanced(
+            GL_TRIANGLES,
+            (int)renderer->index_count[draw->mesh],
+            renderer->index_type,
+            (void*)renderer->index_offset[draw->mesh],
+            (int)draw->count
+        );
+
+        render_counters.state_changes += 2;
+        render_counters.draw_calls++;
+        render_counters.triangles += renderer->index_count[draw->mesh] / 3 * draw->count;
+    }
+}
+
+// Reference path matching the original render loop: one model matrix upload
+// and one draw call for every tile.
+static void draw_tiles_per_tile(struct TileRenderer *renderer)
+{
+    for (int i = 0; i < renderer->mesh_count; i++)
+    {
+        glBindVertexArray(renderer->vao[i]);
+        render_counters.state_changes++;
+
+        const struct TileInstance *instance =
+            renderer->instances + renderer->instance_first[i];
+        for (size_t j = 0; j < renderer->instance_count[i]; j++, instance++)
+        {
+            mat4 model;
+            glmc_mat4_identity(model);
+            model[0][0] = instance->linear[0];
+            model[0][1] = instance->linear[1];
+            model[1][0] = instance->linear[2];
+            model[1][1] = instance->linear[3];
+            model[3][0] = instance->offset[0];
+            model[3][1] = instance->offset[1];
+
+            set_shader_mat4(renderer->per_tile_model, (float*)model);
+
+            glDrawElements(
+                GL_TRIANGLES,
+                (int)renderer->index_count[i],
+                renderer->index_type,
+                (void*)renderer->index_offset[i]
+            );
+        }
+
+        render_counters.draw_calls += renderer->instance_count[i];
+        render_counters.triangles += renderer->index_count[i] / 3 * renderer->instance_count[i];
+    }
+}
+
+static void draw_tiles_cpu(struct TileRenderer *renderer)
+{
+    mat4 view_projection;
+    glmc_mat4_mul((vec4*)renderer->projection, (vec4*)renderer->view, view_projection);
+
+    begin_raster_frame(&renderer->rasterizer, renderer->target);
+    for (int i = 0; i < renderer->mesh_count; i++)
+    {
+        submit_raster_instances(
+            &renderer->rasterizer,
+            (float*)view_projection,
+            &renderer->meshes[i],
+            renderer->instances + renderer->instance_first[i],
+            renderer->instance_count[i]
+        );
+    }
+    end_raster_frame(&renderer->rasterizer);
+}
+
+void get_visible_region(const float *view, const float *projection, float *region)
+{
+    mat4 view_projection, inverse;
+    glmc_mat4_mul((vec4*)projection, (vec4*)view, view_projection);
+    glmc_mat4_inv(view_projection, inverse);
+
+    region[0] = region[1] = FLT_MAX;
+    region[2] = region[3] = -FLT_MAX;
+
+    // Each corner of the viewport is a line from the near to the far plane,
+    // which crosses z = 0 somewhere in between.
+    for (int i = 0; i < 4; i++)
+    {
+        vec4 ends[2];
+        for (int j = 0; j < 2; j++)
+        {
+            vec4 corner = { (i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, j ? 1.0f : -1.0f, 1.0f };
+            glmc_mat4_mulv(inverse, corner, ends[j]);
+            ends[j][0] /= ends[j][3];
+            ends[j][1] /= ends[j][3];
+            ends[j][2] /= ends[j][3];
+        }
+
+        float t = ends[0][2] / (ends[0][2] - ends[1][2]);
+        float x = ends[0][0] + t * (ends[1][0] - ends[0][0]);
+        float y = ends[0][1] + t * (ends[1][1] - ends[0][1]);
+        region[0] = x < region[0] ? x : region[0];
+        region[1] = y < region[1] ? y : region[1];
+        region[2] = x > region[2] ? x : region[2];
+        region[3] = y > region[3] ? y : region[3];
+    }
+}
+
+void set_tile_view(struct TileRenderer *renderer, const float *view, const float *projection)
+{
+    memcpy(renderer->view, view, sizeof(renderer->view));
+    memcpy(renderer->projection, projection, sizeof(renderer->projection));
+    if (renderer->backend == RENDER_BACKEND_CPU)
+        return;
+
+    struct ViewBlock block;
+    memcpy(block.view, view, sizeof(block.view));
+    memcpy(block.projection, projection, sizeof(block.projection));
+
+    glBindBuffer(GL_UNIFORM_BUFFER, renderer->view_buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    render_counters.buffer_bytes += sizeof(block);
+}
+
+void clear_tiles(struct TileRenderer *renderer, const float *color)
+{
+    if (renderer->backend == RENDER_BACKEND_CPU)
+    {
+        clear_raster_target(renderer->target, color);
+        return;
+    }
+
+    PROFILE_GPU_BEGIN("clear");
+    glClearColor(color[0], color[1], color[2], color[3]);
+    glClear(GL_COLOR_BUFFER_BIT);
+    PROFILE_GPU_END();
+}
+
+void draw_tiles(struct TileRenderer *renderer, enum TileDrawMode mode)
+{
+    // The draw mode only changes how work is submitted to GL; the CPU
+    // backend always processes every instance in one pass.
+    if (renderer->backend == RENDER_BACKEND_CPU)
+    {
+        PROFILE_BEGIN("draw_tiles_cpu");
+        draw_tiles_cpu(renderer);
+        PROFILE_END();
+        return;
+    }
+
+    // The blocks' contents are already uploaded; binding the buffers is
+    // all any program needs.
+    PROFILE_BEGIN("bind_uniforms");
+    glBindBufferBase(GL_UNIFORM_BUFFER, SHADER_VIEW_BINDING, renderer->view_buffer);
+    glBindBufferBase(GL_UNIFORM_BUFFER, SHADER_MATERIAL_BINDING, renderer->material_buffer);
+    render_counters.state_changes += 2;
+
+    if (mode == TILE_DRAW_INSTANCED)
+    {
+        bind_shader(&renderer->instanced_shader);
+    }
+
+    else if (mode == TILE_DRAW_PROCEDURAL)
+    {
+        bind_shader(&renderer->procedural_shader);
+    }
+
+    else
+    {
+        bind_shader(&renderer->per_tile_shader);
+    }
+    PROFILE_END();
+
+    ASSERT(mode != TILE_DRAW_PER_TILE || !renderer->streaming, "Streamed instances can only be drawn instanced");
+
+    PROFILE_BEGIN("submit_draws");
+    PROFILE_GPU_BEGIN("draw_tiles");
+    if (mode == TILE_DRAW_INSTANCED)
+    {
+        draw_tiles_instanced(renderer);
+    }
+
+    else if (mode == TILE_DRAW_PROCEDURAL)
+    {
+        draw_tiles_procedural(renderer);
+    }
+
+    else
+    {
+        draw_tiles_per_tile(renderer);
+    }
+
+    // The region is not written again until this has been drawn.
+    if (renderer->streaming && mode == TILE_DRAW_INSTANCED)
+    {
+        fence_stream_region(&renderer->instance_stream);
+    }
+
+    glBindVertexArray(0);
+    PROFILE_GPU_END();
+    PROFILE_END();
+}
\ No newline at end of file
@@ -0,0 +1,832 @@
+#include <common.h>
+#include <core/log.h>
+#include <graphics/tiling.h>
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+// The outline, the inset outline in the border colour, and the inset outline
+// again in the fill colour, each going round the chevron in the same order.
+static const float tile_model1[] = {
+    // Location           // Color
+     0.0f, 0.0f, 0.0f,    1.0f, 1.0f, 1.0f,
+    -1.0f, 0.0f, 0.0f,    1.0f, 1.0f, 1.0f,
+    -2.0f, 0.5f, 0.0f,    1.0f, 1.0f, 1.0f,
+    -1.0f, 1.0f, 0.0f,    1.0f, 1.0f, 1.0f,
+     0.0f, 1.0f, 0.0f,    1.0f, 1.0f, 1.0f,
+    -1.0f, 0.5f, 0.0f,    1.0f, 1.0f, 1.0f,
+
+    -0.20f, 0.05f, 0.0f,    1.0f, 1.0f, 1.0f,
+    -1.00f, 0.05f, 0.0f,    1.0f, 1.0f, 1.0f,
+    -1.90f, 0.50f, 0.0f,    1.0f, 1.0f, 1.0f,
+    -1.00f, 0.95f, 0.0f,    1.0f, 1.0f, 1.0f,
+    -0.20f, 0.95f, 0.0f,    1.0f, 1.0f, 1.0f,
+    -1.10f, 0.50f, 0.0f,    1.0f, 1.0f, 1.0f,
+
+    -0.20f, 0.05f, 0.0f,    0.2f, 0.5f, 0.8f,
+    -1.00f, 0.05f, 0.0f,    0.2f, 0.5f, 0.8f,
+    -1.90f, 0.50f, 0.0f,    0.2f, 0.5f, 0.8f,
+    -1.00f, 0.95f, 0.0f,    0.2f, 0.5f, 0.8f,
+    -0.20f, 0.95f, 0.0f,    0.2f, 0.5f, 0.8f,
+    -1.10f, 0.50f, 0.0f,    0.2f, 0.5f, 0.8f
+};
+
+static const float tile_model2[] = {
+    // Location           // Color
+     0.0f, 0.0f, 0.0f,    1.0f, 1.0f, 1.0f,
+    -1.0f, 0.0f, 0.0f,    1.0f, 1.0f, 1.0f,
+    -2.0f, 0.5f, 0.0f,    1.0f, 1.0f, 1.0f,
+    -1.0f, 1.0f, 0.0f,    1.0f, 1.0f, 1.0f,
+     0.0f, 1.0f, 0.0f,    1.0f, 1.0f, 1.0f,
+    -1.0f, 0.5f, 0.0f,    1.0f, 1.0f, 1.0f,
+
+    -0.20f, 0.05f, 0.0f,    1.0f, 1.0f, 1.0f,
+    -1.00f, 0.05f, 0.0f,    1.0f, 1.0f, 1.0f,
+    -1.90f, 0.50f, 0.0f,    1.0f, 1.0f, 1.0f,
+    -1.00f, 0.95f, 0.0f,    1.0f, 1.0f, 1.0f,
+    -0.20f, 0.95f, 0.0f,    1.0f, 1.0f, 1.0f,
+    -1.10f, 0.50f, 0.0f,    1.0f, 1.0f, 1.0f,
+
+    -0.20f, 0.05f, 0.0f,    0.9f, 0.9f, 0.2f,
+    -1.00f, 0.05f, 0.0f,    0.9f, 0.9f, 0.2f,
+    -1.90f, 0.50f, 0.0f,    0.9f, 0.9f, 0.2f,
+    -1.00f, 0.95f, 0.0f,    0.9f, 0.9f, 0.2f,
+    -0.20f, 0.95f, 0.0f,    0.9f, 0.9f, 0.2f,
+    -1.10f, 0.50f, 0.0f,    0.9f, 0.9f, 0.2f
+};
+
+static const unsigned int tile_indices[] = {
+    // Border: a ring of quads between the outline and the inset outline, so
+    // the fill never covers it.
+    0, 1, 7,     0, 7, 6,
+    1, 2, 8,     1, 8, 7,
+    2, 3, 9,     2, 9, 8,
+    3, 4, 10,    3, 10, 9,
+    4, 5, 11,    4, 11, 10,
+    5, 0, 6,     5, 6, 11,
+
+    // Fill.
+    12, 13, 14,
+    12, 17, 14,
+    14, 17, 16,
+    14, 15, 16
+};
+
+// The border as the tile was first drawn: a strip over the whole outline,
+// which the fill is then drawn on top of.
+static const unsigned int layered_tile_indices[] = {
+    // Border.
+    0, 1, 2,
+    0, 5, 2,
+    2, 5, 4,
+    2, 3, 4,
+
+    // Fill.
+    12, 13, 14,
+    12, 17, 14,
+    14, 17, 16,
+    14, 15, 16
+};
+
+void get_demo_tile_meshes(struct TileMesh *meshes)
+{
+    meshes[0] = (struct TileMesh){
+        tile_model1, sizeof(tile_model1) / (6 * sizeof(float)),
+        tile_indices, sizeof(tile_indices) / sizeof(unsigned int)
+    };
+
+    meshes[1] = (struct TileMesh){
+        tile_model2, sizeof(tile_model2) / (6 * sizeof(float)),
+        tile_indices, sizeof(tile_indices) / sizeof(unsigned int)
+    };
+}
+
+void get_layered_demo_tile_meshes(struct TileMesh *meshes)
+{
+    get_demo_tile_meshes(meshes);
+    for (int i = 0; i < DEMO_TILE_MESH_COUNT; i++)
+    {
+        meshes[i].indices = layered_tile_indices;
+        meshes[i].index_count = sizeof(layered_tile_indices) / sizeof(unsigned int);
+    }
+}
+
+void build_tiling(struct TileInstance *instances, size_t *counts, unsigned int columns, unsigned int rows)
+{
+    const float x_origin = (float)(columns / 2 + 1);
+    const float y_origin = (float)(rows / 2);
+
+    struct TileInstance *plain = instances;
+    struct TileInstance *mirrored = instances + (size_t)rows * columns;
+
+    for (unsigned int i = 0; i < rows; i++)
+    {
+        for (unsigned int j = 0; j < columns; j++)
+        {
+            float x = x_origin - 1.0f * j;
+            float y = y_origin - 2.0f * i;
+
+            *plain++ = (struct TileInstance){
+                .linear = { 1.0f, 0.0f, 0.0f, 1.0f },
+                .offset = { x, y }
+            };
+
+            // Equivalent to scaling by (-1, 1) after translating by (x, y - 1).
+            *mirrored++ = (struct TileInstance){
+                .linear = { -1.0f, 0.0f, 0.0f, 1.0f },
+                .offset = { -x, y - 1.0f }
+            };
+        }
+    }
+
+    counts[0] = (size_t)rows * columns;
+    counts[1] = (size_t)rows * columns;
+}
+
+// Rows or columns in [0, count) whose index i puts the span
+// [base + step * i + low, base + step * i + high] over [min, max].
+static bool get_index_range(float base, float step, float low, float high, float min, float max, unsigned int count, unsigned int *first, unsigned int *last)
+{
+    float a = (min - high - base) / step;
+    float b = (max - low - base) / step;
+    float lower = ceilf(fminf(a, b));
+    float upper = floorf(fmaxf(a, b));
+
+    lower = lower > 0.0f ? lower : 0.0f;
+    upper = upper < (float)count - 1.0f ? upper : (float)count - 1.0f;
+    if (count == 0 || lower > upper)
+        return false;
+
+    *first = (unsigned int)lower;
+    *last = (unsigned int)upper;
+    return true;
+}
+
+size_t build_visible_tiling(
+    struct TileInstance *instances,
+    size_t *counts,
+    unsigned int columns,
+    unsigned int rows,
+    const float *region)
+{
+    const float x_origin = (float)(columns / 2 + 1);
+    const float y_origin = (float)(rows / 2);
+
+    // The tile spans -2..0 by 0..1 around its offset. Plain tiles of column
+    // j and row i cover x_origin - j - 2..x_origin - j by y_origin - 2i..
+    // y_origin - 2i + 1; mirrored ones j - x_origin..j - x_origin + 2 by
+    // one unit lower.
+    unsigned int first_row, last_row, first_column, last_column;
+    counts[0] = 0;
+    if (get_index_range(y_origin, -2.0f, 0.0f, 1.0f, region[1], region[3], rows, &first_row, &last_row) &&
+        get_index_range(x_origin, -1.0f, -2.0f, 0.0f, region[0], region[2], columns, &first_column, &last_column))
+    {
+        counts[0] = (size_t)(last_row - first_row + 1) * (last_column - first_column + 1);
+        for (unsigned int i = first_row; instances != NULL && i <= last_row; i++)
+        {
+            for (unsigned int j = first_column; j <= last_column; j++)
+            {
+                *instances++ = (struct TileInstance){
+                    .linear = { 1.0f, 0.0f, 0.0f, 1.0f },
+                    .offset = { x_origin - 1.0f * j, y_origin - 2.0f * i }
+                };
+            }
+        }
+    }
+
+    counts[1] = 0;
+    if (get_index_range(y_origin, -2.0f, -1.0f, 0.0f, region[1], region[3], rows, &first_row, &last_row) &&
+        get_index_range(-x_origin, 1.0f, 0.0f, 2.0f, region[0], region[2], columns, &first_column, &last_column))
+    {
+        counts[1] = (size_t)(last_row - first_row + 1) * (last_column - first_column + 1);
+        for (unsigned int i = first_row; instances != NULL && i <= last_row; i++)
+        {
+            for (unsigned int j = first_column; j <= last_column; j++)
+            {
+                float x = x_origin - 1.0f * j;
+                float y = y_origin - 2.0f * i;
+                *instances++ = (struct TileInstance){
+                    .linear = { -1.0f, 0.0f, 0.0f, 1.0f },
+                    .offset = { -x, y - 1.0f }
+                };
+            }
+        }
+    }
+
+    return counts[0] + counts[1];
+}
+
+size_t build_visible_lattice(
+    struct LatticeDraw *draws,
+    int *draw_count,
+    unsigned int columns,
+    unsigned int rows,
+    const float *region)
+{
+    const float x_origin = (float)(columns / 2 + 1);
+    const float y_origin = (float)(rows / 2);
+
+    // The same ranges as build_visible_tiling, with each tile's offset
+    // worked out in the shader instead.
+    unsigned int first_row, last_row, first_column, last_column;
+    size_t total = 0;
+    *draw_count = 0;
+    if (get_index_range(y_origin, -2.0f, 0.0f, 1.0f, region[1], region[3], rows, &first_row, &last_row) &&
+        get_index_range(x_origin, -1.0f, -2.0f, 0.0f, region[0], region[2], columns, &first_column, &last_column))
+    {
+        struct LatticeDraw *draw = &draws[(*draw_count)++];
+        *draw = (struct LatticeDraw){
+            .mesh = 0,
+            .linear = { 1.0f, 0.0f, 0.0f, 1.0f },
+            .offset = { x_origin, y_origin },
+            .column_step = { -1.0f, 0.0f },
+            .row_step = { 0.0f, -2.0f },
+            .first_column = (int)first_column,
+            .first_row = (int)first_row,
+            .columns = last_column - first_column + 1,
+            .count = (size_t)(last_row - first_row + 1) * (last_column - first_column + 1)
+        };
+        total += draw->count;
+    }
+
+    if (get_index_range(y_origin, -2.0f, -1.0f, 0.0f, region[1], region[3], rows, &first_row, &last_row) &&
+        get_index_range(-x_origin, 1.0f, 0.0f, 2.0f, region[0], region[2], columns, &first_column, &last_column))
+    {
+        struct LatticeDraw *draw = &draws[(*draw_count)++];
+        *draw = (struct LatticeDraw){
+            .mesh = 1,
+            .linear = { -1.0f, 0.0f, 0.0f, 1.0f },
+            .offset = { -x_origin, y_origin - 1.0f },
+            .column_step = { 1.0f, 0.0f },
+            .row_step = { 0.0f, -2.0f },
+            .first_column = (int)first_column,
+            .first_row = (int)first_row,
+            .columns = last_column - first_column + 1,
+            .count = (size_t)(last_row - first_row + 1) * (last_column - first_column + 1)
+        };
+        total += draw->count;
+    }
+
+    return total;
+}
+
+// Roughly square in world units: tiles are 1 wide and each plain/mirrored
+// row pair is 2 tall.
+void get_tiling_size(size_t tile_count, unsigned int *columns, unsigned int *rows)
+{
+    *rows = (unsigned int)(sqrt((double)tile_count) / 2.0);
+    *rows = *rows > 0 ? *rows : 1;
+    *columns = (unsigned int)(tile_count / (2 * (size_t)*rows));
+}
+
+static void write_vertex(float *vertex, float x, float y, const float *color)
+{
+    vertex[0] = x;
+    vertex[1] = y;
+    vertex[2] = 0.0f;
+    vertex[3] = color[0];
+    vertex[4] = color[1];
+    vertex[5] = color[2];
+}
+
+// Vertices are the outline and the inset outline in the border colour, the
+// inset outline again in the fill colour and the centre. Without a border
+// the outline is filled directly.
+static void build_prototile_mesh(
+    const struct Prototile *prototile,
+    const float *fill_color,
+    float *vertices,
+    unsigned int *indices,
+    struct TileMesh *mesh)
+{
+    const float *outline = prototile->vertices;
+    int n = prototile->vertex_count;
+
+    float area = 0.0f;
+    float center[2] = { 0.0f, 0.0f };
+    for (int i = 0; i < n; i++)
+    {
+        int next = (i + 1) % n;
+        area += outline[2 * i] * outline[2 * next + 1] - outline[2 * next] * outline[2 * i + 1];
+        center[0] += outline[2 * i] / n;
+        center[1] += outline[2 * i + 1] / n;
+    }
+
+    float winding = area >= 0.0f ? 1.0f : -1.0f;
+    bool border = prototile->border_inset > 0.0f;
+    unsigned int fill_first = border ? 2 * n : 0;
+    unsigned int center_index = fill_first + n;
+    unsigned int *index = indices;
+
+    for (int i = 0; i < n; i++)
+    {
+        int prev = (i + n - 1) % n;
+        int next = (i + 1) % n;
+        float x = outline[2 * i];
+        float y = outline[2 * i + 1];
+
+        if (!border)
+        {
+            write_vertex(vertices + 6 * i, x, y, fill_color);
+        }
+
+        else
+        {
+            // Inward normals of the edges meeting here, then the mitred
+            // offset where the two inset edges cross.
+            float dx0 = x - outline[2 * prev];
+            float dy0 = y - outline[2 * prev + 1];
+            float dx1 = outline[2 * next] - x;
+            float dy1 = outline[2 * next + 1] - y;
+            float length0 = sqrtf(dx0 * dx0 + dy0 * dy0);
+            float length1 = sqrtf(dx1 * dx1 + dy1 * dy1);
+            float nx0 = -winding * dy0 / length0;
+            float ny0 = winding * dx0 / length0;
+            float nx1 = -winding * dy1 / length1;
+            float ny1 = winding * dx1 / length1;
+
+            float scale = 1.0f + nx0 * nx1 + ny0 * ny1;
+            scale = scale > 1e-3f ? prototile->border_inset / scale : prototile->border_inset;
+            float inset_x = x + (nx0 + nx1) * scale;
+            float inset_y = y + (ny0 + ny1) * scale;
+
+            write_vertex(vertices + 6 * i, x, y, prototile->border_color);
+            write_vertex(vertices + 6 * (n + i), inset_x, inset_y, prototile->border_color);
+            write_vertex(vertices + 6 * (2 * n + i), inset_x, inset_y, fill_color);
+
+            unsigned int a = i;
+            unsigned int b = next;
+            *index++ = a;
+            *index++ = b;
+            *index++ = n + b;
+            *index++ = a;
+            *index++ = n + b;
+            *index++ = n + a;
+        }
+
+        *index++ = center_index;
+        *index++ = fill_first + i;
+        *index++ = fill_first + next;
+    }
+
+    write_vertex(vertices + 6 * center_index, center[0], center[1], fill_color);
+
+    *mesh = (struct TileMesh){
+        vertices, center_index + 1,
+        indices, (size_t)(index - indices)
+    };
+}
+
+static void transform_point(const float *linear, const float *offset, float x, float y, float *result)
+{
+    result[0] = linear[0] * x + linear[2] * y + offset[0];
+    result[1] = linear[1] * x + linear[3] * y + offset[1];
+}
+
+bool init_tiling(struct Tiling *tiling, const struct TilingDescription *description)
+{
+    memset(tiling, 0, sizeof(struct Tiling));
+
+    const struct WallpaperGroup *group = description->group;
+    if (description->prototile_count <= 0 || description->prototile_count > TILING_MAX_PROTOTILES)
+    {
+        LOG_ERROR("Unsupported prototile count: %d", description->prototile_count);
+        return false;
+    }
+
+    const float (*lattice)[2] = description->lattice;
+    float det = lattice[0][0] * lattice[1][1] - lattice[1][0] * lattice[0][1];
+    if (fabsf(det) < 1e-6f)
+    {
+        LOG_ERROR("Degenerate lattice for wallpaper group %s", group->name);
+        return false;
+    }
+
+    memcpy(tiling->lattice, lattice, sizeof(tiling->lattice));
+    tiling->inverse_lattice[0][0] = lattice[1][1] / det;
+    tiling->inverse_lattice[0][1] = -lattice[1][0] / det;
+    tiling->inverse_lattice[1][0] = -lattice[0][1] / det;
+    tiling->inverse_lattice[1][1] = lattice[0][0] / det;
+
+    // Operations move to world space as B M B^-1 and B t, where B has the
+    // basis vectors as columns and inverse_lattice holds the rows of B^-1.
+    const float (*inverse)[2] = tiling->inverse_lattice;
+    tiling->operation_count = group->operation_count;
+    for (int i = 0; i < group->operation_count; i++)
+    {
+        const struct SymmetryOperation *operation = &group->operations[i];
+        const int *m = operation->matrix;
+        struct TileInstance *transform = &tiling->operations[i];
+
+        float bm[2][2];
+        for (int row = 0; row < 2; row++)
+        {
+            bm[row][0] = lattice[0][row] * m[0] + lattice[1][row] * m[2];
+            bm[row][1] = lattice[0][row] * m[1] + lattice[1][row] * m[3];
+        }
+
+        for (int column = 0; column < 2; column++)
+        {
+            for (int row = 0; row < 2; row++)
+            {
+                transform->linear[2 * column + row] =
+                    bm[row][0] * inverse[0][column] + bm[row][1] * inverse[1][column];
+            }
+        }
+
+        const float *t = operation->translation;
+        transform->offset[0] = t[0] * lattice[0][0] + t[1] * lattice[1][0];
+        transform->offset[1] = t[0] * lattice[0][1] + t[1] * lattice[1][1];
+        tiling->mirrored[i] = m[0] * m[3] - m[1] * m[2] < 0;
+
+        // Operations are only isometries on lattices of the right shape.
+        const float *l = transform->linear;
+        if (fabsf(l[0] * l[0] + l[1] * l[1] - 1.0f) > 1e-3f ||
+            fabsf(l[2] * l[2] + l[3] * l[3] - 1.0f) > 1e-3f ||
+            fabsf(l[0] * l[2] + l[1] * l[3]) > 1e-3f)
+        {
+            LOG_ERROR("Lattice does not have the symmetry of wallpaper group %s", group->name);
+            return false;
+        }
+    }
+
+    tiling->prototile_count = description->prototile_count;
+    tiling->mesh_count = 2 * description->prototile_count;
+    for (int p = 0; p < description->prototile_count; p++)
+    {
+        const struct Prototile *prototile = &description->prototiles[p];
+        if (prototile->vertex_count < 3 || prototile->vertex_count > TILING_MAX_PROTOTILE_VERTICES)
+        {
+            LOG_ERROR("Unsupported prototile vertex count: %d", prototile->vertex_count);
+            return false;
+        }
+
+        for (int k = 0; k < 2; k++)
+        {
+            build_prototile_mesh(
+                prototile, prototile->fill_colors[k],
+                tiling->vertex_data[2 * p + k], tiling->index_data[p], &tiling->meshes[2 * p + k]
+            );
+        }
+
+        // The centre vertex is the last one.
+        const struct TileMesh *mesh = &tiling->meshes[2 * p];
+        float cx = mesh->vertices[6 * (mesh->vertex_count - 1)];
+        float cy = mesh->vertices[6 * (mesh->vertex_count - 1) + 1];
+        float radius = 0.0f;
+        for (int i = 0; i < prototile->vertex_count; i++)
+        {
+            float dx = prototile->vertices[2 * i] - cx;
+            float dy = prototile->vertices[2 * i + 1] - cy;
+            radius = fmaxf(radius, sqrtf(dx * dx + dy * dy));
+        }
+
+        for (int i = 0; i < tiling->operation_count; i++)
+        {
+            float *bounds = tiling->bounds[i][p];
+            transform_point(tiling->operations[i].linear, tiling->operations[i].offset, cx, cy, bounds);
+            bounds[2] = radius;
+
+            float reach = sqrtf(bounds[0] * bounds[0] + bounds[1] * bounds[1]) + radius;
+            tiling->cell_radius = fmaxf(tiling->cell_radius, reach);
+        }
+    }
+
+    return true;
+}
+
+// Lattice rows j to visit for region, and for each the columns i whose cell
+// origin i a + j b is close enough to the region for any of its tiles to
+// overlap it.
+struct CellRange
+{
+    float x0, y0, x1, y1;
+    int first_row;
+    int last_row;
+};
+
+static void get_cell_range(const struct Tiling *tiling, const float *region, struct CellRange *range)
+{
+    range->x0 = region[0] - tiling->cell_radius;
+    range->y0 = region[1] - tiling->cell_radius;
+    range->x1 = region[2] + tiling->cell_radius;
+    range->y1 = region[3] + tiling->cell_radius;
+
+    float min_j = FLT_MAX;
+    float max_j = -FLT_MAX;
+    for (int corner = 0; corner < 4; corner++)
+    {
+        float x = corner & 1 ? range->x1 : range->x0;
+        float y = corner & 2 ? range->y1 : range->y0;
+        float j = tiling->inverse_lattice[1][0] * x + tiling->inverse_lattice[1][1] * y;
+        min_j = fminf(min_j, j);
+        max_j = fmaxf(max_j, j);
+    }
+
+    range->first_row = (int)ceilf(min_j);
+    range->last_row = (int)floorf(max_j);
+}
+
+// Returns false when the row misses the region entirely.
+static bool get_row_columns(const struct Tiling *tiling, const struct CellRange *range, int j, int *first, int *last)
+{
+    const float (*lattice)[2] = tiling->lattice;
+    const float low[2] = { range->x0, range->y0 };
+    const float high[2] = { range->x1, range->y1 };
+
+    float min_i = -FLT_MAX;
+    float max_i = FLT_MAX;
+    for (int axis = 0; axis < 2; axis++)
+    {
+        float base = j * lattice[1][axis];
+        float step = lattice[0][axis];
+        if (fabsf(step) < 1e-6f)
+        {
+            if (base < low[axis] || base > high[axis])
+                return false;
+
+            continue;
+        }
+
+        float t0 = (low[axis] - base) / step;
+        float t1 = (high[axis] - base) / step;
+        min_i = fmaxf(min_i, fminf(t0, t1));
+        max_i = fminf(max_i, fmaxf(t0, t1));
+    }
+
+    *first = (int)ceilf(min_i);
+    *last = (int)floorf(max_i);
+    return *first <= *last;
+}
+
+size_t get_tiling_capacity(const struct Tiling *tiling, const float *region)
+{
+    struct CellRange range;
+    get_cell_range(tiling, region, &range);
+
+    size_t cells = 0;
+    for (int j = range.first_row; j <= range.last_row; j++)
+    {
+        int first, last;
+        if (get_row_columns(tiling, &range, j, &first, &last))
+        {
+            cells += (size_t)(last - first + 1);
+        }
+    }
+
+    return cells * (size_t)tiling->operation_count * (size_t)tiling->prototile_count;
+}
+
+struct TileGeometry
+{
+    float *vertices;
+    unsigned int *indices;
+    size_t vertex_count;
+    size_t index_count;
+};
+
+static void write_tile_geometry(struct TileGeometry *geometry, const struct TileMesh *mesh, const struct TileInstance *instance)
+{
+    float *vertex = geometry->vertices + 6 * geometry->vertex_count;
+    for (size_t i = 0; i < mesh->vertex_count; i++, vertex += 6)
+    {
+        const float *source = mesh->vertices + 6 * i;
+        transform_point(instance->linear, instance->offset, source[0], source[1], vertex);
+        vertex[2] = source[2];
+        vertex[3] = source[3];
+        vertex[4] = source[4];
+        vertex[5] = source[5];
+    }
+
+    unsigned int base = (unsigned int)geometry->vertex_count;
+    unsigned int *index = geometry->indices + geometry->index_count;
+    for (size_t i = 0; i < mesh->index_count; i++)
+    {
+        index[i] = base + mesh->indices[i];
+    }
+
+    geometry->vertex_count += mesh->vertex_count;
+    geometry->index_count += mesh->index_count;
+}
+
+// Places one mesh's tiles, as instances or, with geometry, as triangles.
+static size_t place_mesh_tiles(
+    const struct Tiling *tiling,
+    const float *region,
+    int mesh,
+    struct TileInstance *instances,
+    struct TileGeometry *geometry)
+{
+    int prototile = mesh / 2;
+    bool mirrored = mesh % 2 == 1;
+
+    int operations[WALLPAPER_MAX_OPERATIONS];
+    int operation_count = 0;
+    for (int i = 0; i < tiling->operation_count; i++)
+    {
+        if (tiling->mirrored[i] == mirrored)
+        {
+            operations[operation_count++] = i;
+        }
+    }
+
+    if (operation_count == 0)
+        return 0;
+
+    struct CellRange range;
+    get_cell_range(tiling, region, &range);
+
+    const float (*lattice)[2] = tiling->lattice;
+    size_t count = 0;
+    for (int j = range.first_row; j <= range.last_row; j++)
+    {
+        int first, last;
+        if (!get_row_columns(tiling, &range, j, &first, &last))
+            continue;
+
+        for (int i = first; i <= last; i++)
+        {
+            float origin_x = i * lattice[0][0] + j * lattice[1][0];
+            float origin_y = i * lattice[0][1] + j * lattice[1][1];
+
+            for (int k = 0; k < operation_count; k++)
+            {
+                int operation = operations[k];
+                const float *bounds = tiling->bounds[operation][prototile];
+                float x = origin_x + bounds[0];
+                float y = origin_y + bounds[1];
+                if (x + bounds[2] < region[0] || x - bounds[2] > region[2] ||
+                    y + bounds[2] < region[1] || y - bounds[2] > region[3])
+                    continue;
+
+                const struct TileInstance *transform = &tiling->operations[operation];
+                struct TileInstance instance = {
+                    .linear = {
+                        transform->linear[0], transform->linear[1],
+                        transform->linear[2], transform->linear[3]
+                    },
+                    .offset = { origin_x + transform->offset[0], origin_y + transform->offset[1] }
+                };
+
+                if (geometry != NULL)
+                {
+                    write_tile_geometry(geometry, &tiling->meshes[mesh], &instance);
+                }
+
+                else if (instances != NULL)
+                {
+                    instances[count] = instance;
+                }
+
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
+
+size_t generate_tiling_lattice(
+    const struct Tiling *tiling,
+    const float *region,
+    struct LatticeDraw *draws,
+    int *draw_count)
+{
+    struct CellRange range;
+    get_cell_range(tiling, region, &range);
+
+    // Rows of a slanted lattice reach the region over different columns;
+    // the draws cover all of them and the shader drops the extra tiles.
+    int first_column = INT_MAX;
+    int last_column = INT_MIN;
+    for (int j = range.first_row; j <= range.last_row; j++)
+    {
+        int first, last;
+        if (get_row_columns(tiling, &range, j, &first, &last))
+        {
+            first_column = first < first_column ? first : first_column;
+            last_column = last > last_column ? last : last_column;
+        }
+    }
+
+    *draw_count = 0;
+    if (first_column > last_column)
+        return 0;
+
+    size_t cells = (size_t)(range.last_row - range.first_row + 1) * (size_t)(last_column - first_column + 1);
+    size_t total = 0;
+    for (int mesh = 0; mesh < tiling->mesh_count; mesh++)
+    {
+        int prototile = mesh / 2;
+        bool mirrored = mesh % 2 == 1;
+        for (int i = 0; i < tiling->operation_count; i++)
+        {
+            if (tiling->mirrored[i] != mirrored)
+                continue;
+
+            const struct TileInstance *transform = &tiling->operations[i];
+            const float *bounds = tiling->bounds[i][prototile];
+            struct LatticeDraw *draw = &draws[(*draw_count)++];
+            *draw = (struct LatticeDraw){
+                .mesh = mesh,
+                .linear = {
+                    transform->linear[0], transform->linear[1],
+                    transform->linear[2], transform->linear[3]
+                },
+                .offset = { transform->offset[0], transform->offset[1] },
+                .column_step = { tiling->lattice[0][0], tiling->lattice[0][1] },
+                .row_step = { tiling->lattice[1][0], tiling->lattice[1][1] },
+                .first_column = first_column,
+                .first_row = range.first_row,
+                .columns = (unsigned int)(last_column - first_column + 1),
+                .count = cells,
+                .bounds = { bounds[0], bounds[1], bounds[2] }
+            };
+            total += cells;
+        }
+    }
+
+    return total;
+}
+
+size_t generate_tiling(const struct Tiling *tiling, const float *region, struct TileInstance *instances, size_t *counts)
+{
+    size_t total = 0;
+    for (int mesh = 0; mesh < tiling->mesh_count; mesh++)
+    {
+        counts[mesh] = place_mesh_tiles(tiling, region, mesh, instances != NULL ? instances + total : NULL, NULL);
+        total += counts[mesh];
+    }
+
+    return total;
+}
+
+void get_tiling_geometry_capacity(
+    const struct Tiling *tiling,
+    const float *region,
+    size_t *vertex_capacity,
+    size_t *index_capacity)
+{
+    size_t max_vertices = 0;
+    size_t max_indices = 0;
+    for (int mesh = 0; mesh < tiling->mesh_count; mesh++)
+    {
+        max_vertices = tiling->meshes[mesh].vertex_count > max_vertices ? tiling->meshes[mesh].vertex_count : max_vertices;
+        max_indices = tiling->meshes[mesh].index_count > max_indices ? tiling->meshes[mesh].index_count : max_indices;
+    }
+
+    size_t tiles = get_tiling_capacity(tiling, region);
+    *vertex_capacity = tiles * max_vertices;
+    *index_capacity = tiles * max_indices;
+}
+
+size_t generate_tiling_geometry(
+    const struct Tiling *tiling,
+    const float *region,
+    float *vertices,
+    unsigned int *indices,
+    size_t *vertex_count)
+{
+    struct TileGeometry geometry = { vertices, indices, 0, 0 };
+    for (int mesh = 0; mesh < tiling->mesh_count; mesh++)
+    {
+        place_mesh_tiles(tiling, region, mesh, NULL, &geometry);
+    }
+
+    *vertex_count = geometry.vertex_count;
+    return geometry.index_count;
+}
+
+void get_tiling_region(const struct Tiling *tiling, size_t tile_count, float *region)
+{
+    const float (*lattice)[2] = tiling->lattice;
+    double cell_area = fabs((double)lattice[0][0] * lattice[1][1] - (double)lattice[1][0] * lattice[0][1]);
+    double tiles_per_cell = (double)tiling->operation_count * tiling->prototile_count;
+    float half = (float)(0.5 * sqrt((double)tile_count * cell_area / tiles_per_cell));
+
+    region[0] = -half;
+    region[1] = -half;
+    region[2] = half;
+    region[3] = half;
+}
+
+bool init_wallpaper_tiling(struct Tiling *tiling, const struct WallpaperGroup *group)
+{
+    float outline[2 * WALLPAPER_MAX_DOMAIN_VERTICES];
+    struct TilingDescription description = { .group = group };
+    get_default_lattice(group, description.lattice);
+
+    struct Prototile prototile = {
+        .vertices = outline,
+        .vertex_count = get_fundamental_domain(group, description.lattice, outline),
+        .border_inset = 0.03f,
+        .border_color = { 1.0f, 1.0f, 1.0f },
+        .fill_colors = { { 0.2f, 0.5f, 0.8f }, { 0.9f, 0.9f, 0.2f } }
+    };
+
+    description.prototiles = &prototile;
+    description.prototile_count = 1;
+    return init_tiling(tiling, &description);
+}
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include <common.h>
+#include <graphics/wallpaper.h>
+
+#include <string.h>
+
+// x' = m0 x + m1 y + tx, y' = m2 x + m3 y + ty
+#define OP(m0, m1, m2, m3, tx, ty) { { m0, m1, m2, m3 }, { tx, ty } }
+
+#define IDENTITY    OP( 1,  0,  0,  1, 0.0f, 0.0f)
+#define ROTATE_180  OP(-1,  0,  0, -1, 0.0f, 0.0f)
+#define MIRROR_X    OP(-1,  0,  0,  1, 0.0f, 0.0f)
+#define MIRROR_Y    OP( 1,  0,  0, -1, 0.0f, 0.0f)
+
+// Square lattice.
+#define ROTATE_90   OP( 0, -1,  1,  0, 0.0f, 0.0f)
+#define ROTATE_270  OP( 0,  1, -1,  0, 0.0f, 0.0f)
+#define MIRROR_XY   OP( 0,  1,  1,  0, 0.0f, 0.0f)
+#define MIRROR_NXY  OP( 0, -1, -1,  0, 0.0f, 0.0f)
+
+// Hexagonal lattice.
+#define ROTATE_120  OP( 0, -1,  1, -1, 0.0f, 0.0f)
+#define ROTATE_240  OP(-1,  1, -1,  0, 0.0f, 0.0f)
+#define ROTATE_60   OP( 1, -1,  1,  0, 0.0f, 0.0f)
+#define ROTATE_300  OP( 0,  1, -1,  1, 0.0f, 0.0f)
+#define MIRROR_H1   OP( 0, -1, -1,  0, 0.0f, 0.0f)
+#define MIRROR_H2   OP(-1,  1,  0,  1, 0.0f, 0.0f)
+#define MIRROR_H3   OP( 1,  0,  1, -1, 0.0f, 0.0f)
+#define MIRROR_H4   OP( 0,  1,  1,  0, 0.0f, 0.0f)
+#define MIRROR_H5   OP( 1, -1,  0, -1, 0.0f, 0.0f)
+#define MIRROR_H6   OP(-1,  0, -1,  1, 0.0f, 0.0f)
+
+// Operations and asymmetric units follow the International Tables for
+// Crystallography, Vol. A, except where a simpler convex domain of the same
+// area exists.
+static const struct WallpaperGroup wallpaper_groups[WALLPAPER_GROUP_COUNT] = {
+    {
+        "p1", LATTICE_OBLIQUE,
+        1, { IDENTITY },
+        4, { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } }
+    },
+    {
+        "p2", LATTICE_OBLIQUE,
+        2, { IDENTITY, ROTATE_180 },
+        4, { { 0.0f, 0.0f }, { 0.5f, 0.0f }, { 0.5f, 1.0f }, { 0.0f, 1.0f } }
+    },
+    {
+        "pm", LATTICE_RECTANGULAR,
+        2, { IDENTITY, MIRROR_X },
+        4, { { 0.0f, 0.0f }, { 0.5f, 0.0f }, { 0.5f, 1.0f }, { 0.0f, 1.0f } }
+    },
+    {
+        "pg", LATTICE_RECTANGULAR,
+        2, { IDENTITY, OP(-1, 0, 0, 1, 0.0f, 0.5f) },
+        4, { { 0.0f, 0.0f }, { 0.5f, 0.0f }, { 0.5f, 1.0f }, { 0.0f, 1.0f } }
+    },
+    {
+        "cm", LATTICE_RECTANGULAR,
+        4, {
+            IDENTITY, MIRROR_X,
+            OP(1, 0, 0, 1, 0.5f, 0.5f), OP(-1, 0, 0, 1, 0.5f, 0.5f)
+        },
+        4, { { 0.0f, 0.0f }, { 0.5f, 0.0f }, { 0.5f, 0.5f }, { 0.0f, 0.5f } }
+    },
+    {
+        "pmm", LATTICE_RECTANGULAR,
+        4, { IDENTITY, ROTATE_180, MIRROR_X, MIRROR_Y },
+        4, { { 0.0f, 0.0f }, { 0.5f, 0.0f }, { 0.5f, 0.5f }, { 0.0f, 0.5f } }
+    },
+    {
+        "pmg", LATTICE_RECTANGULAR,
+        4, {
+            IDENTITY, ROTATE_180,
+            OP(-1, 0, 0, 1, 0.5f, 0.0f), OP(1, 0, 0, -1, 0.5f, 0.0f)
+        },
+        4, { { 0.0f, 0.0f }, { 0.25f, 0.0f }, { 0.25f, 1.0f }, { 0.0f, 1.0f } }
+    },
+    {
+        "pgg", LATTICE_RECTANGULAR,
+        4, {
+            IDENTITY, ROTATE_180,
+            OP(-1, 0, 0, 1, 0.5f, 0.5f), OP(1, 0, 0, -1, 0.5f, 0.5f)
+        },
+        4, { { 0.0f, 0.0f }, { 0.5f, 0.0f }, { 0.5f, 0.5f }, { 0.0f, 0.5f } }
+    },
+    {
+        "cmm", LATTICE_RECTANGULAR,
+        8, {
+            IDENTITY, ROTATE_180, MIRROR_X, MIRROR_Y,
+            OP( 1, 0, 0,  1, 0.5f, 0.5f), OP(-1, 0, 0, -1, 0.5f, 0.5f),
+            OP(-1, 0, 0,  1, 0.5f, 0.5f), OP( 1, 0, 0, -1, 0.5f, 0.5f)
+        },
+        4, { { 0.0f, 0.0f }, { 0.25f, 0.0f }, { 0.25f, 0.5f }, { 0.0f, 0.5f } }
+    },
+    {
+        "p4", LATTICE_SQUARE,
+        4, { IDENTITY, ROTATE_180, ROTATE_90, ROTATE_270 },
+        4, { { 0.0f, 0.0f }, { 0.5f, 0.0f }, { 0.5f, 0.5f }, { 0.0f, 0.5f } }
+    },
+    {
+        "p4m", LATTICE_SQUARE,
+        8, {
+            IDENTITY, ROTATE_180, ROTATE_90, ROTATE_270,
+            MIRROR_X, MIRROR_Y, MIRROR_XY, MIRROR_NXY
+        },
+        3, { { 0.0f, 0.0f }, { 0.5f, 0.0f }, { 0.5f, 0.5f } }
+    },
+    {
+        "p4g", LATTICE_SQUARE,
+        8, {
+            IDENTITY, ROTATE_180, ROTATE_90, ROTATE_270,
+            OP(-1,  0,  0,  1, 0.5f, 0.5f), OP( 1,  0,  0, -1, 0.5f, 0.5f),
+            OP( 0,  1,  1,  0, 0.5f, 0.5f), OP( 0, -1, -1,  0, 0.5f, 0.5f)
+        },
+        3, { { 0.0f, 0.0f }, { 0.5f, 0.0f }, { 0.0f, 0.5f } }
+    },
+    {
+        "p3", LATTICE_HEXAGONAL,
+        3, { IDENTITY, ROTATE_120, ROTATE_240 },
+        5, {
+            { 0.0f, 0.0f }, { 0.5f, 0.0f }, { 2.0f / 3.0f, 1.0f / 3.0f },
+            { 1.0f / 3.0f, 2.0f / 3.0f }, { 0.0f, 0.5f }
+        }
+    },
+    {
+        "p3m1", LATTICE_HEXAGONAL,
+        6, { IDENTITY, ROTATE_120, ROTATE_240, MIRROR_H1, MIRROR_H2, MIRROR_H3 },
+        3, { { 0.0f, 0.0f }, { 2.0f / 3.0f, 1.0f / 3.0f }, { 1.0f / 3.0f, 2.0f / 3.0f } }
+    },
+    {
+        "p31m", LATTICE_HEXAGONAL,
+        6, { IDENTITY, ROTATE_120, ROTATE_240, MIRROR_H4, MIRROR_H5, MIRROR_H6 },
+        3, { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 2.0f / 3.0f, 1.0f / 3.0f } }
+    },
+    {
+        "p6", LATTICE_HEXAGONAL,
+        6, { IDENTITY, ROTATE_120, ROTATE_240, ROTATE_180, ROTATE_300, ROTATE_60 },
+        3, { { 0.0f, 0.0f }, { 2.0f / 3.0f, 1.0f / 3.0f }, { 1.0f / 3.0f, 2.0f / 3.0f } }
+    },
+    {
+        "p6m", LATTICE_HEXAGONAL,
+        12, {
+            IDENTITY, ROTATE_120, ROTATE_240, ROTATE_180, ROTATE_300, ROTATE_60,
+            MIRROR_H1, MIRROR_H2, MIRROR_H3, MIRROR_H4, MIRROR_H5, MIRROR_H6
+        },
+        3, { { 0.0f, 0.0f }, { 0.5f, 0.0f }, { 2.0f / 3.0f, 1.0f / 3.0f } }
+    }
+};
+
+const struct WallpaperGroup* get_wallpaper_group(int index)
+{
+    return &wallpaper_groups[index];
+}
+
+const struct WallpaperGroup* find_wallpaper_group(const char *name)
+{
+    for (int i = 0; i < WALLPAPER_GROUP_COUNT; i++)
+    {
+        if (strcmp(wallpaper_groups[i].name, name) == 0)
+            return &wallpaper_groups[i];
+    }
+
+    return NULL;
+}
+
+void get_default_lattice(const struct WallpaperGroup *group, float lattice[2][2])
+{
+    static const float lattices[][2][2] = {
+        [LATTICE_OBLIQUE]     = { { 1.0f, 0.0f }, { 0.3f, 0.9f } },
+        [LATTICE_RECTANGULAR] = { { 1.0f, 0.0f }, { 0.0f, 0.75f } },
+        [LATTICE_SQUARE]      = { { 1.0f, 0.0f }, { 0.0f, 1.0f } },
+        [LATTICE_HEXAGONAL]   = { { 1.0f, 0.0f }, { -0.5f, 0.8660254f } }
+    };
+
+    memcpy(lattice, lattices[group->lattice], sizeof(lattices[0]));
+}
+
+int get_fundamental_domain(const struct WallpaperGroup *group, const float lattice[2][2], float *vertices)
+{
+    for (int i = 0; i < group->domain_vertex_count; i++)
+    {
+        float u = group->domain[i][0];
+        float v = group->domain[i][1];
+        vertices[2 * i + 0] = u * lattice[0][0] + v * lattice[1][0];
+        vertices[2 * i + 1] = u * lattice[0][1] + v * lattice[1][1];
+    }
+
+    return group->domain_vertex_count;
+}
\ No newline at end of file
@@ -3,9 +3,24 @@
 
 #include <stdlib.h>
 
-int main()
+int main(int argc, char **argv)
 {
     struct Application *app = get_app_instance();
+    if (!parse_app_config(&app->config, argc, argv))
+    {
+        LOG_FATAL(
+            "Usage: %s [--compare-draw] [--frames <count>] "
+            "[--headless] [--backend gl|cpu] [--threads <count>] [--tiles <count>] [--group <name>] [--penrose <depth>] [--procedural] "
+            "[--width <pixels>] [--height <pixels>] [--strip-height <rows>] [--output <path>] "
+            "[--png-level 0-9] [--png-filter none|sub|up|average|paeth|adaptive] [--sequence <prefix>] "
+            "[--on-demand] [--max-fps <rate>] [--vsync on|off] [--vertex-positions float|snorm16|half] [--vertex-colors unorm8|palette] "
+            "[--shader-cache <dir>] [--no-shader-cache] "
+            "[--log-level trace|info|warn|error|fatal] [--log-binary <path>] [--stats <path>] [--stats-interval <frames>] [--profile <path>]",
+            argv[0]
+        );
+        exit(1);
+    }
+
     if (!init_app(app))
     {
         LOG_FATAL("Failed to initialise application!");
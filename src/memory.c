@@ -1,32 +1,571 @@
 #include <memory.h>
+#include <core/assert.h>
+#include <core/log.h>
 
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 
-static size_t memory_allocated = 0;
-static size_t memory_freed = 0;
+// Usage is tracked per tag and in one more slot for all tags together.
+#define USAGE_SLOTS (MEMORY_TAG_COUNT + 1)
+#define USAGE_TOTAL MEMORY_TAG_COUNT
 
-void* reallocate(void *block, size_t old_size, size_t new_size)
+static const char* memory_tag_names[MEMORY_TAG_COUNT] = {
+    "general",
+    "export",
+    "geometry",
+    "shader",
+    "log",
+    "profile"
+};
+
+// Counters of one thread. Only the owner writes them, so updates are plain
+// relaxed loads and stores with no locked instructions; readers sum every
+// thread's counters under thread_mutex.
+struct ThreadMemory
+{
+    struct ThreadMemory *previous;
+    struct ThreadMemory *next;
+
+    _Atomic size_t allocated[MEMORY_TAG_COUNT];
+    _Atomic size_t freed[MEMORY_TAG_COUNT];
+    _Atomic size_t allocation_count[MEMORY_TAG_COUNT];
+    _Atomic size_t free_count[MEMORY_TAG_COUNT];
+
+    // Net change in use not yet added to in_use, per tag and over all tags,
+    // and the highest it has been since it was last published. Only the
+    // owner writes them.
+    _Atomic int64_t unpublished[USAGE_SLOTS];
+    _Atomic int64_t unpublished_high[USAGE_SLOTS];
+};
+
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_key;
+static pthread_mutex_t thread_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct ThreadMemory *threads = NULL;
+static _Thread_local struct ThreadMemory *thread_memory = NULL;
+
+// Counters of threads that have exited.
+static _Atomic size_t retired_allocated[MEMORY_TAG_COUNT];
+static _Atomic size_t retired_freed[MEMORY_TAG_COUNT];
+static _Atomic size_t retired_allocation_count[MEMORY_TAG_COUNT];
+static _Atomic size_t retired_free_count[MEMORY_TAG_COUNT];
+
+// Published usage, for the high-water marks.
+static _Atomic int64_t in_use[USAGE_SLOTS];
+static _Atomic int64_t peak[USAGE_SLOTS];
+
+static void raise_peak(_Atomic int64_t *peak, int64_t value)
+{
+    int64_t current = atomic_load_explicit(peak, memory_order_relaxed);
+    while (value > current &&
+        !atomic_compare_exchange_weak_explicit(peak, &current, value, memory_order_relaxed, memory_order_relaxed))
+    {
+    }
+}
+
+// The peak since the last publish was the published usage at that time
+// plus the unpublished high, which is exact while only one thread uses the
+// slot.
+static void publish_usage(struct ThreadMemory *memory, int slot)
+{
+    int64_t delta = atomic_load_explicit(&memory->unpublished[slot], memory_order_relaxed);
+    int64_t high = atomic_load_explicit(&memory->unpublished_high[slot], memory_order_relaxed);
+    atomic_store_explicit(&memory->unpublished[slot], 0, memory_order_relaxed);
+    atomic_store_explicit(&memory->unpublished_high[slot], 0, memory_order_relaxed);
+
+    int64_t usage = atomic_fetch_add_explicit(&in_use[slot], delta, memory_order_relaxed);
+    raise_peak(&peak[slot], usage + high);
+}
+
+static void add_counter(_Atomic size_t *counter, size_t value)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+static void add_usage(struct ThreadMemory *memory, int slot, int64_t delta)
+{
+    int64_t unpublished = atomic_load_explicit(&memory->unpublished[slot], memory_order_relaxed) + delta;
+    atomic_store_explicit(&memory->unpublished[slot], unpublished, memory_order_relaxed);
+
+    if (unpublished > atomic_load_explicit(&memory->unpublished_high[slot], memory_order_relaxed))
+    {
+        atomic_store_explicit(&memory->unpublished_high[slot], unpublished, memory_order_relaxed);
+    }
+
+    if (unpublished >= MEMORY_PUBLISH_BYTES || unpublished <= -MEMORY_PUBLISH_BYTES)
+    {
+        publish_usage(memory, slot);
+    }
+}
+
+// Folds the counters of an exiting thread into the retired totals.
+static void retire_thread_memory(void *data)
+{
+    struct ThreadMemory *memory = (struct ThreadMemory*)data;
+
+    pthread_mutex_lock(&thread_mutex);
+    for (int slot = 0; slot < USAGE_SLOTS; slot++)
+    {
+        publish_usage(memory, slot);
+    }
+
+    for (int tag = 0; tag < MEMORY_TAG_COUNT; tag++)
+    {
+        atomic_fetch_add_explicit(&retired_allocated[tag], memory->allocated[tag], memory_order_relaxed);
+        atomic_fetch_add_explicit(&retired_freed[tag], memory->freed[tag], memory_order_relaxed);
+        atomic_fetch_add_explicit(&retired_allocation_count[tag], memory->allocation_count[tag], memory_order_relaxed);
+        atomic_fetch_add_explicit(&retired_free_count[tag], memory->free_count[tag], memory_order_relaxed);
+    }
+
+    if (memory->previous != NULL)
+    {
+        memory->previous->next = memory->next;
+    }
+
+    else
+    {
+        threads = memory->next;
+    }
+
+    if (memory->next != NULL)
+    {
+        memory->next->previous = memory->previous;
+    }
+    pthread_mutex_unlock(&thread_mutex);
+
+    free(memory);
+    thread_memory = NULL;
+}
+
+static void create_thread_key()
+{
+    pthread_key_create(&thread_key, retire_thread_memory);
+}
+
+static struct ThreadMemory* get_thread_memory()
+{
+    if (thread_memory != NULL)
+        return thread_memory;
+
+    // Bookkeeping of the accounting itself is not counted.
+    struct ThreadMemory *memory = (struct ThreadMemory*)calloc(1, sizeof(struct ThreadMemory));
+    if (memory == NULL)
+        return NULL;
+
+    pthread_once(&thread_key_once, create_thread_key);
+    pthread_setspecific(thread_key, memory);
+
+    pthread_mutex_lock(&thread_mutex);
+    memory->next = threads;
+    if (threads != NULL)
+    {
+        threads->previous = memory;
+    }
+    threads = memory;
+    pthread_mutex_unlock(&thread_mutex);
+
+    thread_memory = memory;
+    return memory;
+}
+
+static void count_change(size_t old_size, size_t new_size, bool allocation, bool release, enum MemoryTag tag)
+{
+    struct ThreadMemory *memory = get_thread_memory();
+    if (memory == NULL)
+        return;
+
+    int64_t delta;
+    if (new_size >= old_size)
+    {
+        add_counter(&memory->allocated[tag], new_size - old_size);
+        delta = (int64_t)(new_size - old_size);
+    }
+
+    else
+    {
+        add_counter(&memory->freed[tag], old_size - new_size);
+        delta = -(int64_t)(old_size - new_size);
+    }
+
+    if (allocation)
+    {
+        add_counter(&memory->allocation_count[tag], 1);
+    }
+
+    if (release)
+    {
+        add_counter(&memory->free_count[tag], 1);
+    }
+
+    add_usage(memory, tag, delta);
+    add_usage(memory, USAGE_TOTAL, delta);
+}
+
+void* reallocate_tagged(void *block, size_t old_size, size_t new_size, enum MemoryTag tag)
 {
     if (new_size == 0)
     {
         free(block);
-        memory_freed += old_size;
+        if (block != NULL)
+        {
+            count_change(old_size, 0, false, true, tag);
+        }
         return NULL;
     }
 
-    int diff = new_size - old_size;
-    memory_allocated += diff * (diff >= 0);
-    memory_freed += -diff * (diff < 0);
+    void *result = realloc(block, new_size);
+    if (result != NULL)
+    {
+        count_change(old_size, new_size, block == NULL, false, tag);
+    }
+
+    return result;
+}
+
+// Includes what threads have not published yet. Exact while a slot is used
+// from one thread; otherwise the threads' highs may not have coincided and
+// the result can be too high by MEMORY_PUBLISH_BYTES per thread.
+static size_t get_peak(int slot)
+{
+    int64_t usage = atomic_load_explicit(&in_use[slot], memory_order_relaxed);
+    for (struct ThreadMemory *memory = threads; memory != NULL; memory = memory->next)
+    {
+        usage += atomic_load_explicit(&memory->unpublished_high[slot], memory_order_relaxed);
+    }
+
+    int64_t published = atomic_load_explicit(&peak[slot], memory_order_relaxed);
+    usage = published > usage ? published : usage;
+
+    return usage > 0 ? (size_t)usage : 0;
+}
+
+void get_memory_stats(enum MemoryTag tag, struct MemoryStats *stats)
+{
+    pthread_mutex_lock(&thread_mutex);
+    stats->allocated = atomic_load_explicit(&retired_allocated[tag], memory_order_relaxed);
+    stats->freed = atomic_load_explicit(&retired_freed[tag], memory_order_relaxed);
+    stats->allocation_count = atomic_load_explicit(&retired_allocation_count[tag], memory_order_relaxed);
+    stats->free_count = atomic_load_explicit(&retired_free_count[tag], memory_order_relaxed);
+
+    for (struct ThreadMemory *memory = threads; memory != NULL; memory = memory->next)
+    {
+        stats->allocated += atomic_load_explicit(&memory->allocated[tag], memory_order_relaxed);
+        stats->freed += atomic_load_explicit(&memory->freed[tag], memory_order_relaxed);
+        stats->allocation_count += atomic_load_explicit(&memory->allocation_count[tag], memory_order_relaxed);
+        stats->free_count += atomic_load_explicit(&memory->free_count[tag], memory_order_relaxed);
+    }
 
-    return realloc(block, new_size);
+    stats->peak = get_peak(tag);
+    pthread_mutex_unlock(&thread_mutex);
 }
 
 size_t get_memory_allocated()
 {
-    return memory_allocated;
+    size_t allocated = 0;
+    for (int tag = 0; tag < MEMORY_TAG_COUNT; tag++)
+    {
+        struct MemoryStats stats;
+        get_memory_stats((enum MemoryTag)tag, &stats);
+        allocated += stats.allocated;
+    }
+
+    return allocated;
 }
 
 size_t get_memory_freed()
 {
-    return memory_freed;
+    size_t freed = 0;
+    for (int tag = 0; tag < MEMORY_TAG_COUNT; tag++)
+    {
+        struct MemoryStats stats;
+        get_memory_stats((enum MemoryTag)tag, &stats);
+        freed += stats.freed;
+    }
+
+    return freed;
+}
+
+size_t get_memory_peak()
+{
+    pthread_mutex_lock(&thread_mutex);
+    size_t result = get_peak(USAGE_TOTAL);
+    pthread_mutex_unlock(&thread_mutex);
+
+    return result;
+}
+
+const char* get_memory_tag_name(enum MemoryTag tag)
+{
+    return tag >= 0 && tag < MEMORY_TAG_COUNT ? memory_tag_names[tag] : "unknown";
+}
+
+void log_memory_report()
+{
+    LOG_INFO("Memory allocated: %zu", get_memory_allocated());
+    LOG_INFO("Memory freed: %zu", get_memory_freed());
+    LOG_INFO("Memory peak: %zu", get_memory_peak());
+
+    for (int tag = 0; tag < MEMORY_TAG_COUNT; tag++)
+    {
+        struct MemoryStats stats;
+        get_memory_stats((enum MemoryTag)tag, &stats);
+        if (stats.allocation_count == 0)
+            continue;
+
+        LOG_INFO(
+            "Memory %-8s | peak %zu | allocated %zu in %zu blocks",
+            get_memory_tag_name((enum MemoryTag)tag),
+            stats.peak,
+            stats.allocated,
+            stats.allocation_count
+        );
+
+        if (stats.allocated != stats.freed || stats.allocation_count != stats.free_count)
+        {
+            LOG_WARN(
+                "Memory %-8s | leaked %zu bytes in %zu blocks",
+                get_memory_tag_name((enum MemoryTag)tag),
+                stats.allocated - stats.freed,
+                stats.allocation_count - stats.free_count
+            );
+        }
+    }
+}
+
+struct ArenaBlock
+{
+    struct ArenaBlock *next;
+    size_t size;
+    size_t offset;
+    alignas(max_align_t) uint8_t data[];
+};
+
+static struct ArenaBlock* create_arena_block(size_t size, enum MemoryTag tag)
+{
+    struct ArenaBlock *block = (struct ArenaBlock*)reallocate_tagged(NULL, 0, sizeof(struct ArenaBlock) + size, tag);
+    if (block == NULL)
+        return NULL;
+
+    block->next = NULL;
+    block->size = size;
+    block->offset = 0;
+
+    return block;
+}
+
+void init_arena(struct Arena *arena, size_t block_size, enum MemoryTag tag)
+{
+    arena->tag = tag;
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->block_size = block_size > 0 ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+    arena->used = 0;
+    arena->reserved = 0;
+}
+
+void destroy_arena(struct Arena *arena)
+{
+    struct ArenaBlock *block = arena->first;
+    while (block != NULL)
+    {
+        struct ArenaBlock *next = block->next;
+        reallocate_tagged(block, sizeof(struct ArenaBlock) + block->size, 0, arena->tag);
+        block = next;
+    }
+
+    init_arena(arena, arena->block_size, arena->tag);
+}
+
+static size_t align_offset(size_t offset, size_t alignment)
+{
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+// Offset of the first address in block at or after offset that is aligned.
+static size_t align_in_block(const struct ArenaBlock *block, size_t offset, size_t alignment)
+{
+    uintptr_t base = (uintptr_t)block->data;
+    return align_offset(base + offset, alignment) - base;
+}
+
+void* arena_allocate(struct Arena *arena, size_t size, size_t alignment)
+{
+    // Blocks after current are empty: they were kept by a reset or rewind.
+    struct ArenaBlock *block = arena->current;
+    while (block != NULL)
+    {
+        size_t offset = align_in_block(block, block->offset, alignment);
+        if (offset <= block->size && size <= block->size - offset)
+        {
+            arena->used += offset + size - block->offset;
+            block->offset = offset + size;
+            arena->current = block;
+            return block->data + offset;
+        }
+
+        block = block->next;
+    }
+
+    // Data is aligned to max_align_t, so larger alignments need slack.
+    size_t slack = alignment > alignof(max_align_t) ? alignment : 0;
+    size_t block_size = size + slack > arena->block_size ? size + slack : arena->block_size;
+    block = create_arena_block(block_size, arena->tag);
+    if (block == NULL)
+        return NULL;
+
+    arena->reserved += block_size;
+
+    // Goes right after current so the empty blocks behind it stay reachable.
+    if (arena->current == NULL)
+    {
+        block->next = arena->first;
+        arena->first = block;
+    }
+
+    else
+    {
+        block->next = arena->current->next;
+        arena->current->next = block;
+    }
+    arena->current = block;
+
+    size_t offset = align_in_block(block, 0, alignment);
+    block->offset = offset + size;
+    arena->used += offset + size;
+
+    return block->data + offset;
+}
+
+void reset_arena(struct Arena *arena)
+{
+    for (struct ArenaBlock *block = arena->first; block != NULL; block = block->next)
+    {
+        block->offset = 0;
+    }
+
+    arena->current = arena->first;
+    arena->used = 0;
+}
+
+struct ArenaMark get_arena_mark(const struct Arena *arena)
+{
+    struct ArenaMark mark;
+    mark.block = arena->current;
+    mark.offset = arena->current != NULL ? arena->current->offset : 0;
+    mark.used = arena->used;
+
+    return mark;
+}
+
+void rewind_arena(struct Arena *arena, struct ArenaMark mark)
+{
+    if (mark.block == NULL)
+    {
+        reset_arena(arena);
+        return;
+    }
+
+    mark.block->offset = mark.offset;
+    for (struct ArenaBlock *block = mark.block->next; block != NULL; block = block->next)
+    {
+        block->offset = 0;
+    }
+
+    arena->current = mark.block;
+    arena->used = mark.used;
+}
+
+struct PoolChunk
+{
+    struct PoolChunk *next;
+    alignas(max_align_t) uint8_t data[];
+};
+
+#define POOL_CHUNK_BYTES (64 * 1024)
+
+void init_block_pool(struct BlockPool *pool, size_t block_size, size_t blocks_per_chunk, enum MemoryTag tag)
+{
+    // Free blocks hold the free list link, and every block stays aligned
+    // for any type.
+    if (block_size < sizeof(void*))
+    {
+        block_size = sizeof(void*);
+    }
+    block_size = align_offset(block_size, alignof(max_align_t));
+
+    if (blocks_per_chunk == 0)
+    {
+        blocks_per_chunk = POOL_CHUNK_BYTES / block_size;
+        blocks_per_chunk = blocks_per_chunk > 0 ? blocks_per_chunk : 1;
+    }
+
+    pool->tag = tag;
+    pool->block_size = block_size;
+    pool->blocks_per_chunk = blocks_per_chunk;
+    pool->chunks = NULL;
+    pool->free_list = NULL;
+    pool->next = NULL;
+    pool->end = NULL;
+    pool->live_count = 0;
+}
+
+void destroy_block_pool(struct BlockPool *pool)
+{
+    size_t chunk_size = sizeof(struct PoolChunk) + pool->block_size * pool->blocks_per_chunk;
+
+    struct PoolChunk *chunk = pool->chunks;
+    while (chunk != NULL)
+    {
+        struct PoolChunk *next = chunk->next;
+        reallocate_tagged(chunk, chunk_size, 0, pool->tag);
+        chunk = next;
+    }
+
+    init_block_pool(pool, pool->block_size, pool->blocks_per_chunk, pool->tag);
+}
+
+void* pool_allocate(struct BlockPool *pool, size_t size)
+{
+    ASSERT(size <= pool->block_size, "Pool blocks of %zu bytes cannot hold %zu", pool->block_size, size);
+    if (size > pool->block_size)
+        return NULL;
+
+    void *block = pool->free_list;
+    if (block != NULL)
+    {
+        pool->free_list = *(void**)block;
+        pool->live_count++;
+        return block;
+    }
+
+    if (pool->next == pool->end)
+    {
+        size_t size = pool->block_size * pool->blocks_per_chunk;
+        struct PoolChunk *chunk = (struct PoolChunk*)reallocate_tagged(NULL, 0, sizeof(struct PoolChunk) + size, pool->tag);
+        if (chunk == NULL)
+            return NULL;
+
+        chunk->next = pool->chunks;
+        pool->chunks = chunk;
+        pool->next = chunk->data;
+        pool->end = chunk->data + size;
+    }
+
+    block = pool->next;
+    pool->next += pool->block_size;
+    pool->live_count++;
+
+    return block;
+}
+
+void pool_free(struct BlockPool *pool, void *block)
+{
+    if (block == NULL)
+        return;
+
+    *(void**)block = pool->free_list;
+    pool->free_list = block;
+    pool->live_count--;
 }
\ No newline at end of file
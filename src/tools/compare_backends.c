@@ -0,0 +1,287 @@
+#include <common.h>
+#include <memory.h>
+#include <core/headless.h>
+#include <core/log.h>
+#include <core/thread_pool.h>
+#include <graphics/framebuffer.h>
+#include <graphics/raster.h>
+#include <graphics/tile_renderer.h>
+#include <graphics/tiling.h>
+#include <graphics/wallpaper.h>
+
+#include <cglm/call.h>
+#include <glad/glad.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Renders the demo tiling and every wallpaper group through the GL and the
+// CPU backend, as the application shows them by default, and fails unless
+// the two images match pixel for pixel:
+//
+//     compare_backends [--width <pixels>] [--height <pixels>]
+//
+// Exits with 0 when every scene matches, 1 when one does not and
+// COMPARE_SKIPPED when no headless GL context can be created.
+
+#define COMPARE_WIDTH 1920
+#define COMPARE_HEIGHT 1080
+#define COMPARE_SKIPPED 77
+
+// Both backends drawing into images of the same size.
+struct BackendPair
+{
+    int width;
+    int height;
+    struct ThreadPool *pool;
+    struct Framebuffer framebuffer;
+    struct RasterTarget target;
+    uint8_t *gl_pixels;
+};
+
+// The application's default camera: the tiling seen head on, 4 units tall.
+static void compute_default_camera(int width, int height, mat4 view, mat4 projection)
+{
+    float aspect_ratio = 2.0f * (float)width / (float)height;
+
+    glmc_lookat(
+        (vec3){ 0.0f, 0.0f, -3.0f },
+        (vec3){ 0.0f, 0.0f,  0.0f },
+        (vec3){ 0.0f, 1.0f,  0.0f },
+        view
+    );
+    glmc_ortho(-aspect_ratio, aspect_ratio, -2.0f, 2.0f, 0.1f, 100.0f, projection);
+}
+
+static bool draw_with_backend(
+    struct BackendPair *pair,
+    enum RenderBackend backend,
+    const struct TileMesh *meshes,
+    int mesh_count,
+    const struct TileInstance *instances,
+    const size_t *counts)
+{
+    struct TileRenderer renderer;
+    if (!init_tile_renderer(&renderer, backend, meshes, mesh_count, NULL, pair->pool))
+        return false;
+
+    mat4 view, projection;
+    compute_default_camera(pair->width, pair->height, view, projection);
+    set_tile_view(&renderer, (float*)view, (float*)projection);
+    set_tile_render_target(&renderer, &pair->target);
+    set_tile_instances(&renderer, instances, counts);
+
+    clear_tiles(&renderer, (float[]){ 0.0f, 0.0f, 0.0f, 1.0f });
+    draw_tiles(&renderer, TILE_DRAW_INSTANCED);
+
+    if (backend == RENDER_BACKEND_GL)
+    {
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, pair->width, pair->height, GL_RGBA, GL_UNSIGNED_BYTE, pair->gl_pixels);
+    }
+
+    destroy_tile_renderer(&renderer);
+    return true;
+}
+
+// Both images are bottom-up RGBA rows. Logs the first pixel that differs.
+static bool compare_scene(
+    struct BackendPair *pair,
+    const char *name,
+    const struct TileMesh *meshes,
+    int mesh_count,
+    const struct TileInstance *instances,
+    const size_t *counts)
+{
+    if (!draw_with_backend(pair, RENDER_BACKEND_GL, meshes, mesh_count, instances, counts) ||
+        !draw_with_backend(pair, RENDER_BACKEND_CPU, meshes, mesh_count, instances, counts))
+    {
+        LOG_ERROR("%-16s | failed to set up the renderers", name);
+        return false;
+    }
+
+    size_t pixel_count = (size_t)pair->width * pair->height;
+    size_t different = 0;
+    size_t first = 0;
+    for (size_t i = 0; i < pixel_count; i++)
+    {
+        if (memcmp(pair->gl_pixels + 4 * i, pair->target.pixels + 4 * i, 4) != 0 && different++ == 0)
+        {
+            first = i;
+        }
+    }
+
+    if (different > 0)
+    {
+        const uint8_t *gl = pair->gl_pixels + 4 * first;
+        const uint8_t *cpu = pair->target.pixels + 4 * first;
+        LOG_ERROR(
+            "%-16s | %zu of %zu pixels differ, first at %zu, %zu: GL %u %u %u %u, CPU %u %u %u %u",
+            name, different, pixel_count,
+            first % (size_t)pair->width, pair->height - 1 - first / (size_t)pair->width,
+            gl[0], gl[1], gl[2], gl[3], cpu[0], cpu[1], cpu[2], cpu[3]
+        );
+        return false;
+    }
+
+    LOG_INFO("%-16s | %zu pixels match", name, pixel_count);
+    return true;
+}
+
+static bool compare_demo_tiling(struct BackendPair *pair, size_t tile_count)
+{
+    unsigned int columns = DEMO_TILING_COLUMNS;
+    unsigned int rows = DEMO_TILING_ROWS;
+    if (tile_count > 0)
+    {
+        get_tiling_size(tile_count, &columns, &rows);
+    }
+
+    size_t count = 2 * (size_t)rows * columns;
+    struct TileInstance *instances = ALLOC_ARRAY(struct TileInstance, count);
+    if (instances == NULL)
+        return false;
+
+    struct TileMesh meshes[DEMO_TILE_MESH_COUNT];
+    size_t counts[DEMO_TILE_MESH_COUNT];
+    get_demo_tile_meshes(meshes);
+    build_tiling(instances, counts, columns, rows);
+
+    char name[32];
+    snprintf(name, sizeof(name), "demo/%zu", count);
+    bool matched = compare_scene(pair, name, meshes, DEMO_TILE_MESH_COUNT, instances, counts);
+
+    FREE_ARRAY(instances, struct TileInstance, count);
+    return matched;
+}
+
+// The group's tiles over the view, as --group shows them.
+static bool compare_wallpaper_group(struct BackendPair *pair, const struct WallpaperGroup *group)
+{
+    struct Tiling tiling;
+    if (!init_wallpaper_tiling(&tiling, group))
+        return false;
+
+    mat4 view, projection;
+    float region[4];
+    compute_default_camera(pair->width, pair->height, view, projection);
+    get_visible_region((float*)view, (float*)projection, region);
+
+    size_t capacity = get_tiling_capacity(&tiling, region);
+    struct TileInstance *instances = ALLOC_ARRAY(struct TileInstance, capacity);
+    if (instances == NULL)
+        return false;
+
+    size_t counts[TILING_MAX_MESHES];
+    generate_tiling(&tiling, region, instances, counts);
+
+    char name[32];
+    snprintf(name, sizeof(name), "wallpaper/%s", group->name);
+    bool matched = compare_scene(pair, name, tiling.meshes, tiling.mesh_count, instances, counts);
+
+    FREE_ARRAY(instances, struct TileInstance, capacity);
+    return matched;
+}
+
+static bool parse_size(const char *text, int *size)
+{
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (*end != '\0' || value < 1 || value > 16384)
+        return false;
+
+    *size = (int)value;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    struct BackendPair pair;
+    memset(&pair, 0, sizeof(struct BackendPair));
+    pair.width = COMPARE_WIDTH;
+    pair.height = COMPARE_HEIGHT;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool valid = i + 1 < argc;
+        if (valid && strcmp(argv[i], "--width") == 0)
+        {
+            valid = parse_size(argv[++i], &pair.width);
+        }
+
+        else if (valid && strcmp(argv[i], "--height") == 0)
+        {
+            valid = parse_size(argv[++i], &pair.height);
+        }
+
+        else
+        {
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            LOG_FATAL("Usage: %s [--width <pixels>] [--height <pixels>]", argv[0]);
+            return 1;
+        }
+    }
+
+    struct HeadlessContext headless;
+    if (!init_headless_context(&headless))
+    {
+        LOG_WARN("No headless GL context, nothing to compare against");
+        return COMPARE_SKIPPED;
+    }
+
+    struct ThreadPool pool;
+    if (!init_thread_pool(&pool, 0))
+    {
+        LOG_FATAL("Failed to start the thread pool");
+        destroy_headless_context(&headless);
+        return 1;
+    }
+    pair.pool = &pool;
+
+    size_t size = 4 * (size_t)pair.width * pair.height;
+    pair.gl_pixels = ALLOC_ARRAY(uint8_t, size);
+    bool ready = pair.gl_pixels != NULL &&
+        create_raster_target(&pair.target, pair.width, pair.height) &&
+        create_framebuffer(&pair.framebuffer, pair.width, pair.height);
+
+    bool matched = ready;
+    if (ready)
+    {
+        LOG_INFO("Comparing the GL and CPU backends at %dx%d", pair.width, pair.height);
+        bind_framebuffer(&pair.framebuffer);
+
+        matched = compare_demo_tiling(&pair, 0) && matched;
+        matched = compare_demo_tiling(&pair, 100000) && matched;
+        for (int i = 0; i < WALLPAPER_GROUP_COUNT; i++)
+        {
+            matched = compare_wallpaper_group(&pair, get_wallpaper_group(i)) && matched;
+        }
+
+        unbind_framebuffer();
+        destroy_framebuffer(&pair.framebuffer);
+    }
+
+    else
+    {
+        LOG_ERROR("Failed to create %dx%d images", pair.width, pair.height);
+    }
+
+    destroy_raster_target(&pair.target);
+    FREE_ARRAY(pair.gl_pixels, uint8_t, size);
+    destroy_thread_pool(&pool);
+    destroy_headless_context(&headless);
+
+    if (!matched)
+    {
+        LOG_ERROR("The backends do not match");
+        return 1;
+    }
+
+    LOG_INFO("The backends match on every scene");
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,307 @@
+#include <common.h>
+#include <memory.h>
+#include <core/log_format.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Turns a binary log written through open_binary_log back into the text the
+// logger would have written, optionally with the source location of every
+// message.
+
+#define TIME_BUFFER_SIZE 25
+
+static const char* log_levels[] = {
+    "TRACE",
+    "INFO",
+    "WARN",
+    "ERROR",
+    "FATAL"
+};
+
+struct DecodedSite
+{
+    char *file;
+    char *format;
+    size_t file_length;
+    size_t format_length;
+    uint32_t line;
+    uint8_t level;
+};
+
+struct Decoder
+{
+    FILE *file;
+    bool locations;
+
+    struct DecodedSite *sites;
+    uint32_t site_capacity;
+
+    uint8_t *buffer;
+    size_t buffer_capacity;
+};
+
+static bool read_value(struct Decoder *decoder, void *value, size_t size)
+{
+    return fread(value, 1, size, decoder->file) == size;
+}
+
+static uint8_t* read_bytes(struct Decoder *decoder, size_t size)
+{
+    if (size + 1 > decoder->buffer_capacity)
+    {
+        decoder->buffer = (uint8_t*)reallocate(decoder->buffer, decoder->buffer_capacity, size + 1);
+        decoder->buffer_capacity = size + 1;
+    }
+
+    if (!read_value(decoder, decoder->buffer, size))
+        return NULL;
+
+    decoder->buffer[size] = '\0';
+    return decoder->buffer;
+}
+
+static char* read_string(struct Decoder *decoder, size_t *length)
+{
+    uint16_t size;
+    if (!read_value(decoder, &size, sizeof(size)))
+        return NULL;
+
+    char *string = ALLOC_ARRAY(char, (size_t)size + 1);
+    if (!read_value(decoder, string, size))
+    {
+        FREE_ARRAY(string, char, (size_t)size + 1);
+        return NULL;
+    }
+
+    string[size] = '\0';
+    *length = size;
+    return string;
+}
+
+static void free_site(struct DecodedSite *site)
+{
+    if (site->format == NULL)
+        return;
+
+    FREE_ARRAY(site->file, char, site->file_length + 1);
+    FREE_ARRAY(site->format, char, site->format_length + 1);
+    site->format = NULL;
+}
+
+static bool read_site(struct Decoder *decoder)
+{
+    uint32_t id;
+    struct DecodedSite site;
+    if (!read_value(decoder, &id, sizeof(id)) ||
+        !read_value(decoder, &site.level, sizeof(site.level)) ||
+        !read_value(decoder, &site.line, sizeof(site.line)))
+    {
+        return false;
+    }
+
+    if (id == 0 || site.level > 4)
+        return false;
+
+    site.file = read_string(decoder, &site.file_length);
+    if (site.file == NULL)
+        return false;
+
+    site.format = read_string(decoder, &site.format_length);
+    if (site.format == NULL)
+    {
+        FREE_ARRAY(site.file, char, site.file_length + 1);
+        return false;
+    }
+
+    if (id >= decoder->site_capacity)
+    {
+        uint32_t capacity = decoder->site_capacity > 0 ? decoder->site_capacity : 64;
+        while (capacity <= id)
+        {
+            capacity *= 2;
+        }
+
+        decoder->sites = (struct DecodedSite*)reallocate(
+            decoder->sites,
+            decoder->site_capacity * sizeof(struct DecodedSite),
+            capacity * sizeof(struct DecodedSite)
+        );
+        memset(decoder->sites + decoder->site_capacity, 0, (capacity - decoder->site_capacity) * sizeof(struct DecodedSite));
+        decoder->site_capacity = capacity;
+    }
+
+    // Concatenated logs define their ids again; the newest definition wins.
+    free_site(&decoder->sites[id]);
+    decoder->sites[id] = site;
+    return true;
+}
+
+static const struct DecodedSite* read_message_header(struct Decoder *decoder, uint64_t *time)
+{
+    uint32_t id;
+    if (!read_value(decoder, &id, sizeof(id)) || !read_value(decoder, time, sizeof(*time)))
+        return NULL;
+
+    if (id >= decoder->site_capacity || decoder->sites[id].format == NULL)
+    {
+        fprintf(stderr, "Message refers to unknown site %u\n", id);
+        return NULL;
+    }
+
+    return &decoder->sites[id];
+}
+
+static void write_header(const struct DecodedSite *site, uint64_t nanoseconds)
+{
+    time_t seconds = (time_t)(nanoseconds / 1000000000ull);
+    struct tm local;
+    char text[TIME_BUFFER_SIZE];
+    localtime_r(&seconds, &local);
+    strftime(text, TIME_BUFFER_SIZE, "%a %d %b %Y %H:%M:%S", &local);
+
+    printf("[%s] %-6s | ", text, log_levels[site->level]);
+}
+
+static void write_footer(const struct Decoder *decoder, const struct DecodedSite *site)
+{
+    if (decoder->locations)
+    {
+        printf(" (%s:%u)", site->file, site->line);
+    }
+    putchar('\n');
+}
+
+static bool decode(struct Decoder *decoder)
+{
+    char magic[sizeof(LOG_BINARY_MAGIC)];
+    uint32_t byte_order;
+    if (!read_value(decoder, magic, sizeof(magic)) || memcmp(magic, LOG_BINARY_MAGIC, sizeof(magic)) != 0 ||
+        !read_value(decoder, &byte_order, sizeof(byte_order)))
+    {
+        fprintf(stderr, "Not a binary log\n");
+        return false;
+    }
+
+    if (byte_order != LOG_BINARY_BYTE_ORDER)
+    {
+        fprintf(stderr, "The log was written on a machine with a different byte order\n");
+        return false;
+    }
+
+    int type;
+    while ((type = fgetc(decoder->file)) != EOF)
+    {
+        const struct DecodedSite *site;
+        uint64_t time;
+        bool valid;
+
+        switch (type)
+        {
+        case LOG_BINARY_SITE:
+            valid = read_site(decoder);
+            break;
+
+        case LOG_BINARY_MESSAGE:
+        {
+            uint16_t size;
+            const uint8_t *arguments;
+            valid = (site = read_message_header(decoder, &time)) != NULL &&
+                read_value(decoder, &size, sizeof(size)) &&
+                (arguments = read_bytes(decoder, size)) != NULL;
+
+            if (valid)
+            {
+                write_header(site, time);
+                write_log_arguments(stdout, site->format, arguments, size);
+                write_footer(decoder, site);
+            }
+            break;
+        }
+
+        case LOG_BINARY_TEXT:
+        {
+            uint32_t length;
+            const uint8_t *text;
+            valid = (site = read_message_header(decoder, &time)) != NULL &&
+                read_value(decoder, &length, sizeof(length)) &&
+                (text = read_bytes(decoder, length)) != NULL;
+
+            if (valid)
+            {
+                write_header(site, time);
+                fwrite(text, 1, length, stdout);
+                write_footer(decoder, site);
+            }
+            break;
+        }
+
+        default:
+            valid = false;
+            break;
+        }
+
+        if (!valid)
+        {
+            // A log cut short by a crash ends in a partial record.
+            fprintf(stderr, "Stopped at a damaged or incomplete record\n");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    struct Decoder decoder;
+    memset(&decoder, 0, sizeof(struct Decoder));
+
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--locations") == 0)
+        {
+            decoder.locations = true;
+        }
+
+        else
+        {
+            path = argv[i];
+        }
+    }
+
+    if (path == NULL)
+    {
+        fprintf(stderr, "Usage: %s [--locations] <binary log>\n", argv[0]);
+        return 1;
+    }
+
+    decoder.file = fopen(path, "rb");
+    if (decoder.file == NULL)
+    {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return 1;
+    }
+
+    bool success = decode(&decoder);
+    fclose(decoder.file);
+
+    for (uint32_t i = 0; i < decoder.site_capacity; i++)
+    {
+        free_site(&decoder.sites[i]);
+    }
+
+    if (decoder.sites != NULL)
+    {
+        FREE_ARRAY(decoder.sites, struct DecodedSite, decoder.site_capacity);
+    }
+
+    if (decoder.buffer != NULL)
+    {
+        FREE_ARRAY(decoder.buffer, uint8_t, decoder.buffer_capacity);
+    }
+
+    return success ? 0 : 1;
+}
\ No newline at end of file
@@ -2,8 +2,51 @@
 
 #include <time.h>
 
+#ifdef _WIN32
+    #include <windows.h>
+#endif
+
 void get_time(char *buffer, int max_size, const char *format)
 {
     time_t t = time(NULL);
     strftime(buffer, max_size, format, localtime(&t));
+}
+
+double get_monotonic_time()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + 1e-9 * (double)now.tv_nsec;
+#endif
+}
+
+void write_json_string(FILE *file, const char *string)
+{
+    fputc('"', file);
+    for (; *string != '\0'; string++)
+    {
+        unsigned char c = (unsigned char)*string;
+        if (c == '"' || c == '\\')
+        {
+            fputc('\\', file);
+            fputc(c, file);
+        }
+
+        else if (c < 0x20)
+        {
+            fprintf(file, "\\u%04x", c);
+        }
+
+        else
+        {
+            fputc(c, file);
+        }
+    }
+    fputc('"', file);
 }
\ No newline at end of file